@@ -41,6 +41,7 @@ main_program::main_program(QWidget *parent)
     QObject::connect(ui.process_button, &QPushButton::clicked, m_worker, &main_worker::start_offline_clustering);
     QObject::connect(ui.processOnlineFile_button, &QPushButton::clicked, m_worker, &main_worker::start_online_file_clustering);
     QObject::connect(ui.save_clusters_button, &QPushButton::clicked, this, &main_program::save_done_clusters);
+    QObject::connect(ui.convertBinary_button, &QPushButton::clicked, this, &main_program::convert_to_binary);
     QObject::connect(ui.kev_checkbox, &QCheckBox::stateChanged, m_worker, &main_worker::set_calib_state);
     QObject::connect(render_thread, &QThread::finished, render_thread, &QObject::deleteLater);
     QObject::connect(ui.nextCluster_button, &QPushButton::clicked, m_worker, &main_worker::next_cluster);
@@ -704,8 +705,40 @@ void main_program::save_done_clusters()
         return;
     }
     
-    auto call = [&]() { m_worker->save_done_clusters(); };
+    bool binary = ui.saveBinary_checkbox->isChecked();
+    auto call = [&]() { m_worker->save_done_clusters(binary); };
     std::thread saving = std::thread(call);
+    wait_for_saving(saving);
+
+    // Show success message
+    popup_info("Saving successful!", "Saved to folder: ../clustering/saved_pixel_data");
+}
+
+void main_program::convert_to_binary()
+{
+    std::string path = ui.file_label->text().toStdString();
+    if (path == "")
+    {
+        popup_warning("Converting failed!", "Converting failed: Select pixel file first");
+        return;
+    }
+
+    auto call = [&]() { m_worker->convert_to_binary(path); };
+    std::thread converting = std::thread(call);
+    wait_for_saving(converting);
+
+    if (m_worker->convertedFile == "")
+    {
+        popup_error("Converting failed!", "Converting failed: File could not be read or written");
+        return;
+    }
+
+    popup_info("Converting successful!", "Saved to: " + QString::fromStdString(m_worker->convertedFile));
+}
+
+// Show progress until the worker is done with the file, keep window responsive
+void main_program::wait_for_saving(std::thread& saving)
+{
     update_progress(0);
 
     // Show progress
@@ -723,7 +756,4 @@ void main_program::save_done_clusters()
     update_progress(100);
     m_worker->doneSaving = false;
     saving.join();
-
-    // Show success message
-    popup_info("Saving successful!", "Saved to folder: ../clustering/saved_pixel_data");
 }
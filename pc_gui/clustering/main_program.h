@@ -62,6 +62,7 @@ public slots:
 
     // Saving stuff
     void save_done_clusters();
+    void convert_to_binary();
 
 signals:
     void send_file_path(QString path, FileType type);
@@ -84,6 +85,8 @@ private:
     QValueAxis* axisy = nullptr;
     void init_histogram();
 
+    void wait_for_saving(std::thread& saving);
+
     /* UI Utilities */
     void popup_info(QString title, QString message)
     {
@@ -17,7 +17,6 @@
 main_worker::main_worker()
 {
 	abort = false;
-	input = "";
 	idx = 0;
 	set_cluster_span(200);
 	set_cluster_delay(200);
@@ -26,6 +25,7 @@ main_worker::main_worker()
 	calib_enabled = false;
 
 	m_baseline = new clustering_baseline;
+	m_grid = new clustering_grid;
 	m_quadtree = new clustering_quadtree;
 	m_time_parallelisation = new clustering_time_parallelisation(abort);
 	m_time_embed = new clustering_time_embed(abort);
@@ -44,6 +44,7 @@ main_worker::main_worker()
 main_worker::~main_worker()
 {
 	delete m_baseline;
+	delete m_grid;
 	delete m_quadtree;
 	delete m_time_parallelisation;
 	delete m_time_embed;
@@ -136,15 +137,15 @@ void main_worker::calib_load(std::string fileName, FileType type)
 
 void main_worker::load_file_path(QString path, FileType type)
 {
-	if (type == FileType::inputData) file_loader::loadPixelData(path.toStdString(), input);
+	if (type == FileType::inputData)
+	{
+		if (file_loader::mapPixelData(path.toStdString(), input)) pathToLastInput = path.toStdString();
+	}
 	else calib_load(path.toStdString(), type);
-
-	if (input == "fault") input = "";
-	else if (type == FileType::inputData) pathToLastInput = path.toStdString();
 }
 
 /* Detect delimiter /r/n for get_my_line() */
-bool det_delim(const std::string& str) {
+bool det_delim(text_view str) {
 	std::string start = str.substr(0, 500);
 	size_t f_n = start.find('\n', 0);
 	size_t f_r = start.find('\r', 0);
@@ -214,7 +215,7 @@ void CompareDoneClusters(std::vector<ClusterType> right, std::vector<ClusterType
 	qDebug() << QString::fromStdString((utility::print_time_info("Bad clusters:", "cl", numOfBad)));
 }
 
-void main_worker::testbench(std::string input, ClusteringParams params)
+void main_worker::testbench(ClusteringParams params)
 {
 	if (online_running || connecting)
 	{
@@ -224,24 +225,22 @@ void main_worker::testbench(std::string input, ClusteringParams params)
 
 	idx = 0;
 	m_baseline->erase_done_clusters();
+	m_grid->erase_done_clusters();
 	m_quadtree->erase_done_clusters();
 	m_time_parallelisation->erase_done_clusters();
 	m_time_embed->erase_done_clusters();
 	m_benchmark->erase_done_clusters();
 
-	if (input == "")  // Load file for clustering
+	if (input.is_open() == false)  // Map file for clustering
 	{
-		if (pathToLastInput == "") input = file_loader::loadDefaultFile();
-		else file_loader::loadPixelData(&pathToLastInput[0], input);
-		if (input == "fault")
-		{
-			input = "";
-			return;
-		}
+		bool mapped = false;
+		if (pathToLastInput == "") mapped = file_loader::mapDefaultFile(input);
+		else mapped = file_loader::mapPixelData(pathToLastInput, input);
+		if (mapped == false) return;
 	}
 
-	bool rn_delim = det_delim(input);   // Detect type of delimiter - /n  ... /r/n
-	int no_lines = input.size() / 24;
+	bool rn_delim = det_delim(input.view());   // Detect type of delimiter - /n  ... /r/n
+	int no_lines = static_cast<int>(input.view().size / 24);
 	show_progress(true, no_lines);
 
 	params.calibReady = calibs_loaded && calib_enabled;
@@ -254,6 +253,7 @@ void main_worker::testbench(std::string input, ClusteringParams params)
 	if (params.calibReady)	// If calib loaded && enabled, set it
 	{
 		m_baseline->set_calibs(cal_a, cal_b, cal_c, cal_t);
+		m_grid->set_calibs(cal_a, cal_b, cal_c, cal_t);
 		m_quadtree->set_calibs(cal_a, cal_b, cal_c, cal_t);
 		m_time_parallelisation->set_calibs(cal_a, cal_b, cal_c, cal_t);
 		m_time_parallelisation->set_calibs(cal_a, cal_b, cal_c, cal_t);
@@ -262,19 +262,20 @@ void main_worker::testbench(std::string input, ClusteringParams params)
 
 	qDebug() << "---------- Filter: " << params.outerFilterSize << " | Calib: " << params.calibReady << " ----------";
 
-	//m_spatial_parallelisation->do_clustering(input, params, abort);
-	//m_quadtree->do_clustering(input, params, abort);
-	m_baseline->do_clustering(input, params, abort);
-	//m_time_embed->do_clustering(input, params, abort);
-	//m_time_parallelisation->do_clustering(input, params, abort);
+	//m_spatial_parallelisation->do_clustering(input.view(), params, abort);
+	//m_quadtree->do_clustering(input.view(), params, abort);
+	m_baseline->do_clustering(input.view(), params, abort);
+	//m_grid->do_clustering(input.view(), params, abort);
+	//m_time_embed->do_clustering(input.view(), params, abort);
+	//m_time_parallelisation->do_clustering(input.view(), params, abort);
 	std::string stats = "";
 
 	//auto doneRight = m_baseline->sort_clusters_toa(SortType::smallFirst);
 	//auto doneLeft = m_time_embed->sort_clusters_toa(SortType::smallFirst);
+	//auto doneLeft = m_grid->sort_clusters_toa(SortType::smallFirst);
 	//CompareDoneClusters(doneRight, doneLeft);
 
-	input.clear();
-	input.shrink_to_fit();
+	input.close();
 
 	// Save clusters and plot them
 	m_baseline->sort_clusters(SortType::bigFirst);
@@ -299,11 +300,11 @@ void main_worker::testbench(std::string input, ClusteringParams params)
 	return;
 	*/
 
-	m_benchmark->parse_data(input, params, abort);
+	m_benchmark->parse_data(input.view(), params, abort);
 
 	for (int i = 0; i < 0; i++)
 	{
-		m_benchmark->do_clustering_A(input, params, abort);
+		m_benchmark->do_clustering_A(input.view(), params, abort);
 		emit show_clustering_stats("STAGE1: ");
 		stats = m_benchmark->stat_print();
 		emit show_clustering_stats(stats);
@@ -312,7 +313,7 @@ void main_worker::testbench(std::string input, ClusteringParams params)
 
 	for (int i = 0; i < 0; i++)
 	{
-		m_benchmark->do_clustering_B(input, params, abort);
+		m_benchmark->do_clustering_B(input.view(), params, abort);
 		emit show_clustering_stats("STAGE2: ");
 		stats = m_benchmark->stat_print();
 		emit show_clustering_stats(stats);
@@ -321,7 +322,7 @@ void main_worker::testbench(std::string input, ClusteringParams params)
 
 	for (int i = 0; i < 0; i++)
 	{
-		m_benchmark->do_clustering_C(input, params, abort);
+		m_benchmark->do_clustering_C(input.view(), params, abort);
 		emit show_clustering_stats("STAGE3: ");
 		stats = m_benchmark->stat_print();
 		emit show_clustering_stats(stats);
@@ -330,7 +331,7 @@ void main_worker::testbench(std::string input, ClusteringParams params)
 
 	for (int i = 0; i < 0; i++)
 	{
-		m_benchmark->do_clustering_D(input, params, abort);
+		m_benchmark->do_clustering_D(input.view(), params, abort);
 		emit show_clustering_stats("STAGENOW: ");
 		stats = m_benchmark->stat_print();
 		emit show_clustering_stats(stats);
@@ -358,7 +359,7 @@ void main_worker::testbench(std::string input, ClusteringParams params)
 
 	for (int i = 0; i < 0; i++)
 	{
-		m_benchmark->do_clustering_E(input, params, abort);
+		m_benchmark->do_clustering_E(input.view(), params, abort);
 		emit show_clustering_stats("IMPROVED: ");
 		stats = m_benchmark->stat_print();
 		emit show_clustering_stats(stats);
@@ -367,7 +368,7 @@ void main_worker::testbench(std::string input, ClusteringParams params)
 
 	for (int i = 0; i < 0; i++)
 	{
-		m_benchmark->do_clustering_F(input, params, abort);
+		m_benchmark->do_clustering_F(input.view(), params, abort);
 		emit show_clustering_stats("MINMAX CALIB: ");
 		stats = m_benchmark->stat_print();
 		emit show_clustering_stats(stats);
@@ -376,7 +377,7 @@ void main_worker::testbench(std::string input, ClusteringParams params)
 
 	for (int i = 0; i < 0; i++)
 	{
-		m_benchmark->do_clustering_G(input, params, abort);
+		m_benchmark->do_clustering_G(input.view(), params, abort);
 		emit show_clustering_stats("MINMAX LUT: ");
 		stats = m_benchmark->stat_print();
 		emit show_clustering_stats(stats);
@@ -397,6 +398,13 @@ void main_worker::testbench(std::string input, ClusteringParams params)
 	emit show_clustering_stats(stats);
 	qDebug() << "MINMAX: " << QString::fromStdString(stats);
 
+	/*
+	emit show_clustering_stats("GRID: ");
+	stats = m_grid->stat_print();
+	emit show_clustering_stats(stats);
+	qDebug() << "GRID: " << QString::fromStdString(stats);
+	*/
+
 	/*
 	emit show_clustering_stats("QUADTREE: ");
 	stats = m_quadtree->stat_print();
@@ -436,19 +444,16 @@ void main_worker::start_offline_clustering()
 	idx = 0;
 	m_baseline->erase_done_clusters();
 
-	if (input == "")  // Load file for clustering
+	if (input.is_open() == false)  // Map file for clustering
 	{
-		if (pathToLastInput == "") input = file_loader::loadDefaultFile();
-		else file_loader::loadPixelData(&pathToLastInput[0], input);
-		if (input == "fault")
-		{
-			input = "";
-			return;
-		}
+		bool mapped = false;
+		if (pathToLastInput == "") mapped = file_loader::mapDefaultFile(input);
+		else mapped = file_loader::mapPixelData(pathToLastInput, input);
+		if (mapped == false) return;
 	}
 
-	bool rn_delim = det_delim(input);   // Detect type of delimiter - /n  ... /r/n
-	int no_lines = input.size() / 24;
+	bool rn_delim = det_delim(input.view());   // Detect type of delimiter - /n  ... /r/n
+	int no_lines = static_cast<int>(input.view().size / 24);
 	show_progress(true, no_lines);
 
 	params.calibReady = calibs_loaded && calib_enabled;
@@ -464,12 +469,11 @@ void main_worker::start_offline_clustering()
 	}
 
 	// Cluster the specified data
-	m_baseline->do_clustering(input, params, abort);
+	m_baseline->do_clustering(input.view(), params, abort);
 	std::string stats = "";
 
 	// Release input memory
-	input.clear();
-	input.shrink_to_fit();
+	input.close();
 
 	// Save clusters and plot them
 	m_baseline->sort_clusters(SortType::bigFirst);
@@ -479,7 +483,7 @@ void main_worker::start_offline_clustering()
 	postprocesing::plot_whole_image(picture, painter, temp);
 
 	// Testbench
-	//testbench(input, params);
+	//testbench(params);
 
 	/* Performance and stats */
 	emit show_clustering_stats("MINMAX: ");
@@ -499,18 +503,17 @@ void main_worker::start_online_file_clustering()
 	idx = 0;
 	m_baseline->erase_done_clusters();
 
-	if (input == "")  // Load file for clustering
+	if (input.is_open() == false)  // Map file for clustering
 	{
 		if (pathToLastInput == "") emit show_popup("Loading file error!", "Please select path to file.", QMessageBox::Warning);
-		else file_loader::loadPixelData(&pathToLastInput[0], input);
-		if (input == "fault")
+		else if (file_loader::mapPixelData(pathToLastInput, input) == false)
 		{
 			emit show_popup("Loading file error!", "Please select correct path to file.", QMessageBox::Warning);
 		}
 	}
 
-	bool rn_delim = det_delim(input);   // Detect type of delimiter - /n  ... /r/n
-	int no_lines = input.size() / 24;
+	bool rn_delim = det_delim(input.view());   // Detect type of delimiter - /n  ... /r/n
+	int no_lines = static_cast<int>(input.view().size / 24);
 	show_progress(true, no_lines);
 
 	params.calibReady = calibs_loaded && calib_enabled;
@@ -525,11 +528,10 @@ void main_worker::start_online_file_clustering()
 		m_baseline->set_calibs(cal_a, cal_b, cal_c, cal_t);
 	}
 
-	m_baseline->do_online_file_clustering(input, params, abort);
+	m_baseline->do_online_file_clustering(input.view(), params, abort);
 	std::string stats = "";
 
-	input.clear();
-	input.shrink_to_fit();
+	input.close();
 
 	// Save clusters and plot them
 	m_baseline->sort_clusters(SortType::bigFirst);
@@ -965,6 +967,7 @@ void main_worker::sendParamsOnline()
 	params.maxClusterDelay = static_cast<int64_t>(maxClusterDelay);
 	params.maxClusterSpan = static_cast<int64_t>(maxClusterSpan);
 	params.outerFilterSize = filterSize;
+	params.wireFormat = wire_format::wire_compact;	// Older devices dont acknowledge it and keep sending text
 
 	// Serialize parameters
 	std::string request = serializer::serialize_params(params);
@@ -1021,7 +1024,7 @@ void main_worker::online_clustering_loop(int32_t port)
 	auto stats = [=]() { statistics_thread(); };
 	t_online_stats = std::thread(stats);
 
-	std::string incoming = "";
+	frame_view frame;
 	almost_done_clusters.clear();
 	almost_done_clusters.shrink_to_fit();
 	done_clusters.Erase(done_clusters.begin(), done_clusters.end());
@@ -1037,9 +1040,8 @@ void main_worker::online_clustering_loop(int32_t port)
 	while (online_running)
 	{
 		// receive, send, display, do shit..
-		status = net->recvDataPacket(incoming);
-		status |= handle_incoming_data(incoming);
-		incoming = "";
+		status = net->recvFrames();
+		while (net->nextFrame(frame)) status |= handle_incoming_data(frame);
 		handle_mode();
 		handle_other_requests();
 
@@ -1068,7 +1070,7 @@ void main_worker::online_clustering_loop(int32_t port)
 	std::lock_guard<std::mutex> lock(paint_lock);
 
 	// Display rest of data
-	done_clusters.Insert(almost_done_clusters);
+	done_clusters.Insert_Move(almost_done_clusters);
 
 	// clean and release memory from online containers
 	cleanup_online_data();
@@ -1147,44 +1149,72 @@ void main_worker::handle_mode()
 	return;
 }
 
-int main_worker::handle_incoming_data(std::string& input)
+int main_worker::handle_incoming_data(const frame_view& frame)
 {
-	// return if no data came
-	if (input == "") return 0;
+	dataframe_types type = frame.type;
 
-	// Decide which type of message we have: type is always 0. element
-	dataframe_types type = serializer::get_type(input);
+	// Binary frames are decoded right from the receive buffer, text ones are parsed from a string
+	std::string input;
+	if (type != dataframe_types::clusters_binary && type != dataframe_types::pixels_binary && type != dataframe_types::pixel_counts_binary)
+		input.assign(frame.data, frame.length);
 
 	switch (type)
 	{
 	case dataframe_types::clusters:
 		if (mode != plugins::clustering_clusters) return 0;	// Sanity check
-		serializer::deattach_header(input);
 		return process_dataframe(input);
 		break;
+	case dataframe_types::clusters_binary:
+	{
+		if (mode != plugins::clustering_clusters) return 0;	// Sanity check
+
+		if (serializer::deserialize_clusters_binary(frame.data, frame.length, online_clusters) == false)
+		{
+			emit server_log_now("ERROR: Unsupported or broken binary cluster frame");
+			return 0;
+		}
+		return process_online_clusters();
+	}
+	case dataframe_types::pixels_binary:
+	{
+		if (mode != plugins::simple_receiver) return 0;		// Sanity check
+
+		if (serializer::deserialize_pixels_binary(frame.data, frame.length, online_pixels) == false)
+		{
+			emit server_log_now("ERROR: Unsupported or broken binary pixel frame");
+			return 0;
+		}
+		return process_online_pixels();
+	}
+	case dataframe_types::pixel_counts_binary:
+	{
+		if (mode != plugins::pixel_counting) return 0;	// Sanity check
+
+		if (serializer::deserialize_pixel_counts_binary(frame.data, frame.length, online_pixel_counts) == false)
+		{
+			emit server_log_now("ERROR: Unsupported or broken binary pixel counts frame");
+			return 0;
+		}
+		return process_online_pixel_counts();
+	}
 	case dataframe_types::pixels:
 		if (mode != plugins::simple_receiver) return 0;		// Sanity check
-		serializer::deattach_header(input);
 		return process_dataframe(input);
 		break;
 	case dataframe_types::energies:
 		if (mode != plugins::clustering_energies) return 0;	// Sanity check
-		serializer::deattach_header(input);
 		return process_dataframe(input);
 		break;
 	case dataframe_types::pixel_counts:
 		if (mode != plugins::pixel_counting) return 0;	// Sanity check
-		serializer::deattach_header(input);
 		return process_dataframe(input);
 		break;
 	case dataframe_types::messages:
-		serializer::deattach_header(input);
 		process_message(input);
 		input.insert(0, "Server: ");
 		emit server_log_now(input);
 		break;
 	case dataframe_types::errors:
-		serializer::deattach_header(input);
 		input.insert(0, "ERROR: ");
 		emit server_log_now(input);
 		break;
@@ -1193,7 +1223,6 @@ int main_worker::handle_incoming_data(std::string& input)
 		break;
 	case dataframe_types::config:
 	{
-		serializer::deattach_header(input);
 		ClusteringParamsOnline setParams = serializer::deserialize_params(input);
 
 		std::string log = "Online params acknowledge:\n";
@@ -1212,16 +1241,35 @@ int main_worker::handle_incoming_data(std::string& input)
 		log.append("filterBiggerClusters = ");
 		log.append(setParams.filterBiggerClusters ? "true" : "false");
 		log.append("\n");
+		log.append("backpressure = ");
+		log.append(std::to_string(setParams.backpressure));
+		log.append(" (0 block reader, 1 drop oldest, 2 sample every ");
+		log.append(std::to_string(setParams.sampleEvery));
+		log.append(". pixel)\n");
+		log.append("watermarks = ");
+		log.append(std::to_string(setParams.lowWatermark));
+		log.append(" - ");
+		log.append(std::to_string(setParams.highWatermark));
+		log.append(" B\n");
+		log.append("threads = ");
+		log.append(std::to_string(setParams.threads));
+		log.append("\n");
+		log.append("wireFormat = ");
+		log.append((setParams.wireFormat == wire_format::wire_compact) ? "compact" : ((setParams.wireFormat == wire_format::wire_binary) ? "binary" : "text"));
+		log.append("\n");
+		log.append("send batch = ");
+		log.append(std::to_string(setParams.sendBatchBytes));
+		log.append(" B or ");
+		log.append(std::to_string(setParams.sendMaxLatency));
+		log.append(" ms\n");
 		
 		emit server_log_now(log);
 		break;
 	}
 	case dataframe_types::acknowledge:
-		serializer::deattach_header(input);
 		emit server_mode_now(get_command_ack(input));	// Display machine running mode
 		break;
 	default:
-		serializer::deattach_header(input);
 		input.insert(0, "DEV CHECK IMPLEMENTATION: ");
 		emit server_log_now(input);
 		break;
@@ -1240,64 +1288,11 @@ int main_worker::process_dataframe(const std::string& input)
 
 	case plugins::clustering_clusters:
 		online_clusters = serializer::deserialize_clusters(input);
-		if (online_clusters.empty()) return 0;	// In case input wasnt cluster frame
-
-		// Count clusters for stats
-		cluster_counter += online_clusters.size();
-
-		// Emplace all clusters into doneClusters
-		for (auto& cluster : online_clusters)
-		{
-			// Calibrate pixels if calibReady - device cannot calibrate
-			if (params.calibReady)
-			{
-				for (auto& pix : cluster.pix)
-				{
-					pix.ToT = energy_calc(pix.x, pix.y, pix.ToT);
-				}
-			}
-			
-			almost_done_clusters.emplace_back(ClusterType{ cluster.pix, 0,0,0,0,0,0 });
-			pixel_counter += cluster.pix.size();
-		}
-		break;
+		return process_online_clusters();
 
 	case plugins::simple_receiver:
 		online_pixels = serializer::deserialize_pixels(input);
-		if (online_pixels.empty()) return 0;	// In case input wasnt pixel frame
-
-		// Count pixels for hitrate statistics
-		pixel_counter += online_pixels.size();
-
-		// if empty, insert the first cluster
-		if (almost_done_clusters.empty())
-		{
-			// Calibrate pixels before emplacing them
-			if (params.calibReady)
-			{
-				for (auto& pix : online_pixels)
-				{
-					pix.ToT = energy_calc(pix.x, pix.y, pix.ToT);
-				}
-			}
-
-			almost_done_clusters.emplace_back(ClusterType{ online_pixels, 0,0,0,0,0,0 });
-		}
-		// if not empty, then just append pixels to the ONE AND ONLY cluster
-		else
-		{
-			// Maintain only one cluster
-			for (auto& pix : online_pixels)
-			{
-				// Calibrate pixels befire emplacing them
-				if (params.calibReady)
-				{
-					pix.ToT = energy_calc(pix.x, pix.y, pix.ToT);
-				}
-				almost_done_clusters.back().pix.emplace_back(pix);
-			}
-		}
-		break;
+		return process_online_pixels();
 
 	case plugins::clustering_energies:
 	{
@@ -1316,22 +1311,97 @@ int main_worker::process_dataframe(const std::string& input)
 
 	case plugins::pixel_counting:
 		online_pixel_counts = serializer::deserialize_pixel_counts(input);
-		if (online_pixel_counts.empty()) return 0;	// In case input wasnt pixel frame
+		return process_online_pixel_counts();
+
+	default:
+		return -1;	 // error
+		break;
+	}
+
+	return 0;
+}
+
+// Clusters decoded from text or binary cluster frame
+int main_worker::process_online_clusters()
+{
+	if (online_clusters.empty()) return 0;	// In case input wasnt cluster frame
+
+	// Count clusters for stats
+	cluster_counter += online_clusters.size();
+
+	// Emplace all clusters into doneClusters
+	for (auto& cluster : online_clusters)
+	{
+		// Calibrate pixels if calibReady - device cannot calibrate
+		if (params.calibReady)
+		{
+			for (auto& pix : cluster.pix)
+			{
+				pix.ToT = energy_calc(pix.x, pix.y, pix.ToT);
+			}
+		}
 		
-		// Count pixels for hitrate statistics
-		pixel_counter += online_pixel_counts.size();
+		almost_done_clusters.emplace_back(ClusterType{ cluster.pix, 0,0,0,0,0,0 });
+		pixel_counter += cluster.pix.size();
+	}
+
+	return 0;
+}
+
+// Pixels decoded from text or binary pixel frame
+int main_worker::process_online_pixels()
+{
+	if (online_pixels.empty()) return 0;	// In case input wasnt pixel frame
+
+	// Count pixels for hitrate statistics
+	pixel_counter += online_pixels.size();
+
+	// if empty, insert the first cluster
+	if (almost_done_clusters.empty())
+	{
+		// Calibrate pixels before emplacing them
+		if (params.calibReady)
+		{
+			for (auto& pix : online_pixels)
+			{
+				pix.ToT = energy_calc(pix.x, pix.y, pix.ToT);
+			}
+		}
 
+		almost_done_clusters.emplace_back(ClusterType{ online_pixels, 0,0,0,0,0,0 });
+	}
+	// if not empty, then just append pixels to the ONE AND ONLY cluster
+	else
+	{
 		// Maintain only one cluster
-		for (auto& pix : online_pixel_counts)
+		for (auto& pix : online_pixels)
 		{
-			pixel_counts_matrix->counts[pix.x][pix.y] += 1;
-			if (pixel_counts_matrix->counts[pix.x][pix.y] > pixel_counts_matrix->maxCount)	pixel_counts_matrix->maxCount = pixel_counts_matrix->counts[pix.x][pix.y];
-			if (pixel_counts_matrix->counts[pix.x][pix.y] < pixel_counts_matrix->minCount)	pixel_counts_matrix->minCount = pixel_counts_matrix->counts[pix.x][pix.y];
+			// Calibrate pixels befire emplacing them
+			if (params.calibReady)
+			{
+				pix.ToT = energy_calc(pix.x, pix.y, pix.ToT);
+			}
+			almost_done_clusters.back().pix.emplace_back(pix);
 		}
-		break;
-	default:
-		return -1;	 // error
-		break;
+	}
+
+	return 0;
+}
+
+// Pixel counts decoded from text or binary pixel_counts frame
+int main_worker::process_online_pixel_counts()
+{
+	if (online_pixel_counts.empty()) return 0;	// In case input wasnt pixel frame
+	
+	// Count pixels for hitrate statistics
+	pixel_counter += online_pixel_counts.size();
+
+	// Maintain only one cluster
+	for (auto& pix : online_pixel_counts)
+	{
+		pixel_counts_matrix->counts[pix.x][pix.y] += 1;
+		if (pixel_counts_matrix->counts[pix.x][pix.y] > pixel_counts_matrix->maxCount)	pixel_counts_matrix->maxCount = pixel_counts_matrix->counts[pix.x][pix.y];
+		if (pixel_counts_matrix->counts[pix.x][pix.y] < pixel_counts_matrix->minCount)	pixel_counts_matrix->minCount = pixel_counts_matrix->counts[pix.x][pix.y];
 	}
 
 	return 0;
@@ -1371,8 +1441,7 @@ void main_worker::process_message(const std::string& input)
 		// Display rest of data
 		if (mode == plugins::clustering_clusters || mode == plugins::simple_receiver)
 		{
-			done_clusters.Insert(almost_done_clusters);
-			almost_done_clusters.clear();
+			done_clusters.Insert_Move(almost_done_clusters);
 			almost_done_clusters.shrink_to_fit();
 
 			auto cl = done_clusters.Get_All();
@@ -1426,23 +1495,29 @@ void main_worker::update_reset_period(int period)
 	reset_period = period;
 }
 
-void main_worker::save_done_clusters()
+void main_worker::save_done_clusters(bool binary)
 {
 	auto clusters = done_clusters.Get_All();
 
 	if (mode == plugins::simple_receiver)
 	{
-		file_saver::savePixelFile(clusters);
+		file_saver::savePixelFile(clusters, binary);
 	}
 	else
 	{
-		file_saver::savePixelFile(clusters);
+		file_saver::savePixelFile(clusters, binary);
 		std::string savedFile = file_saver::saveClusterFile(clusters);
 	}
 	doneSaving = true;
 	return;
 }
 
+void main_worker::convert_to_binary(std::string path)
+{
+	convertedFile = file_saver::convertToBinary(path);
+	doneSaving = true;
+}
+
 void main_worker::select_online_mode(plugins plug)
 {
 	if (online_running)	mode = plug;
@@ -1476,8 +1551,7 @@ void main_worker::render_pixels()
 		}
 
 		// finally insert almost done clusters to done clusters
-		done_clusters.Insert(almost_done_clusters);
-		almost_done_clusters.clear();
+		done_clusters.Insert_Move(almost_done_clusters);
 
 		emit render_all(picture);
 	}
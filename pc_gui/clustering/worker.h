@@ -14,6 +14,7 @@
 #include "file_loader.h"
 #include <QtCharts>
 #include "clustering_baseline.h"
+#include "clustering_grid.h"
 #include "clustering_quadtree.h"
 #include "clustering_time.h"
 #include "clustering_time_embed.h"
@@ -62,8 +63,11 @@ public:
 	void select_online_mode(plugins plug);
 	void online_clustering_loop(int32_t port);
 	void handle_mode();
-	int handle_incoming_data(std::string& input);
+	int handle_incoming_data(const frame_view& frame);
 	int process_dataframe(const std::string& input);
+	int process_online_clusters();
+	int process_online_pixels();
+	int process_online_pixel_counts();
 	void process_message(const std::string& input);
 	void handle_other_requests();
 
@@ -71,8 +75,12 @@ public:
 	void enable_reset_screen(bool enabled);
 	void update_reset_period(int period);
 
-	// save done clusters
-	void save_done_clusters();
+	// save done clusters, pixels also to binary pixel file if binary
+	void save_done_clusters(bool binary);
+
+	// convert pixel file to binary pixel file next to it, convertedFile is empty on error
+	void convert_to_binary(std::string path);
+	std::string convertedFile;
 	size_t get_number_of_clusters()
 	{
 		return done_clusters.Size();
@@ -119,11 +127,11 @@ private:
 	bool running = false;	// Program running flag
 
 	// File input for offline clustering
-	std::string input;
+	mapped_file input;
 	std::string pathToLastInput;
 
 	// Testing
-	void testbench(std::string input, ClusteringParams params);
+	void testbench(ClusteringParams params);
 
 	// Frame rendering functionality
 	bool is_frame_rendered = false;
@@ -154,6 +162,7 @@ private:
 
 	// Different clustering methods objects
 	clustering_baseline* m_baseline;
+	clustering_grid* m_grid;
 	clustering_quadtree* m_quadtree;
 	clustering_time_parallelisation* m_time_parallelisation;
 	clustering_time_embed* m_time_embed;
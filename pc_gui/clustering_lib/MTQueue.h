@@ -14,6 +14,7 @@
 #include <atomic>
 #include <vector>
 #include <list>
+#include <iterator>
 
  /* Multi threaded queue with sleep while waiting for unlock */
 template<typename T>
@@ -52,25 +53,29 @@ public:
 	}
 };
 
+/* Multi threaded vector - Size() does not lock, it reads item count kept next to the vector */
 template<typename T>
 class MTVector
 {
 private:
 	std::vector<T> vec;
 	std::mutex mtx;
+	std::atomic<size_t> count{0};	// vec.size(), updated under mtx
 
 public:
 
 	void Emplace_Back(T&& element)
 	{
 		std::lock_guard<std::mutex> lock(mtx);
-		vec.emplace_back(element);
+		vec.emplace_back(std::move(element));
+		count.store(vec.size(), std::memory_order_relaxed);
 	}
 
 	void Push_Back(T& element)
 	{
 		std::lock_guard<std::mutex> lock(mtx);
 		vec.emplace_back(element);
+		count.store(vec.size(), std::memory_order_relaxed);
 	}
 
 	std::vector<T> Get_All()
@@ -86,6 +91,7 @@ public:
 		//vec.erase(vec.begin(), vec.end());
 		vec.clear();
 		vec.shrink_to_fit();
+		count.store(0, std::memory_order_relaxed);
 		return temp;
 	}
 
@@ -93,12 +99,14 @@ public:
 	{
 		std::lock_guard<std::mutex> lock(mtx);
 		vec.erase(first);
+		count.store(vec.size(), std::memory_order_relaxed);
 	}
 
 	void Erase(typename std::vector<T>::iterator first, typename std::vector<T>::iterator last)
 	{
 		std::lock_guard<std::mutex> lock(mtx);
 		vec.erase(first, last);
+		count.store(vec.size(), std::memory_order_relaxed);
 	}
 
 	void ClearAndFit()
@@ -106,6 +114,7 @@ public:
 		std::lock_guard<std::mutex> lock(mtx);
 		vec.clear();
 		vec.shrink_to_fit();
+		count.store(0, std::memory_order_relaxed);
 	}
 
 	T& operator[](size_t index)
@@ -118,12 +127,24 @@ public:
 	{
 		std::lock_guard<std::mutex> lock(mtx);
 		vec.insert(vec.end(), toInsert.begin(), toInsert.end());
+		count.store(vec.size(), std::memory_order_relaxed);
+	}
+
+	/* Move items of caller's private buffer to the end, buffer is left empty (its capacity is kept for refilling) */
+	void Insert_Move(std::vector<T>& toInsert)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			if (vec.empty()) vec.swap(toInsert);	// Whole buffer at once
+			else vec.insert(vec.end(), std::make_move_iterator(toInsert.begin()), std::make_move_iterator(toInsert.end()));
+			count.store(vec.size(), std::memory_order_relaxed);
+		}
+		toInsert.clear();
 	}
 
 	size_t Size()
 	{
-		std::lock_guard<std::mutex> lock(mtx);
-		return vec.size();
+		return count.load(std::memory_order_relaxed);
 	}
 
 	typename std::vector<T>::iterator begin()
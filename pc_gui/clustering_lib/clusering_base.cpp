@@ -7,6 +7,9 @@
 
 #include "clusering_base.h"
 
+const uint64_t clustering_base::STREAM_BATCH_LINES;
+const size_t clustering_base::STREAM_BATCHES;
+
 int clustering_base::test_all_lines_used() {
     assert("Fault = lines processed doesnt match" && stat_lines_processed == stat_lines_saved);
 
@@ -18,7 +21,7 @@ int clustering_base::test_all_lines_used() {
     return -1;  // Fault
 }
 
-bool clustering_base::get_my_line(const std::string& str, std::string& oneLine, const bool& rn_delim)
+bool clustering_base::get_my_line(text_view str, std::string& oneLine, const bool& rn_delim)
 {
     static size_t pos = 0;
     static size_t last_pos = 0;
@@ -41,7 +44,7 @@ bool clustering_base::get_my_line(const std::string& str, std::string& oneLine,
     else return false;
 }
 
-bool clustering_base::get_my_line_MT(const std::string& str, std::string& oneLine, const bool& rn_delim, size_t& last_pos)
+bool clustering_base::get_my_line_MT(text_view str, std::string& oneLine, const bool& rn_delim, size_t& last_pos)
 {
     size_t pos = 0;
     pos = str.find('\n', pos + 1);
@@ -151,3 +154,51 @@ void clustering_base::set_calibs(float* a, float* b, float* c, float* t)
         calib_t[i] = *t++;
     }
 }
+
+pixel_parser::result clustering_base::parse_pixels(text_view text, size_t offset, pixel_parser::line_format format, int outerFilterSize, bool calibReady, std::vector<OnePixel>& pixels, volatile bool& abort, uint64_t maxLines)
+{
+    const size_t first = pixels.size();
+    pixel_parser::result res = pixel_parser::parse(text, offset, format, outerFilterSize, pixels, abort, maxLines);
+
+    stat_lines_sorted += res.lines;
+    stat_lines_processed += res.pixels;
+
+    if (calibReady) calibrate_pixels(pixels, first);
+
+    return res;
+}
+
+uint64_t clustering_base::decode_pixels(text_view data, const pixel_binary::file_header& header, uint64_t first, uint64_t count, int outerFilterSize, bool calibReady, std::vector<OnePixel>& pixels)
+{
+    const size_t start = pixels.size();
+    const uint64_t decoded = pixel_binary::decode(data, header, first, count, outerFilterSize, pixels);
+
+    stat_lines_sorted += count;
+    stat_lines_processed += decoded;
+
+    if (calibReady) calibrate_pixels(pixels, start);
+
+    return decoded;
+}
+
+uint64_t clustering_base::decode_readout(text_view data, uint64_t first, uint64_t count, int outerFilterSize, bool calibReady, katherine_readout::state& st, std::vector<OnePixel>& pixels)
+{
+    const size_t start = pixels.size();
+    const uint64_t read = katherine_readout::decode(data, first, count, outerFilterSize, st, pixels);
+
+    stat_lines_sorted += read;
+    stat_lines_processed += pixels.size() - start;
+
+    if (calibReady) calibrate_pixels(pixels, start);
+
+    return read;
+}
+
+void clustering_base::calibrate_pixels(std::vector<OnePixel>& pixels, size_t first)
+{
+    for (size_t i = first; i < pixels.size(); i++)
+    {
+        OnePixel& pix = pixels[i];
+        pix.ToT = energy_calc(pix.x, pix.y, pix.ToT);
+    }
+}
@@ -9,6 +9,12 @@
 
 #include "utility.h"
 #include "cluster_definition.h"
+#include "pixel_parser.h"
+#include "pixel_binary.h"
+#include "katherine_readout.h"
+#include "pixel_stream.h"
+#include <thread>
+#include <algorithm>
 
 class clustering_base : public utility
 {
@@ -52,8 +58,124 @@ public:
 	}
 
 protected:
-	bool get_my_line_MT(const std::string& str, std::string& oneLine, const bool& rn_delim, size_t& last_pos);
-	static bool get_my_line(const std::string& str, std::string& oneLine, const bool& rn_delim);
+	/// <summary>
+	/// Parse pixel lines of text (pixel_parser), update line stats and calibrate ToT when enabled
+	/// </summary>
+	pixel_parser::result parse_pixels(text_view text, size_t offset, pixel_parser::line_format format, int outerFilterSize, bool calibReady, std::vector<OnePixel>& pixels, volatile bool& abort, uint64_t maxLines = UINT64_MAX);
+
+	/// <summary>
+	/// Decode count hits of binary pixel file from hit first (pixel_binary), update line stats and calibrate ToT when enabled
+	/// </summary>
+	uint64_t decode_pixels(text_view data, const pixel_binary::file_header& header, uint64_t first, uint64_t count, int outerFilterSize, bool calibReady, std::vector<OnePixel>& pixels);
+
+	/// <summary>
+	/// Decode count words of raw Katherine readout from word first (katherine_readout), update line stats and calibrate ToT when enabled
+	/// </summary>
+	uint64_t decode_readout(text_view data, uint64_t first, uint64_t count, int outerFilterSize, bool calibReady, katherine_readout::state& st, std::vector<OnePixel>& pixels);
+
+	/// <summary>
+	/// Parse text in batches of STREAM_BATCH_LINES lines and pass every batch to consume(const std::vector<OnePixel>&) in file order.
+	/// Parser runs on its own thread at most STREAM_BATCHES batches ahead of consume, so only these batches are held in memory.
+	/// On single core both stages run in turn on the calling thread.
+	/// Binary pixel file (pixel_binary) and raw readout (katherine_readout) are decoded the same way, format and offset are ignored for them.
+	/// </summary>
+	template <typename Consume>
+	pixel_parser::result stream_pixels(text_view text, size_t offset, pixel_parser::line_format format, int outerFilterSize, bool calibReady, volatile bool& abort, Consume consume)
+	{
+		pixel_parser::result total = { offset, 0, 0, false };
+
+		pixel_binary::file_header header;
+		const bool binary = pixel_binary::read_header(text, header);
+		const bool readout = (binary == false) && katherine_readout::is_readout(text);
+		const uint64_t readoutWords = katherine_readout::words(text);
+		katherine_readout::state readoutState;
+		uint64_t readoutNext = 0;	// Next word of readout
+
+		// Parse one batch from the end of previous one, returns true if there may be more lines
+		auto parse_batch = [&](std::vector<OnePixel>& batch) {
+			if (binary)
+			{
+				const uint64_t count = std::min<uint64_t>(STREAM_BATCH_LINES, header.hits - total.lines);
+				total.pixels += decode_pixels(text, header, total.lines, count, outerFilterSize, calibReady, batch);
+				total.lines += count;
+				if (total.lines == header.hits) total.stop = text.size;
+				return total.lines < header.hits && abort == false;
+			}
+
+			if (readout)
+			{
+				const uint64_t count = std::min<uint64_t>(STREAM_BATCH_LINES, readoutWords - readoutNext);
+				const size_t before = batch.size();
+				total.lines += decode_readout(text, readoutNext, count, outerFilterSize, calibReady, readoutState, batch);
+				total.pixels += batch.size() - before;
+				readoutNext += count;
+				if (readoutNext == readoutWords) total.stop = text.size;
+				return readoutNext < readoutWords && abort == false;
+			}
+
+			pixel_parser::result res = parse_pixels(text, total.stop, format, outerFilterSize, calibReady, batch, abort, STREAM_BATCH_LINES);
+			total.stop = res.stop;
+			total.lines += res.lines;
+			total.pixels += res.pixels;
+			total.cluster_marker = res.cluster_marker;
+			return res.lines == STREAM_BATCH_LINES && abort == false;
+		};
+
+		if (std::thread::hardware_concurrency() < 2)
+		{
+			std::vector<OnePixel> batch;
+			bool more = true;
+			while (more)
+			{
+				batch.clear();
+				more = parse_batch(batch);
+				if (batch.empty() == false && abort == false) consume(static_cast<const std::vector<OnePixel>&>(batch));
+			}
+			if (readout) log_readout(readoutState);
+			return total;
+		}
+
+		pixel_batches batches(STREAM_BATCHES);
+
+		std::thread parser([&]() {
+			std::vector<OnePixel> batch;
+			bool more = true;
+			while (more && batches.acquire(batch))
+			{
+				more = parse_batch(batch);
+				if (batch.empty()) batches.release(std::move(batch));
+				else batches.push(std::move(batch));
+			}
+			batches.finish();
+		});
+
+		try
+		{
+			std::vector<OnePixel> batch;
+			while (batches.pop(batch))
+			{
+				if (abort == false) consume(static_cast<const std::vector<OnePixel>&>(batch));
+				batches.release(std::move(batch));
+			}
+		}
+		catch (...)
+		{
+			batches.cancel();
+			parser.join();
+			throw;
+		}
+
+		parser.join();
+		if (readout) log_readout(readoutState);
+		return total;
+	}
+
+	static const uint64_t STREAM_BATCH_LINES = 65536;	// Lines (or readout words) parsed into one batch
+	static const size_t STREAM_BATCHES = 4;				// Batches in flight between parser and clustering
+
+	void calibrate_pixels(std::vector<OnePixel>& pixels, size_t first);
+	bool get_my_line_MT(text_view str, std::string& oneLine, const bool& rn_delim, size_t& last_pos);
+	static bool get_my_line(text_view str, std::string& oneLine, const bool& rn_delim);
 	int energy_calc(const int& x, const int& y, const int& ToT);
 	float perf_metric(int linesProcessed, float msElapsed);
 
@@ -110,6 +232,15 @@ protected:
 		log.append(input);
 	}
 
+	/// <summary>
+	/// Append counters of decoded raw readout to log - frames, lost and unknown words are not visible in pixels.
+	/// </summary>
+	void log_readout(const katherine_readout::state& st)
+	{
+		log_append("Readout: frames = " + std::to_string(st.frames) + "  lost pixels = " + std::to_string(st.lost) +
+			"  unknown words = " + std::to_string(st.unknown) + "\r\n");
+	}
+
 	/// <summary>
 	/// Creation of pre-calculated energy LUT. Must be called before loop.
 	/// </summary>
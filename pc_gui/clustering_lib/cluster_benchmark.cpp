@@ -6,11 +6,10 @@
  */
 
 #include "cluster_benchmark.h"
-#include <queue>
 
-void cluster_benchmark::parse_data(std::string& lines, const ClusteringParams& params, volatile bool& abort)
+void cluster_benchmark::parse_data(text_view lines, const ClusteringParams& params, volatile bool& abort)
 {
-	if (lines == "") return;
+	if (lines.empty()) return;
 	if (lines[0] != '#') return;
 
 	stat_lines_sorted = 0;
@@ -27,58 +26,36 @@ void cluster_benchmark::parse_data(std::string& lines, const ClusteringParams& p
 	// PARAMETERS
 	int upFilter = 255 - params.outerFilterSize;
 	int doFilter = params.outerFilterSize;
-	const double toaLsb = 25;
-	const double toaFineLsb = 1.5625;
 
-	std::string oneLine;
-	char* context = nullptr;
-	char* rows[4] = { 0, 0, 0, 0 };
+	// ToT statistics are taken from all pixels - parse without filter, filter afterwards
+	std::vector<OnePixel> parsed;
+	pixel_parser::result res = pixel_parser::parse(lines, 0, pixel_parser::katherine_raw, 0, parsed, abort);
 
-	while (get_my_line(lines, oneLine, params.rn_delim)) {      // Gets lines without ending line chars - ex. "\n"
-
-		if (oneLine[0] == '#') continue;
-
-		if (abort)
-		{
-			return;
-		}
-
-		stat_lines_sorted++;
-
-		/* Split line into rows */
-		rows[0] = strtok_s(&oneLine.front(), "\t", &context); //strtok(oneLine.data(), "\t");
-		rows[1] = strtok_s(NULL, "\t", &context);
-		rows[2] = strtok_s(NULL, "\t", &context);
-		rows[3] = strtok_s(NULL, "\t", &context);
+	if (abort)
+	{
+		return;
+	}
 
-		// ATOI 6300 ms vs STRTOINT 6100 ms with 20 PIX filter
-		// ATOI CCA 200 ms slower than my Fast strtoint
-		int coordX = strtoint(rows[0]) / 256; // std::atoi(rows[0]) / 256;
-		int coordY = strtoint(rows[0]) % 256; // std::atoi(rows[0]) % 256;
-		double toaAbsTime = (double)((strtolong(rows[1]) * toaLsb) - (strtolong(rows[2]) * toaFineLsb));  // (ns) TimeFromBeginning = 25 * ToA - 1.5625 * fineToA
-		int ToTValue = strtoint(rows[3]);//std::atoi(rows[3]);
+	stat_lines_sorted = res.lines;
 
+	for (const auto& pix : parsed)
+	{
 		// Test
-		if (minToT == 0)	minToT = ToTValue;
-		if (minToT > ToTValue) minToT = ToTValue;
-		if (maxToT < ToTValue) maxToT = ToTValue;
-		avgToT += ToTValue;
+		if (minToT == 0)	minToT = pix.ToT;
+		if (minToT > pix.ToT) minToT = pix.ToT;
+		if (maxToT < pix.ToT) maxToT = pix.ToT;
+		avgToT += pix.ToT;
 
-		if (coordX > upFilter || coordX < doFilter || coordY > upFilter || coordY < doFilter) continue;   // This is faster after the inlined funkctions, not after coordY
-
-		if (params.calibReady)
-		{
-			//ToTValue = energy_calc(coordX, coordY, ToTValue);
-		}
+		if (pix.x > upFilter || pix.x < doFilter || pix.y > upFilter || pix.y < doFilter) continue;
 
-		pixelData.push(std::move(OnePixel(coordX, coordY, ToTValue, toaAbsTime)));
+		pixelData.push(pix);
 		stat_lines_processed++;
 	}
 
 	avgToT = avgToT / stat_lines_sorted;
 }
 // BRUTEFORCE
-void cluster_benchmark::do_clustering_A(std::string& lines, const ClusteringParams& params, volatile bool& abort)
+void cluster_benchmark::do_clustering_A(text_view lines, const ClusteringParams& params, volatile bool& abort)
 {
 	auto pixelDataTemp = pixelData;
 	uint64_t temp_lines = stat_lines_processed;
@@ -209,7 +186,7 @@ void cluster_benchmark::do_clustering_A(std::string& lines, const ClusteringPara
 }
 
 // TIME MOVE OUT
-void cluster_benchmark::do_clustering_B(std::string& lines, const ClusteringParams& params, volatile bool& abort)
+void cluster_benchmark::do_clustering_B(text_view lines, const ClusteringParams& params, volatile bool& abort)
 {
 	auto pixelDataTemp = pixelData;
 	uint64_t temp_lines = stat_lines_processed;
@@ -315,7 +292,7 @@ void cluster_benchmark::do_clustering_B(std::string& lines, const ClusteringPara
 }
 
 // X AND Y IF STATEMENT
-void cluster_benchmark::do_clustering_C(std::string& lines, const ClusteringParams& params, volatile bool& abort)
+void cluster_benchmark::do_clustering_C(text_view lines, const ClusteringParams& params, volatile bool& abort)
 {
 	auto pixelDataTemp = pixelData;
 	uint64_t temp_lines = stat_lines_processed;
@@ -439,7 +416,7 @@ void cluster_benchmark::do_clustering_C(std::string& lines, const ClusteringPara
 	return;
 }
 
-void cluster_benchmark::do_clustering_D(std::string& lines, const ClusteringParams& params, volatile bool& abort)
+void cluster_benchmark::do_clustering_D(text_view lines, const ClusteringParams& params, volatile bool& abort)
 {
 	auto pixelDataTemp = pixelData;
 	uint64_t temp_lines = stat_lines_processed;
@@ -568,7 +545,7 @@ void cluster_benchmark::do_clustering_D(std::string& lines, const ClusteringPara
 
 // Improve 
 // uint times instead of double
-void cluster_benchmark::do_clustering_E(std::string& lines, const ClusteringParams& params, volatile bool& abort)
+void cluster_benchmark::do_clustering_E(text_view lines, const ClusteringParams& params, volatile bool& abort)
 {
 	auto pixelDataTemp = pixelData;
 	uint64_t temp_lines = stat_lines_processed;
@@ -718,7 +695,7 @@ void cluster_benchmark::do_clustering_E(std::string& lines, const ClusteringPara
 }
 
 // Energy LUT
-void cluster_benchmark::do_clustering_F(std::string& lines, const ClusteringParams& params, volatile bool& abort)
+void cluster_benchmark::do_clustering_F(text_view lines, const ClusteringParams& params, volatile bool& abort)
 {
 	auto pixelDataTemp = pixelData;
 	uint64_t temp_lines = stat_lines_processed;
@@ -848,7 +825,7 @@ void cluster_benchmark::do_clustering_F(std::string& lines, const ClusteringPara
 }
 
 // Energy LUT
-void cluster_benchmark::do_clustering_G(std::string& lines, const ClusteringParams& params, volatile bool& abort)
+void cluster_benchmark::do_clustering_G(text_view lines, const ClusteringParams& params, volatile bool& abort)
 {
 	auto pixelDataTemp = pixelData;
 	uint64_t temp_lines = stat_lines_processed;
@@ -15,15 +15,15 @@
 class cluster_benchmark : public clustering_base, public cluster_definition
 {
 public:
-	void parse_data(std::string& lines, const ClusteringParams& params, volatile bool& abort);
-
-	void do_clustering_A(std::string& lines, const ClusteringParams& params, volatile bool& abort);
-	void do_clustering_B(std::string& lines, const ClusteringParams& params, volatile bool& abort);
-	void do_clustering_C(std::string& lines, const ClusteringParams& params, volatile bool& abort);
-	void do_clustering_D(std::string& lines, const ClusteringParams& params, volatile bool& abort);
-	void do_clustering_E(std::string& lines, const ClusteringParams& params, volatile bool& abort);
-	void do_clustering_F(std::string& lines, const ClusteringParams& params, volatile bool& abort);
-	void do_clustering_G(std::string& lines, const ClusteringParams& params, volatile bool& abort);
+	void parse_data(text_view lines, const ClusteringParams& params, volatile bool& abort);
+
+	void do_clustering_A(text_view lines, const ClusteringParams& params, volatile bool& abort);
+	void do_clustering_B(text_view lines, const ClusteringParams& params, volatile bool& abort);
+	void do_clustering_C(text_view lines, const ClusteringParams& params, volatile bool& abort);
+	void do_clustering_D(text_view lines, const ClusteringParams& params, volatile bool& abort);
+	void do_clustering_E(text_view lines, const ClusteringParams& params, volatile bool& abort);
+	void do_clustering_F(text_view lines, const ClusteringParams& params, volatile bool& abort);
+	void do_clustering_G(text_view lines, const ClusteringParams& params, volatile bool& abort);
 
 	void create_LUT_test(int depth)
 	{
@@ -21,6 +21,7 @@
 #include <cmath>
 #include <array>
 #include <cassert>
+#include <utility>
 
 struct OnePixel		// Pixel data
 {
@@ -34,6 +35,18 @@ struct OnePixel		// Pixel data
 	};
 };
 
+struct OnePixelTick	// Pixel data with integer ToA - fast path of the clustering engines
+{
+	int64_t ToA;		// ToA in fine ToA ticks (1.5625 ns = 25 ns / 16)
+	uint16_t x, y;
+	int32_t ToT;
+
+	OnePixelTick(uint16_t x, uint16_t y, int ToT, int64_t ToA)
+		: ToA(ToA), x(x), y(y), ToT(ToT)
+	{
+	};
+};
+
 struct ClusterType
 {
 	std::vector<OnePixel> pix;
@@ -46,17 +59,92 @@ struct ClusterType
 
 	ClusterType(std::vector<OnePixel> pix, double minToA, double maxToA,
 		uint16_t xMax, uint16_t xMin, uint16_t yMax, uint16_t yMin)
-		: pix(pix), minToA(minToA), maxToA(maxToA), xMax(xMax), xMin(xMin), yMax(yMax), yMin(yMin)
+		: pix(std::move(pix)), minToA(minToA), maxToA(maxToA), xMax(xMax), xMin(xMin), yMax(yMax), yMin(yMin)
 	{
 	};
 };
 
+/// <summary>
+/// pixel_time converts between OnePixel (ToA in ns, double) and pixel type used inside clustering engine.
+/// Engines templated on pixel type work in its time units and hand out ClusterType with ToA in ns.
+/// </summary>
+template <typename Pixel>
+struct pixel_time;
+
+template <>
+struct pixel_time<OnePixel>
+{
+	typedef double TimeType;
+
+	/// <summary>
+	/// Convert batch of parsed pixels, returns in itself - nothing to convert.
+	/// </summary>
+	static const std::vector<OnePixel>& from_pixels(const std::vector<OnePixel>& in, std::vector<OnePixel>& buffer)
+	{
+		return in;
+	}
+
+	/// <summary>
+	/// Time limit (ns) in time units - (ToA difference > limit) gives the same result as in ns.
+	/// </summary>
+	static double limit(int ns) { return static_cast<double>(ns); };
+	static double to_ns(double time) { return time; };
+	static const OnePixel& to_one_pixel(const OnePixel& pix) { return pix; };
+
+	static ClusterType to_cluster(std::vector<OnePixel>&& pix, double minToA, double maxToA, uint16_t xMax, uint16_t xMin, uint16_t yMax, uint16_t yMin)
+	{
+		return ClusterType(std::move(pix), minToA, maxToA, xMax, xMin, yMax, yMin);
+	}
+};
+
+template <>
+struct pixel_time<OnePixelTick>
+{
+	typedef int64_t TimeType;
+
+	static const int64_t TICKS_PER_CLOCK = 16;	// Fine ToA ticks in one 25 ns clock
+	static const int64_t CLOCK_NS = 25;
+
+	/// <summary>
+	/// Convert batch of parsed pixels into buffer and return it.
+	/// ToA from Katherine is always whole tick. ToA saved as whole ns (truncated) is rounded up, which returns it to its original tick.
+	/// </summary>
+	static const std::vector<OnePixelTick>& from_pixels(const std::vector<OnePixel>& in, std::vector<OnePixelTick>& buffer)
+	{
+		buffer.clear();
+		buffer.reserve(in.size());
+		for (const auto& pix : in)
+		{
+			buffer.emplace_back(pix.x, pix.y, pix.ToT, static_cast<int64_t>(std::ceil((pix.ToA * TICKS_PER_CLOCK) / CLOCK_NS)));
+		}
+		return buffer;
+	}
+
+	/// <summary>
+	/// Time limit (ns) in ticks - for integer ToA difference, (difference > limit) gives the same result as in ns.
+	/// </summary>
+	static int64_t limit(int ns) { return static_cast<int64_t>(std::floor((static_cast<double>(ns) * TICKS_PER_CLOCK) / CLOCK_NS)); };
+	static double to_ns(int64_t time) { return (static_cast<double>(time) * CLOCK_NS) / TICKS_PER_CLOCK; };
+	static OnePixel to_one_pixel(const OnePixelTick& pix) { return OnePixel(pix.x, pix.y, pix.ToT, to_ns(pix.ToA)); };
+
+	static ClusterType to_cluster(std::vector<OnePixelTick>&& pix, int64_t minToA, int64_t maxToA, uint16_t xMax, uint16_t xMin, uint16_t yMax, uint16_t yMin)
+	{
+		std::vector<OnePixel> out;
+		out.reserve(pix.size());
+		for (const auto& p : pix)
+		{
+			out.emplace_back(to_one_pixel(p));
+		}
+		return ClusterType(std::move(out), to_ns(minToA), to_ns(maxToA), xMax, xMin, yMax, yMin);
+	}
+};
+
 // Cluster type for sending stuff over sockets
 struct CompactClusterType
 {
 	std::vector<OnePixel> pix;
 
-	CompactClusterType(std::vector<OnePixel> pix) : pix(pix)
+	CompactClusterType(std::vector<OnePixel> pix) : pix(std::move(pix))
 	{
 	};
 };
@@ -84,6 +172,36 @@ struct ClusteringParamsOnline
 	int clusterFilterSize;
 	bool filterBiggerClusters;
 	int outerFilterSize;
+
+	// Feeder backpressure - what to do when queued pixels reach highWatermark (bytes), until they drop to lowWatermark
+	int backpressure;			// backpressure_policy
+	int sampleEvery;			// Keep every Nth pixel with backpressure_policy::sample
+	int64_t highWatermark;
+	int64_t lowWatermark;
+
+	// Online clustering threads - pixel stream is cut into time slices clustered in parallel, 1 is single threaded
+	int threads;
+
+	// Encoding of data frames - client asks for one (wire_format), device acknowledges the one it will use
+	int wireFormat;
+
+	// Sending of output - queued frames are sent when they reach sendBatchBytes or the oldest waits sendMaxLatency (ms)
+	int64_t sendBatchBytes;
+	int sendMaxLatency;
+};
+
+enum backpressure_policy
+{
+	block_reader,	// Stop reading the detector pipe - board reports the pixels it could not send as lost
+	drop_oldest,	// Throw away oldest queued pixels
+	sample			// Keep only every sampleEvery-th pixel
+};
+
+enum wire_format
+{
+	wire_text,		// Text frames, understood by every version
+	wire_binary,	// Binary cluster, pixel and pixel_counts frames, packed
+	wire_compact	// Binary frames, delta and varint coded - smallest
 };
 
 struct OnePixelCount
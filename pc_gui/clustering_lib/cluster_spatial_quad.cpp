@@ -4,9 +4,9 @@ uint8_t clustering_spatial_quadtree::QuadTree::depth = 0;
 clustering_spatial_quadtree::Clusters clustering_spatial_quadtree::QuadTree::doneClusters;
 ClusteringParams clustering_spatial_quadtree::QuadTree::params;
 
-void clustering_spatial_quadtree::do_clustering(std::string& lines, const ClusteringParams& params, volatile bool& abort)
+void clustering_spatial_quadtree::do_clustering(text_view lines, const ClusteringParams& params, volatile bool& abort)
 {
-    if (lines == "") return;
+    if (lines.empty()) return;
     if (lines[0] != '#') return;
     stat_reset();
 
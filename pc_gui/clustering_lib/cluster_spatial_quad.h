@@ -548,7 +548,7 @@ class clustering_spatial_quadtree : public clustering_base, public cluster_defin
 	};
 
 public:
-	void do_clustering(std::string& lines, const ClusteringParams& params, volatile bool& abort);
+	void do_clustering(text_view lines, const ClusteringParams& params, volatile bool& abort);
 
 private:
 	void show_progress(bool newOp, int no_lines);
@@ -6,174 +6,45 @@
  */
 
 #include "clustering_baseline.h"
-#include <queue>
 
 /*
 *  IMPORTANT PERFORMANCE COMMENT
 * - inlining getline and strtoint and strtolong improves performance
 *   by circa 4%. But in Bruteforce, it worsens performance.
 */
-void clustering_baseline::do_clustering(std::string& lines, const ClusteringParams& params, volatile bool& abort)
+template <typename Pixel>
+void clustering_baseline_t<Pixel>::do_clustering(text_view lines, const ClusteringParams& params, volatile bool& abort)
 {
-	if (lines == "") return;
-	if (lines[0] != '#') return;
+	if (lines.empty()) return;
+	if (lines[0] != '#' && pixel_binary::is_binary(lines) == false && katherine_readout::is_readout(lines) == false) return;
 	stat_reset();
 
-	// PARAMETERS
-	int upFilter = 255 - params.outerFilterSize;
-	int doFilter = params.outerFilterSize;
-	const double toaLsb = 25;
-	const double toaFineLsb = 1.5625;
-
-	// Loop variables
-	bool prevAdded = false;
-	bool rel{}, relX, relY = false;
-	int lastAddCluster = 0;
-
-	std::string oneLine;
-	char* context = nullptr;
-	char* rows[4] = { 0, 0, 0, 0 };
-	std::queue<OnePixel> pixelData;		// FIFO for pixelData
-
-	while (get_my_line(lines, oneLine, params.rn_delim)) {      // Gets lines without ending line chars - ex. "\n"
-
-		if (oneLine[0] == '#') continue;
-
-		if (oneLine[0] == 'C') return;
-
-		if (abort)
-		{
-			return;
-		}
-
-		stat_lines_sorted++;
-
-		/* Split line into rows */
-		rows[0] = strtok_s(&oneLine.front(), "\t", &context); //strtok(oneLine.data(), "\t");
-		rows[1] = strtok_s(NULL, "\t", &context);
-		rows[2] = strtok_s(NULL, "\t", &context);
-		rows[3] = strtok_s(NULL, "\t", &context);
-
-		// ATOI 6300 ms vs STRTOINT 6100 ms with 20 PIX filter
-		// ATOI CCA 200 ms slower than my Fast strtoint
-		int coordX = strtoint(rows[0]) / 256; // std::atoi(rows[0]) / 256;
-		int coordY = strtoint(rows[0]) % 256; // std::atoi(rows[0]) % 256;
-		double toaAbsTime = (double)((strtolong(rows[1]) * toaLsb) - (strtolong(rows[2]) * toaFineLsb));  // (ns) TimeFromBeginning = 25 * ToA - 1.5625 * fineToA
-		int ToTValue = strtoint(rows[3]);//std::atoi(rows[3]);
-		if (coordX > upFilter || coordX < doFilter || coordY > upFilter || coordY < doFilter) continue;   // This is faster after the inlined funkctions, not after coordY
-
-		if (params.calibReady)
-		{
-			ToTValue = energy_calc(coordX, coordY, ToTValue);
-		}
-
-		pixelData.push(std::move(OnePixel(coordX, coordY, ToTValue, toaAbsTime)));
-		stat_lines_processed++;
-	}
-
-	OnePixel inPixel(0, 0, 0, 0);
-
 	ContinualTimer timer;
 	timer.Start();
-	
-	while (!pixelData.empty())
-	{
-		inPixel = pixelData.front();
-		pixelData.pop();
-
-		for (auto clstr = clusters.begin(); clstr != clusters.end(); clstr++) {
-
-			if ((inPixel.ToA - clstr->maxToA) > static_cast<double>(params.maxClusterDelay)) // Close Old cluster
-			{
-				if (clstr - clusters.begin() > 1)
-				{
-					doneClusters.emplace_back(*clstr);
-					clstr = clusters.erase(clstr);
-					clstr--;
-				}
-
-				continue;
-			}
 
-			/* ToA range check */
-			// NOTE: m_abs() or double-if causes maxClusterSpan to be double sided, downwards and upwards
-			if ((inPixel.ToA - clstr->minToA) > static_cast<double>(params.maxClusterSpan) || (inPixel.ToA - clstr->minToA) < static_cast<double>(-params.maxClusterSpan)) {   // Cant add to this cluster
-				continue;
-			}
+	// Parsed batches flow straight into clustering - whole file is never held as pixels
+	pixel_parser::result parsed = stream_pixels(lines, 0, pixel_parser::katherine_raw, params.outerFilterSize, params.calibReady, abort,
+		[this, &params](const std::vector<OnePixel>& batch) { cluster_pixels(pixel_time<Pixel>::from_pixels(batch, converted), params); });
 
-			/* Decide if its worth to go through this cluster */
-			/* IS TOO FAR UNDER || IS TOO FAR UP */
-			if (inPixel.y < (clstr->yMin - 1) || inPixel.y >(clstr->yMax + 1)) {
-				continue;
-			}
-			if (inPixel.x < (clstr->xMin - 1) || inPixel.x >(clstr->xMax + 1)) {
-				continue;
-			}
-
-			for (const auto& pixs : clstr->pix) {  // Cycle through Pixels of Cluster
-				//for (auto& pixs : reverse(*clstr)) {  // Cycle through Pixels of Cluster
-
-				relX = ((inPixel.x) == (pixs.x + 1)) || ((inPixel.x) == (pixs.x - 1)) || ((inPixel.x) == (pixs.x));    // is (X + 1 == my_X) OR (X - 1 == my_X)
-				relY = ((inPixel.y) == (pixs.y + 1)) || ((inPixel.y) == (pixs.y - 1)) || ((inPixel.y) == (pixs.y));    // is (Y + 1 == my_Y) OR (Y - 1 == my_Y)
-				rel = relX && relY;       // Is related in both X AND Y
-
-				if (rel)    // If Neighbor, add to cluster
-				{
-					if (prevAdded)  // Join clusters
-					{
-						// Join current Cluster into LastAddedTo cluster and Erase the current one
-						clusters[lastAddCluster].pix.insert(clusters[lastAddCluster].pix.end(), clstr->pix.begin(), clstr->pix.end());
-
-						/* Join min max values of clusters */
-						if (clstr->xMax > clusters[lastAddCluster].xMax) clusters[lastAddCluster].xMax = clstr->xMax;
-						if (clstr->xMin < clusters[lastAddCluster].xMin) clusters[lastAddCluster].xMin = clstr->xMin;
-						if (clstr->yMax > clusters[lastAddCluster].yMax) clusters[lastAddCluster].yMax = clstr->yMax;
-						if (clstr->yMin < clusters[lastAddCluster].yMin) clusters[lastAddCluster].yMin = clstr->yMin;
-						if (clstr->minToA < clusters[lastAddCluster].minToA) clusters[lastAddCluster].minToA = clstr->minToA; // Merge ToA min
-						if (clstr->maxToA > clusters[lastAddCluster].maxToA) clusters[lastAddCluster].maxToA = clstr->maxToA; // Merge ToA max
-
-						clstr = clusters.erase(clstr);       // Erase the current Cluster
-						clstr--;
-					}
-					else            // Simply Add Pixel
-					{
-						/* Update Min Max coord values */
-						if (inPixel.x > clstr->xMax) clstr->xMax = inPixel.x;
-						else if (inPixel.x < clstr->xMin) clstr->xMin = inPixel.x;
-						if (inPixel.y > clstr->yMax) clstr->yMax = inPixel.y;
-						else if (inPixel.y < clstr->yMin) clstr->yMin = inPixel.y;
-						if (clstr->minToA > inPixel.ToA) clstr->minToA = inPixel.ToA; // Save ToA min
-						if (clstr->maxToA < inPixel.ToA) clstr->maxToA = inPixel.ToA; // Save ToA max
-
-						OnePixel newPixel = OnePixel{ inPixel.x, inPixel.y, inPixel.ToT, inPixel.ToA };
-						clstr->pix.emplace_back(std::move(newPixel));
-						lastAddCluster = clstr - clusters.begin();
-						prevAdded = true;
-					}
-
-					break;  // Pixel was added to cluster => try NEXT cluster
-				}
-			}
-		}
+	timer.Stop();
 
-		if (prevAdded)    // Reset FLAGS
-		{
-			rel = false;
-			prevAdded = false;
-		}
-		else        // Pixel doesnt match to any Cluster - Place new cluster
-		{
-			ClusterType cluster = ClusterType{ PixelCluster{ OnePixel {(uint16_t)inPixel.x, (uint16_t)inPixel.y, inPixel.ToT, inPixel.ToA} }, inPixel.ToA, inPixel.ToA, (uint16_t)inPixel.x, (uint16_t)inPixel.x, (uint16_t)inPixel.y, (uint16_t)inPixel.y };
-			clusters.emplace_back(std::move(cluster));    // Add new cluster
-		}
+	if (parsed.cluster_marker || abort)
+	{
+		open_clusters.clear();
+		forest.clear();
+		return;
 	}
 
-	timer.Stop();
-
 	/* POSTPROCESS Clusters */
-	doneClusters.insert(doneClusters.end(), clusters.begin(), clusters.end());      // Remaining move to DONE
-	clusters.clear();
-	clusters.shrink_to_fit();
+	for (auto id : open_clusters)	// Remaining move to DONE
+	{
+		doneClusters.emplace_back(take_cluster(id));
+	}
+	open_clusters.clear();
+	open_clusters.shrink_to_fit();
+	forest.clear();
+	converted.clear();
+	converted.shrink_to_fit();
 	doneClusters.shrink_to_fit();
 
 	/* Utility functions after the clustering */
@@ -182,232 +53,197 @@ void clustering_baseline::do_clustering(std::string& lines, const ClusteringPara
 	return;
 }
 
-void clustering_baseline::parse_file_clusters(std::string& lines, const ClusteringParams& params, volatile bool& abort)
+template <typename Pixel>
+void clustering_baseline_t<Pixel>::parse_file_clusters(text_view lines, const ClusteringParams& params, volatile bool& abort)
 {
-	std::string oneLine;
-	const double toaLsb = 25;
-	const double toaFineLsb = 1.5625;
-	char* context = nullptr;
-	char* rows[4] = { 0, 0, 0, 0 };
-	bool newCluster = true;
-
-	while (get_my_line(lines, oneLine, params.rn_delim)) {      // Gets lines without ending line chars - ex. "\n"
+	parse_file_clusters(lines, 0, params, abort);
+}
 
-		if (oneLine[0] == '#') continue;
+template <typename Pixel>
+void clustering_baseline_t<Pixel>::parse_file_clusters(text_view lines, size_t offset, const ClusteringParams& params, volatile bool& abort)
+{
+	std::vector<OnePixel> pixels;
 
+	while (offset < lines.size && abort == false)
+	{
 		// Beginning of cluster
-		if (oneLine[0] == 'C')
+		if (lines[offset] == 'C')
 		{
-			newCluster = true;
+			offset = pixel_parser::next_line(lines, offset);
 			continue;
 		}
 
-		/* Split line into rows */
-		rows[0] = strtok_s(&oneLine.front(), "\t", &context); //strtok(oneLine.data(), "\t");
-		rows[1] = strtok_s(NULL, "\t", &context);
-		rows[2] = strtok_s(NULL, "\t", &context);
-		rows[3] = strtok_s(NULL, "\t", &context);
+		// Pixels of one cluster - until next 'C' line
+		pixels.clear();
+		pixel_parser::result parsed = pixel_parser::parse(lines, offset, pixel_parser::xy_tot_toa, 0, pixels, abort);
 
-		// Convert rows to variables
-		int x = strtoint(rows[0]);
-		int y = strtoint(rows[1]);
-		int ToT = strtoint(rows[2]);
-		double ToA = (double)strtolong(rows[3]);
-
-		// Emplace pixels to clusters
-		if (newCluster == true)
-		{
-			// Emplace whole new cluster
-			doneClusters.emplace_back(ClusterType{ std::vector<OnePixel> { OnePixel {(uint16_t)x, (uint16_t)y, ToT, ToA} }, ToA, ToA, (uint16_t)x, (uint16_t)x, (uint16_t)y, (uint16_t)y });
-			newCluster = false;
-		}
-		else
+		if (pixels.empty() == false)
 		{
-			// emplace one pixel to last cluster
-			doneClusters.back().pix.emplace_back(OnePixel{ (uint16_t)x, (uint16_t)y, ToT, ToA });
+			const OnePixel first = pixels.front();
+			ClusterType cluster{ std::move(pixels), first.ToA, first.ToA, first.x, first.x, first.y, first.y };
 
 			/* Update Min Max coord values */
-			if (x > doneClusters.back().xMax) doneClusters.back().xMax = x;
-			else if (x < doneClusters.back().xMin) doneClusters.back().xMin = x;
-			if (y > doneClusters.back().yMax) doneClusters.back().yMax = y;
-			else if (y < doneClusters.back().yMin) doneClusters.back().yMin = y;
-			if (doneClusters.back().minToA > ToA) doneClusters.back().minToA = ToA; // Save ToA min
-			if (doneClusters.back().maxToA < ToA) doneClusters.back().maxToA = ToA; // Save ToA max
+			for (const auto& pix : cluster.pix)
+			{
+				if (pix.x > cluster.xMax) cluster.xMax = pix.x;
+				else if (pix.x < cluster.xMin) cluster.xMin = pix.x;
+				if (pix.y > cluster.yMax) cluster.yMax = pix.y;
+				else if (pix.y < cluster.yMin) cluster.yMin = pix.y;
+				if (cluster.minToA > pix.ToA) cluster.minToA = pix.ToA; // Save ToA min
+				if (cluster.maxToA < pix.ToA) cluster.maxToA = pix.ToA; // Save ToA max
+			}
+
+			doneClusters.emplace_back(std::move(cluster));
+			pixels = std::vector<OnePixel>();
 		}
+
+		if (parsed.cluster_marker == false) break;
+		offset = parsed.stop;
 	}
 }
 
-void clustering_baseline::do_online_file_clustering(std::string& lines, const ClusteringParams& params, volatile bool& abort)
+template <typename Pixel>
+void clustering_baseline_t<Pixel>::do_online_file_clustering(text_view lines, const ClusteringParams& params, volatile bool& abort)
 {
-	if (lines == "") return;
-	if (lines[0] != '#') return;
+	if (lines.empty()) return;
+	if (lines[0] != '#' && pixel_binary::is_binary(lines) == false && katherine_readout::is_readout(lines) == false) return;
 	stat_reset();
 
-	// PARAMETERS
-	int upFilter = 255 - params.outerFilterSize;
-	int doFilter = params.outerFilterSize;
-	const double toaLsb = 25;
-	const double toaFineLsb = 1.5625;
-
-	// Loop variables
-	bool prevAdded = false;
-	bool rel{}, relX, relY = false;
-	int lastAddCluster = 0;
-
-	std::string oneLine;
-	char* context = nullptr;
-	char* rows[4] = { 0, 0, 0, 0 };
-	std::queue<OnePixel> pixelData;		// FIFO for pixelData
-
-	while (get_my_line(lines, oneLine, params.rn_delim)) {      // Gets lines without ending line chars - ex. "\n"
-
-		if (oneLine[0] == '#') continue;
+	ContinualTimer timer;
+	timer.Start();
 
-		// File contains complete clusters - return after parsing
-		if (oneLine[0] == 'C')
-		{
-			parse_file_clusters(lines, params, abort);
-			return;
-		}
+	pixel_parser::result parsed = stream_pixels(lines, 0, pixel_parser::xy_tot_toa, params.outerFilterSize, params.calibReady, abort,
+		[this, &params](const std::vector<OnePixel>& batch) { cluster_pixels(pixel_time<Pixel>::from_pixels(batch, converted), params); });
 
-		if (abort)
-		{
-			return;
-		}
+	timer.Stop();
 
-		stat_lines_sorted++;
+	// File contains complete clusters - return after parsing
+	if (parsed.cluster_marker)
+	{
+		open_clusters.clear();
+		forest.clear();
+		parse_file_clusters(lines, parsed.stop, params, abort);
+		return;
+	}
 
-		/* Split line into rows */
-		rows[0] = strtok_s(&oneLine.front(), "\t", &context); //strtok(oneLine.data(), "\t");
-		rows[1] = strtok_s(NULL, "\t", &context);
-		rows[2] = strtok_s(NULL, "\t", &context);
-		rows[3] = strtok_s(NULL, "\t", &context);
+	if (abort)
+	{
+		open_clusters.clear();
+		forest.clear();
+		return;
+	}
 
-		// ATOI 6300 ms vs STRTOINT 6100 ms with 20 PIX filter
-		// ATOI CCA 200 ms slower than my Fast strtoint
-		int coordX = strtoint(rows[0]);
-		int coordY = strtoint(rows[1]);
-		int ToTValue = strtoint(rows[2]);
-		double toaAbsTime = (double)(strtolong(rows[3]));
+	/* POSTPROCESS Clusters */
+	for (auto id : open_clusters)	// Remaining move to DONE
+	{
+		doneClusters.emplace_back(take_cluster(id));
+	}
+	open_clusters.clear();
+	open_clusters.shrink_to_fit();
+	forest.clear();
+	converted.clear();
+	converted.shrink_to_fit();
+	doneClusters.shrink_to_fit();
 
-		if (coordX > upFilter || coordX < doFilter || coordY > upFilter || coordY < doFilter) continue;   // This is faster after the inlined funkctions, not after coordY
+	/* Utility functions after the clustering */
+	test_saved_clusters();
+	stat_save(timer.ElapsedMs(), doneClusters.size());
+	return;
+}
 
-		if (params.calibReady)
-		{
-			ToTValue = energy_calc(coordX, coordY, ToTValue);
-		}
+/*
+*  Clustering of parsed pixels - open clusters are roots in forest, open_clusters holds their ids in order of creation.
+*  Joined and closed clusters are dropped from open_clusters by compacting it during the pass.
+*/
+template <typename Pixel>
+void clustering_baseline_t<Pixel>::cluster_pixels(const std::vector<Pixel>& pixelData, const ClusteringParams& params)
+{
+	const TimeType delay = pixel_time<Pixel>::limit(params.maxClusterDelay);
+	const TimeType span = pixel_time<Pixel>::limit(params.maxClusterSpan);
 
-		pixelData.push(std::move(OnePixel(coordX, coordY, ToTValue, toaAbsTime)));
-		stat_lines_processed++;
-	}
+	// Loop variables
+	bool prevAdded = false;
+	size_t lastAddCluster = 0;
 
-	OnePixel inPixel(0, 0, 0, 0);
+	auto inPixel = pixelData.begin();
 
-	ContinualTimer timer;
-	timer.Start();
+	auto isNeighbour = [&inPixel](const Pixel& pixs) {
+		bool relX = ((inPixel->x) == (pixs.x + 1)) || ((inPixel->x) == (pixs.x - 1)) || ((inPixel->x) == (pixs.x));    // is (X + 1 == my_X) OR (X - 1 == my_X)
+		bool relY = ((inPixel->y) == (pixs.y + 1)) || ((inPixel->y) == (pixs.y - 1)) || ((inPixel->y) == (pixs.y));    // is (Y + 1 == my_Y) OR (Y - 1 == my_Y)
+		return relX && relY;       // Is related in both X AND Y
+	};
 
-	while (!pixelData.empty())
+	for (; inPixel != pixelData.end(); ++inPixel)
 	{
-		inPixel = pixelData.front();
-		pixelData.pop();
+		size_t keep = 0;	// Open clusters which stay open after this pixel
+
+		for (size_t i = 0; i < open_clusters.size(); i++) {
 
-		for (auto clstr = clusters.begin(); clstr != clusters.end(); clstr++) {
+			const uint32_t id = open_clusters[i];
+			const auto& clstr = forest.get(id);
 
-			if ((inPixel.ToA - clstr->maxToA) > params.maxClusterDelay) // Close Old cluster
+			if ((inPixel->ToA - clstr.maxToA) > delay) // Close Old cluster
 			{
-				if (clstr - clusters.begin() > 1)
+				if (keep > 1)
 				{
-					doneClusters.emplace_back(*clstr);
-					clstr = clusters.erase(clstr);
-					clstr--;
+					doneClusters.emplace_back(take_cluster(id));
+					continue;
 				}
 
+				open_clusters[keep++] = id;
 				continue;
 			}
 
 			/* ToA range check */
 			// NOTE: m_abs() or double-if causes maxClusterSpan to be double sided, downwards and upwards
-			if ((inPixel.ToA - clstr->minToA) > params.maxClusterSpan || (inPixel.ToA - clstr->minToA) < -params.maxClusterSpan) {   // Cant add to this cluster
+			if ((inPixel->ToA - clstr.minToA) > span || (inPixel->ToA - clstr.minToA) < -span ||   // Cant add to this cluster
+				/* Decide if its worth to go through this cluster */
+				/* IS TOO FAR UNDER || IS TOO FAR UP */
+				(inPixel->y) < (clstr.yMin - 1) || (inPixel->y) > (clstr.yMax + 1) ||
+				(inPixel->x) < (clstr.xMin - 1) || (inPixel->x) > (clstr.xMax + 1) ||
+				forest.any_pixel(id, isNeighbour) == false)   // Cycle through Pixels of Cluster
+			{
+				open_clusters[keep++] = id;
 				continue;
 			}
 
-			/* Decide if its worth to go through this cluster */
-			/* IS TOO FAR UNDER || IS TOO FAR UP */
-			if (inPixel.y < (clstr->yMin - 1) || inPixel.y >(clstr->yMax + 1)) {
-				continue;
-			}
-			if (inPixel.x < (clstr->xMin - 1) || inPixel.x >(clstr->xMax + 1)) {
-				continue;
+			if (prevAdded)  // Join clusters
+			{
+				// Join current Cluster into LastAddedTo cluster, current one is dropped from open clusters
+				open_clusters[lastAddCluster] = forest.unite(open_clusters[lastAddCluster], id);
 			}
-
-			for (const auto& pixs : clstr->pix) {  // Cycle through Pixels of Cluster
-				//for (auto& pixs : reverse(*clstr)) {  // Cycle through Pixels of Cluster
-
-				relX = ((inPixel.x) == (pixs.x + 1)) || ((inPixel.x) == (pixs.x - 1)) || ((inPixel.x) == (pixs.x));    // is (X + 1 == my_X) OR (X - 1 == my_X)
-				relY = ((inPixel.y) == (pixs.y + 1)) || ((inPixel.y) == (pixs.y - 1)) || ((inPixel.y) == (pixs.y));    // is (Y + 1 == my_Y) OR (Y - 1 == my_Y)
-				rel = relX && relY;       // Is related in both X AND Y
-
-				if (rel)    // If Neighbor, add to cluster
-				{
-					if (prevAdded)  // Join clusters
-					{
-						// Join current Cluster into LastAddedTo cluster and Erase the current one
-						clusters[lastAddCluster].pix.insert(clusters[lastAddCluster].pix.end(), clstr->pix.begin(), clstr->pix.end());
-
-						/* Join min max values of clusters */
-						if (clstr->xMax > clusters[lastAddCluster].xMax) clusters[lastAddCluster].xMax = clstr->xMax;
-						if (clstr->xMin < clusters[lastAddCluster].xMin) clusters[lastAddCluster].xMin = clstr->xMin;
-						if (clstr->yMax > clusters[lastAddCluster].yMax) clusters[lastAddCluster].yMax = clstr->yMax;
-						if (clstr->yMin < clusters[lastAddCluster].yMin) clusters[lastAddCluster].yMin = clstr->yMin;
-						if (clstr->minToA < clusters[lastAddCluster].minToA) clusters[lastAddCluster].minToA = clstr->minToA; // Merge ToA min
-						if (clstr->maxToA > clusters[lastAddCluster].maxToA) clusters[lastAddCluster].maxToA = clstr->maxToA; // Merge ToA max
-
-						clstr = clusters.erase(clstr);       // Erase the current Cluster
-						clstr--;
-					}
-					else            // Simply Add Pixel
-					{
-						/* Update Min Max coord values */
-						if (inPixel.x > clstr->xMax) clstr->xMax = inPixel.x;
-						else if (inPixel.x < clstr->xMin) clstr->xMin = inPixel.x;
-						if (inPixel.y > clstr->yMax) clstr->yMax = inPixel.y;
-						else if (inPixel.y < clstr->yMin) clstr->yMin = inPixel.y;
-						if (clstr->minToA > inPixel.ToA) clstr->minToA = inPixel.ToA; // Save ToA min
-						if (clstr->maxToA < inPixel.ToA) clstr->maxToA = inPixel.ToA; // Save ToA max
-
-						OnePixel newPixel = OnePixel{ inPixel.x, inPixel.y, inPixel.ToT, inPixel.ToA };
-						clstr->pix.emplace_back(std::move(newPixel));
-						lastAddCluster = clstr - clusters.begin();
-						prevAdded = true;
-					}
-
-					break;  // Pixel was added to cluster => try NEXT cluster
-				}
+			else            // Simply Add Pixel
+			{
+				forest.add_pixel(id, *inPixel);
+				lastAddCluster = keep;
+				open_clusters[keep++] = id;
+				prevAdded = true;
 			}
 		}
 
+		open_clusters.resize(keep);
+
 		if (prevAdded)    // Reset FLAGS
 		{
-			rel = false;
 			prevAdded = false;
 		}
 		else        // Pixel doesnt match to any Cluster - Place new cluster
 		{
-			ClusterType cluster = ClusterType{ PixelCluster{ OnePixel {(uint16_t)inPixel.x, (uint16_t)inPixel.y, inPixel.ToT, inPixel.ToA} }, inPixel.ToA, inPixel.ToA, (uint16_t)inPixel.x, (uint16_t)inPixel.x, (uint16_t)inPixel.y, (uint16_t)inPixel.y };
-			clusters.emplace_back(std::move(cluster));    // Add new cluster
+			open_clusters.push_back(forest.make_cluster(*inPixel));    // Add new cluster
 		}
 	}
+}
 
-	timer.Stop();
-
-	/* POSTPROCESS Clusters */
-	doneClusters.insert(doneClusters.end(), clusters.begin(), clusters.end());      // Remaining move to DONE
-	clusters.clear();
-	clusters.shrink_to_fit();
-	doneClusters.shrink_to_fit();
-
-	/* Utility functions after the clustering */
-	test_saved_clusters();
-	stat_save(timer.ElapsedMs(), doneClusters.size());
-	return;
+// Materialise closed cluster with ToA in ns and release it
+template <typename Pixel>
+ClusterType clustering_baseline_t<Pixel>::take_cluster(uint32_t id)
+{
+	typedef pixel_time<Pixel> time;
+	const auto& clstr = forest.get(id);
+	ClusterType cluster(forest.template pixels<OnePixel>(id, &time::to_one_pixel), time::to_ns(clstr.minToA), time::to_ns(clstr.maxToA), clstr.xMax, clstr.xMin, clstr.yMax, clstr.yMin);
+	forest.release(id);
+	return cluster;
 }
+
+template class clustering_baseline_t<OnePixelTick>;
+template class clustering_baseline_t<OnePixel>;
@@ -9,15 +9,33 @@
 
 #include "file_loader.h"
 #include "clusering_base.h"
+#include "cluster_forest.h"
 
-class clustering_baseline : public clustering_base, public cluster_definition
+/*
+*	Baseline clustering - templated on pixel type used inside (OnePixelTick or OnePixel)
+*	- parsed pixels are converted to Pixel per batch, open clusters keep Pixel
+*	- closed clusters are handed out as ClusterType with ToA in ns
+*/
+
+template <typename Pixel>
+class clustering_baseline_t : public clustering_base, public cluster_definition
 {
 	public:
-		void do_clustering(std::string& lines, const ClusteringParams& params, volatile bool& abort);
-		void parse_file_clusters(std::string& lines, const ClusteringParams& params, volatile bool& abort);
-		void do_online_file_clustering(std::string& lines, const ClusteringParams& params, volatile bool& abort);
+		void do_clustering(text_view lines, const ClusteringParams& params, volatile bool& abort);
+		void parse_file_clusters(text_view lines, const ClusteringParams& params, volatile bool& abort);
+		void do_online_file_clustering(text_view lines, const ClusteringParams& params, volatile bool& abort);
 
 	private:
+		typedef typename pixel_time<Pixel>::TimeType TimeType;
+
+		cluster_forest<Pixel> forest;			// Storage of open clusters
+		std::vector<uint32_t> open_clusters;	// Roots of open clusters in order of creation
+		std::vector<Pixel> converted;			// Batch converted to Pixel
+
+		void cluster_pixels(const std::vector<Pixel>& pixelData, const ClusteringParams& params);
+		ClusterType take_cluster(uint32_t id);
+		void parse_file_clusters(text_view lines, size_t offset, const ClusteringParams& params, volatile bool& abort);
+
 		// Test whether saved clusters are saved correctly
 		void test_saved_clusters()
 		{
@@ -30,3 +48,6 @@ class clustering_baseline : public clustering_base, public cluster_definition
 		}
 };
 
+typedef clustering_baseline_t<OnePixelTick> clustering_baseline;		// Integer ticks - default
+typedef clustering_baseline_t<OnePixel> clustering_baseline_double;	// ToA in double ns - kept for compatibility
+
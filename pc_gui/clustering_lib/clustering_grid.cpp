@@ -0,0 +1,297 @@
+
+/**
+ * @clustering_grid.cpp
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+#include "clustering_grid.h"
+
+template <typename Pixel>
+clustering_grid_t<Pixel>::clustering_grid_t()
+{
+	grid.resize(GRID_SIZE * GRID_SIZE);
+	reset_grid();
+}
+
+template <typename Pixel>
+void clustering_grid_t<Pixel>::do_clustering(text_view lines, const ClusteringParams& params, volatile bool& abort)
+{
+	if (lines.empty()) return;
+	if (lines[0] != '#' && pixel_binary::is_binary(lines) == false && katherine_readout::is_readout(lines) == false) return;
+	stat_reset();
+	reset_grid();
+
+	ContinualTimer timer;
+	timer.Start();
+
+	pixel_parser::result parsed = stream_pixels(lines, 0, pixel_parser::katherine_raw, params.outerFilterSize, params.calibReady, abort,
+		[this, &params](const std::vector<OnePixel>& batch) {
+			for (const auto& pixel : pixel_time<Pixel>::from_pixels(batch, converted))
+			{
+				process_pixel(pixel, params);
+			}
+		});
+
+	timer.Stop();
+
+	if (parsed.cluster_marker || abort) return;
+
+	/* POSTPROCESS Clusters */
+	close_all_clusters();	// Remaining move to DONE
+	doneClusters.shrink_to_fit();
+
+	/* Utility functions after the clustering */
+	test_saved_clusters();
+	stat_save(timer.ElapsedMs(), doneClusters.size());
+	return;
+}
+
+// Clear all the open cluster state - grid entries are invalidated by generation 0
+template <typename Pixel>
+void clustering_grid_t<Pixel>::reset_grid()
+{
+	const grid_entry empty = { 0, 0, 0 };
+	for (auto& cell : grid)
+	{
+		cell.last = empty;
+		cell.prev = empty;
+	}
+
+	slots.clear();
+	slots.shrink_to_fit();
+	free_slots.clear();
+	expiry = decltype(expiry)();
+	doneClusters.clear();
+	doneClusters.shrink_to_fit();
+}
+
+template <typename Pixel>
+void clustering_grid_t<Pixel>::process_pixel(const Pixel& pixel, const ClusteringParams& params)
+{
+	close_clusters(pixel.ToA, params);	// Close old clusters
+
+	uint32_t candidates[MAX_CANDIDATES];
+	int numCandidates = find_candidates(pixel, params, candidates);
+	uint32_t target = 0;
+
+	if (numCandidates == 0)	// Pixel doesnt match to any Cluster - Place new cluster
+	{
+		target = new_cluster(pixel);
+	}
+	else
+	{
+		// Join into the biggest cluster - we move (and relabel) as few pixels as possible
+		target = candidates[0];
+		for (int i = 1; i < numCandidates; i++)
+		{
+			if (slots[candidates[i]].cluster.pix.size() > slots[target].cluster.pix.size()) target = candidates[i];
+		}
+
+		for (int i = 0; i < numCandidates; i++)
+		{
+			if (candidates[i] != target) join_clusters(target, candidates[i]);
+		}
+
+		/* Update Min Max coord values */
+		open_cluster& clstr = slots[target].cluster;
+		if (pixel.x > clstr.xMax) clstr.xMax = pixel.x;
+		else if (pixel.x < clstr.xMin) clstr.xMin = pixel.x;
+		if (pixel.y > clstr.yMax) clstr.yMax = pixel.y;
+		else if (pixel.y < clstr.yMin) clstr.yMin = pixel.y;
+		if (clstr.minToA > pixel.ToA) clstr.minToA = pixel.ToA; // Save ToA min
+		if (clstr.maxToA < pixel.ToA) clstr.maxToA = pixel.ToA; // Save ToA max
+
+		clstr.pix.emplace_back(pixel);
+	}
+
+	// Remember the pixel in grid
+	grid_cell& cell = grid[(pixel.y * GRID_SIZE) + pixel.x];
+	const grid_entry entry = { target, slots[target].generation, pixel.ToA };
+
+	if (cell.last.cluster != target || cell.last.generation != entry.generation) cell.prev = cell.last;
+	cell.last = entry;
+}
+
+// Find all distinct open clusters in the 3x3 neighbourhood, which pixel can join
+template <typename Pixel>
+int clustering_grid_t<Pixel>::find_candidates(const Pixel& pixel, const ClusteringParams& params, uint32_t* candidates)
+{
+	const TimeType span = pixel_time<Pixel>::limit(params.maxClusterSpan);
+	int numCandidates = 0;
+
+	const int xFrom = (pixel.x > 0) ? pixel.x - 1 : 0;
+	const int xTo = (pixel.x < GRID_SIZE - 1) ? pixel.x + 1 : GRID_SIZE - 1;
+	const int yFrom = (pixel.y > 0) ? pixel.y - 1 : 0;
+	const int yTo = (pixel.y < GRID_SIZE - 1) ? pixel.y + 1 : GRID_SIZE - 1;
+
+	for (int y = yFrom; y <= yTo; y++)
+	{
+		for (int x = xFrom; x <= xTo; x++)
+		{
+			const grid_cell& cell = grid[(y * GRID_SIZE) + x];
+			const grid_entry* entries[2] = { &cell.last, &cell.prev };
+
+			for (const grid_entry* entry : entries)
+			{
+				if (entry->generation == 0) continue;	// Never hit
+
+				// Cluster minToA is <= entry ToA -> if the entry is out of span, the whole cluster is
+				if ((pixel.ToA - entry->ToA) > span) continue;
+
+				const grid_cluster& slot = slots[entry->cluster];
+				if (slot.generation != entry->generation || slot.open == false) continue;	// Cluster was closed or joined
+
+				/* ToA range check - double sided, same as baseline */
+				if ((pixel.ToA - slot.cluster.minToA) > span || (pixel.ToA - slot.cluster.minToA) < -span) continue;
+
+				bool found = false;
+				for (int i = 0; i < numCandidates; i++)
+				{
+					if (candidates[i] == entry->cluster)
+					{
+						found = true;
+						break;
+					}
+				}
+
+				if (found == false) candidates[numCandidates++] = entry->cluster;
+			}
+		}
+	}
+
+	return numCandidates;
+}
+
+template <typename Pixel>
+uint32_t clustering_grid_t<Pixel>::new_cluster(const Pixel& pixel)
+{
+	uint32_t slot = 0;
+
+	if (free_slots.empty())
+	{
+		slot = static_cast<uint32_t>(slots.size());
+		slots.emplace_back();
+	}
+	else
+	{
+		slot = free_slots.back();
+		free_slots.pop_back();
+	}
+
+	grid_cluster& gc = slots[slot];
+	gc.cluster = open_cluster{ std::vector<Pixel>{ pixel }, pixel.ToA, pixel.ToA, pixel.x, pixel.x, pixel.y, pixel.y };
+	gc.open = true;
+	expiry.push(expiry_entry{ pixel.ToA, slot, gc.generation });
+
+	return slot;
+}
+
+// Join source cluster into target cluster and release the source slot
+template <typename Pixel>
+void clustering_grid_t<Pixel>::join_clusters(uint32_t target, uint32_t source)
+{
+	open_cluster& to = slots[target].cluster;
+	open_cluster& from = slots[source].cluster;
+	const uint32_t sourceGen = slots[source].generation;
+	const uint32_t targetGen = slots[target].generation;
+
+	// Relabel the grid entries still pointing to the source cluster
+	for (const auto& pix : from.pix)
+	{
+		grid_cell& cell = grid[(pix.y * GRID_SIZE) + pix.x];
+
+		if (cell.last.cluster == source && cell.last.generation == sourceGen)
+		{
+			cell.last.cluster = target;
+			cell.last.generation = targetGen;
+		}
+		if (cell.prev.cluster == source && cell.prev.generation == sourceGen)
+		{
+			cell.prev.cluster = target;
+			cell.prev.generation = targetGen;
+		}
+	}
+
+	to.pix.insert(to.pix.end(), from.pix.begin(), from.pix.end());
+
+	/* Join min max values of clusters */
+	if (from.xMax > to.xMax) to.xMax = from.xMax;
+	if (from.xMin < to.xMin) to.xMin = from.xMin;
+	if (from.yMax > to.yMax) to.yMax = from.yMax;
+	if (from.yMin < to.yMin) to.yMin = from.yMin;
+	if (from.minToA < to.minToA) to.minToA = from.minToA; // Merge ToA min
+	if (from.maxToA > to.maxToA) to.maxToA = from.maxToA; // Merge ToA max
+
+	release_slot(source);
+}
+
+template <typename Pixel>
+void clustering_grid_t<Pixel>::release_slot(uint32_t slot)
+{
+	grid_cluster& gc = slots[slot];
+	gc.open = false;
+	gc.generation++;
+	if (gc.generation == 0) gc.generation = 1;	// 0 is reserved for empty entries
+	gc.cluster.pix.clear();
+	gc.cluster.pix.shrink_to_fit();
+	free_slots.push_back(slot);
+}
+
+// Move clusters which cant be joined anymore to doneClusters
+// Heap entries are lazy - maxToA is updated only when the entry gets to the top
+template <typename Pixel>
+void clustering_grid_t<Pixel>::close_clusters(TimeType ToA, const ClusteringParams& params)
+{
+	const TimeType delay = pixel_time<Pixel>::limit(params.maxClusterDelay);
+
+	while (!expiry.empty() && (ToA - expiry.top().maxToA) > delay)
+	{
+		expiry_entry top = expiry.top();
+		expiry.pop();
+
+		grid_cluster& gc = slots[top.slot];
+		if (gc.generation != top.generation || gc.open == false) continue;	// Joined into another cluster
+
+		if ((ToA - gc.cluster.maxToA) > delay)
+		{
+			done_cluster(gc.cluster);
+			release_slot(top.slot);
+		}
+		else	// Cluster got new pixels since the entry was pushed
+		{
+			top.maxToA = gc.cluster.maxToA;
+			expiry.push(top);
+		}
+	}
+}
+
+template <typename Pixel>
+void clustering_grid_t<Pixel>::close_all_clusters()
+{
+	for (auto& gc : slots)
+	{
+		if (gc.open == false) continue;
+
+		done_cluster(gc.cluster);
+		gc.open = false;
+	}
+
+	slots.clear();
+	slots.shrink_to_fit();
+	free_slots.clear();
+	free_slots.shrink_to_fit();
+	expiry = decltype(expiry)();
+	converted.clear();
+	converted.shrink_to_fit();
+}
+
+// Hand out cluster with ToA in ns, its pixels are moved out
+template <typename Pixel>
+void clustering_grid_t<Pixel>::done_cluster(open_cluster& cluster)
+{
+	doneClusters.emplace_back(pixel_time<Pixel>::to_cluster(std::move(cluster.pix), cluster.minToA, cluster.maxToA, cluster.xMax, cluster.xMin, cluster.yMax, cluster.yMin));
+}
+
+template class clustering_grid_t<OnePixelTick>;
+template class clustering_grid_t<OnePixel>;
@@ -0,0 +1,112 @@
+
+/**
+ * @clustering_grid.h
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+#pragma once
+
+#include "file_loader.h"
+#include "clusering_base.h"
+#include <queue>
+
+/*
+*	Occupancy grid clustering
+*	- every pixel of the 256x256 matrix remembers which open clusters hit it last and when
+*	- new pixel finds its neighbours by looking into its 8 surrounding cells (+ its own cell),
+*	  instead of scanning all open clusters and all of their pixels
+*	- open clusters are closed through min-heap ordered by maxToA, so old clusters
+*	  close at the same pixel as in the baseline without walking all of them
+*	- gives the same clusters as clustering_baseline for the same ClusteringParams
+*	- templated on pixel type used inside (OnePixelTick or OnePixel), same as clustering_baseline_t
+*/
+
+template <typename Pixel>
+class clustering_grid_t : public clustering_base, public cluster_definition
+{
+public:
+	clustering_grid_t();
+
+	void do_clustering(text_view lines, const ClusteringParams& params, volatile bool& abort);
+
+private:
+	typedef typename pixel_time<Pixel>::TimeType TimeType;
+
+	static const int GRID_SIZE = 256;
+	static const int MAX_CANDIDATES = 18;	// (8 neighbours + own cell) * 2 entries per cell
+
+	struct grid_entry
+	{
+		uint32_t cluster;		// Index into open cluster slots
+		uint32_t generation;	// Generation of the slot when the entry was written, 0 == empty
+		TimeType ToA;			// ToA of the last pixel of this cluster on this cell
+	};
+
+	// Cell keeps the last two distinct clusters which hit it - when pixels come slightly out of
+	// ToA order, previous cluster on the same coordinate can still be joined after being overwritten
+	struct grid_cell
+	{
+		grid_entry last;
+		grid_entry prev;
+	};
+
+	struct open_cluster
+	{
+		std::vector<Pixel> pix;
+		TimeType minToA;
+		TimeType maxToA;
+		uint16_t xMax;
+		uint16_t xMin;
+		uint16_t yMax;
+		uint16_t yMin;
+	};
+
+	struct grid_cluster
+	{
+		open_cluster cluster;
+		uint32_t generation;	// Bumped every time slot is released -> invalidates old grid entries
+		bool open;
+
+		grid_cluster() : cluster{ std::vector<Pixel>{}, 0, 0, 0, 0, 0, 0 }, generation(1), open(false) {};
+	};
+
+	struct expiry_entry
+	{
+		TimeType maxToA;
+		uint32_t slot;
+		uint32_t generation;
+
+		bool operator>(const expiry_entry& other) const { return maxToA > other.maxToA; };
+	};
+
+	std::vector<grid_cell> grid;			// 256 * 256 cells, indexed (y * 256) + x
+	std::vector<grid_cluster> slots;		// Storage for open clusters, reused after closing
+	std::vector<uint32_t> free_slots;		// Released slots ready for reuse
+	std::priority_queue<expiry_entry, std::vector<expiry_entry>, std::greater<expiry_entry>> expiry;	// Oldest maxToA on top
+
+	void reset_grid();
+	std::vector<Pixel> converted;			// Batch converted to Pixel
+
+	void process_pixel(const Pixel& pixel, const ClusteringParams& params);
+	int find_candidates(const Pixel& pixel, const ClusteringParams& params, uint32_t* candidates);
+	uint32_t new_cluster(const Pixel& pixel);
+	void join_clusters(uint32_t target, uint32_t source);
+	void release_slot(uint32_t slot);
+	void close_clusters(TimeType ToA, const ClusteringParams& params);
+	void done_cluster(open_cluster& cluster);
+	void close_all_clusters();
+
+	void test_saved_clusters()
+	{
+		for (const auto& clstr : doneClusters) {
+			for (const auto& pixs : clstr.pix) {
+				stat_lines_saved++;
+				assert("Limits do not match included pixels" && (pixs.x > clstr.xMax || pixs.x < clstr.xMin || pixs.y > clstr.yMax || pixs.y < clstr.yMin) == false);
+			}
+		}
+	}
+};
+
+typedef clustering_grid_t<OnePixelTick> clustering_grid;		// Integer ticks - default
+typedef clustering_grid_t<OnePixel> clustering_grid_double;		// ToA in double ns - kept for compatibility
@@ -8,83 +8,36 @@
  */
 
 #include "clustering_quadtree.h"
-#include <queue>
 
 /*
 *  IMPORTANT PERFORMANCE COMMENT
 * - inlining getline and strtoint and strtolong improves performance
 *   by circa 4%. But in Bruteforce, it worsens performance.
 */
-void clustering_quadtree::do_clustering(std::string& lines, const ClusteringParams& params, volatile bool& abort)
+void clustering_quadtree::do_clustering(text_view lines, const ClusteringParams& params, volatile bool& abort)
 {
-	if (lines == "") return;
-	if (lines[0] != '#') return;
+	if (lines.empty()) return;
+	if (lines[0] != '#' && pixel_binary::is_binary(lines) == false && katherine_readout::is_readout(lines) == false) return;
 	stat_reset();
 
-	// PARAMETERS
-	int upFilter = 255 - params.outerFilterSize;
-	int doFilter = params.outerFilterSize;
-	double toaLsb = 25;
-	double toaFineLsb = 1.5625;
-
-	// Loop variables
-	bool prevAdded = false;
-
-	std::string oneLine;
-	char* context = nullptr;
-	char* rows[4] = { 0, 0, 0, 0 };
-
-	std::queue<OnePixel> pixelData;
-
-	while (get_my_line(lines, oneLine, params.rn_delim)) {      // Gets lines without ending line chars - ex. "\n"
-
-		if (oneLine[0] == '#') continue;
-
-		if (abort)
-		{
-			return;
-		}
-
-		stat_lines_sorted++;
-
-		/* Split line into rows */
-		rows[0] = strtok_s(&oneLine.front(), "\t", &context); //strtok(oneLine.data(), "\t");
-		rows[1] = strtok_s(NULL, "\t", &context);
-		rows[2] = strtok_s(NULL, "\t", &context);
-		rows[3] = strtok_s(NULL, "\t", &context);
-
-		// ATOI 6300 ms vs STRTOINT 6100 ms with 20 PIX filter
-		// ATOI CCA 200 ms slower than my Fast strtoint
-		int coordX = strtoint(rows[0]) / 256; // std::atoi(rows[0]) / 256;
-		int coordY = strtoint(rows[0]) % 256; // std::atoi(rows[0]) % 256;
-		double toaAbsTime = (double)((strtolong(rows[1]) * toaLsb) - (strtolong(rows[2]) * toaFineLsb));  // (ns) TimeFromBeginning = 25 * ToA - 1.5625 * fineToA
-		int ToTValue = strtoint(rows[3]);//std::atoi(rows[3]);
-		if (coordX > upFilter || coordX < doFilter || coordY > upFilter || coordY < doFilter) continue;   // This is faster after the inlined funkctions, not after coordY
-
-		if (params.calibReady)
-		{
-			pixelData.front().ToT = energy_calc(pixelData.front().x, pixelData.front().y, pixelData.front().ToT);
-			//pixelData.front().ToT = get_energy_lut(pixelData.front().x, pixelData.front().y, pixelData.front().ToT);
-		}
-
-		pixelData.push(std::move(OnePixel(coordX, coordY, ToTValue, toaAbsTime)));
-		stat_lines_processed++;
-	}
-
-	if (params.calibReady) // Calibrate with LUT
-	{
-		//create_energy_lut(800);
-	}
-
 	ContinualTimer timer;
 	timer.Start();
 
-	while (!pixelData.empty())
+	stream_pixels(lines, 0, pixel_parser::katherine_raw, params.outerFilterSize, params.calibReady, abort,
+		[this, &params](const std::vector<OnePixel>& batch) {
+			for (OnePixel pixel : batch)
+			{
+				ProcessPixelData(pixel, params);
+			}
+		});
+
+	timer.Stop();
+
+	if (abort)
 	{
-		ProcessPixelData(pixelData.front(), params);
-		pixelData.pop();
+		openClusters.clear();
+		return;
 	}
-	timer.Stop();
 
 	/* POSTPROCESS Clusters */
 	CloseClusters();      // Remaining move to DONE
@@ -20,7 +20,7 @@ class clustering_quadtree: public clustering_base, public ClusterData
 	std::size_t counter_;
 
 public:
-	void do_clustering(std::string& lines, const ClusteringParams& params, volatile bool& abort);
+	void do_clustering(text_view lines, const ClusteringParams& params, volatile bool& abort);
 	void ProcessPixelData(OnePixel& pixel_data, const ClusteringParams& params);
 	void CloseClusters(size_t time_delay);
 	void CloseClusters();
@@ -10,9 +10,9 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 
-void clustering_time_parallelisation::do_clustering(std::string& lines, const ClusteringParams& new_params, volatile bool& abort)
+void clustering_time_parallelisation::do_clustering(text_view lines, const ClusteringParams& new_params, volatile bool& abort)
 {
-	if (lines == "") return;
+	if (lines.empty()) return;
 	if (lines[0] != '#') return;
 	stat_reset();
 	log_clear();
@@ -30,8 +30,8 @@ void clustering_time_parallelisation::do_clustering(std::string& lines, const Cl
 	if (numOfThreads == 0) numOfThreads = 1;
 	log_append(utility::print_time_info("Threads", "t", numOfThreads));
 
-	std::vector<std::string> inputs_for_threads;
-	SeparateFileST(lines, inputs_for_threads);		// Separate file into small chunks - destructive for "lines"
+	std::vector<text_view> inputs_for_threads;
+	SeparateFileST(lines, inputs_for_threads);		// Separate file into small chunks - views, nothing is copied
 
 	ContinualTimer timer;
 	timer.Start();
@@ -49,7 +49,7 @@ void clustering_time_parallelisation::do_clustering(std::string& lines, const Cl
 	uint16_t t_num = 0;	// Num of thread sent to worker
 	for (auto& qu : inputs_for_threads)	/* Create threads and run clustering */
 	{	
-		workers.push_back(std::thread(t_clustering, this, t_num, std::ref(qu), params));
+		workers.push_back(std::thread(t_clustering, this, t_num, qu, params));
 		//log_append(log_append(utility::print_time_info("t_num", "t", t_num)));
 		t_num++;
 
@@ -94,56 +94,16 @@ void clustering_time_parallelisation::do_clustering(std::string& lines, const Cl
 	return;
 }
 
-void clustering_time_parallelisation::ProcessDataQueue(uint16_t thread_num, std::string& thread_lines, const ClusteringParams t_params)
+void clustering_time_parallelisation::ProcessDataQueue(uint16_t thread_num, text_view thread_lines, const ClusteringParams t_params)
 {
-	std::string oneLine;
-	char* rows[4] = { 0, 0, 0, 0 };		// Temp storage for txt numerals
-	bool delim = t_params.rn_delim;		// Type of delimiter
-	std::queue<OnePixel> pixelData;		// FIFO for pixelData
-	
-	// PARAMETERS
-	int upFilter = 255 - t_params.outerFilterSize;
-	int doFilter = t_params.outerFilterSize;
-	const double toaLsb = 25;
-	const double toaFineLsb = 1.5625;
-
-	// Positions in file "thread_lines" - must be becuase of threads - they cant share static variables in function
-	size_t last_pos = 0;
-	size_t pos = 0;
-
-	while (m_get_my_line_MT(thread_lines, oneLine, delim, last_pos, pos)) {      // Gets lines without ending line chars - ex. "\n"
-
-		if (oneLine[0] == '#') continue;
-
-		if (abort)
-		{
-			return;
-		}
+	std::vector<OnePixel> pixelData;	// Pixels of this thread in ToA order
 
-		stat_lines_sorted++;
+	// Parser keeps its position locally - threads do not share any state while parsing
+	parse_pixels(thread_lines, 0, pixel_parser::katherine_raw, t_params.outerFilterSize, t_params.calibReady, pixelData, abort);
 
-		/* Split line into rows */
-		rows[0] = strtok(strdup(oneLine.data()), "\t");
-		rows[1] = strtok(NULL, "\t");
-		rows[2] = strtok(NULL, "\t");
-		rows[3] = strtok(NULL, "\t");
-
-		// ATOI 6300 ms vs STRTOINT 6100 ms with 20 PIX filter
-		// ATOI CCA 200 ms slower than my Fast strtoint
-		int coordX = strtoint(rows[0]) / 256; // std::atoi(rows[0]) / 256;
-		int coordY = strtoint(rows[0]) % 256; // std::atoi(rows[0]) % 256;
-		double toaAbsTime = (double)((strtolong(rows[1]) * toaLsb) - (strtolong(rows[2]) * toaFineLsb));  // (ns) TimeFromBeginning = 25 * ToA - 1.5625 * fineToA
-		int ToTValue = strtoint(rows[3]);//std::atoi(rows[3]);
-		if (coordX > upFilter || coordX < doFilter || coordY > upFilter || coordY < doFilter) continue;   // This is faster after the inlined funkctions, not after coordY
-
-		if (t_params.calibReady)
-		{
-			ToTValue = static_cast<int>(energy_calc(coordX, coordY, ToTValue));
-		}
-
-		// Push new Pixel to most recent queue
-		pixelData.push(std::move(OnePixel(coordX, coordY, ToTValue, toaAbsTime)));
-		stat_lines_processed++;
+	if (abort)
+	{
+		return;
 	}
 
 	/* The idea is I will not use "lock" on shared Cluster variables, but I will create unique variables for
@@ -156,10 +116,9 @@ void clustering_time_parallelisation::ProcessDataQueue(uint16_t thread_num, std:
 	threadData.firstToA = static_cast<uint64_t>(pixelData.front().ToA);	// We derive clusters for merging from this
 
 	/* Process all pixel data like FIFO */
-	while (!pixelData.empty())
+	for (auto& pixel : pixelData)
 	{
-		ProcessPixel(pixelData.front(), open_clusters_back, thread_done_clusters, open_pixels_front, threadData);
-		pixelData.pop();
+		ProcessPixel(pixel, open_clusters_back, thread_done_clusters, open_pixels_front, threadData);
 	}
 
 	if (numOfThreads > 1)	// Only in case of multiple threads
@@ -21,10 +21,10 @@ class clustering_time_parallelisation : public clustering_base, public cluster_d
 public:
 	clustering_time_parallelisation(volatile bool& abrt) : abort(abrt) {};
 
-	void do_clustering(std::string& lines, const ClusteringParams& new_params, volatile bool& abort);
+	void do_clustering(text_view lines, const ClusteringParams& new_params, volatile bool& abort);
 
 private:
-	void ProcessDataQueue(uint16_t thread_num, std::string& thread_lines, const ClusteringParams params);
+	void ProcessDataQueue(uint16_t thread_num, text_view thread_lines, const ClusteringParams params);
 	void ProcessPixel(OnePixel& pixel_data, Clusters& open_clusters, Clusters& thread_done_clusters);
 	void ProcessPixel(OnePixel& pixel_data, Clusters& open_clusters, Clusters& thread_done_clusters, std::queue<OnePixel>& clusters_for_merge, const thread_data& thread_first_toa);
 	void ProcessPixelAlgorithm(OnePixel& pixel_data, Clusters& open_clusters, Clusters& thread_done_clusters);
@@ -51,11 +51,11 @@ private:
 	/// <summary>
 	/// Extract number of hits from the input file - its in the couple of last characters of file
 	/// </summary>
-	size_t GetNumOfHits(std::string& lines)
+	size_t GetNumOfHits(text_view lines)
 	{
 		size_t hits = -1;
 
-		size_t lines_size = lines.size();	// for extracting last 300 chars from string
+		size_t lines_size = lines.length();	// for extracting last 300 chars from string
 		if (lines_size < 300) return -1;	// error, file is too short
 		else
 			lines_size -= 300;				// go to pos -300 from end to get last 300 chars
@@ -88,78 +88,29 @@ private:
 		return hits;
 	}
 
-	/// <summary>
-	/// Finds end of line in a given file provided by str_it
-	/// </summary>
-	void FindEndOfLine(size_t& read_until, std::string::iterator& str_it)
-	{
-		int num_loop = 0;
-		while (true)	// now we jumped at some point. we find end of the line
-		{
-			if (*str_it == '\n')	// end of the line for both /r/n and /n
-			{
-				read_until++;
-				break;
-			}
-			else
-			{
-				read_until++;
-				str_it++;
-			}
-
-			// return from dead loop - error
-			num_loop++;
-			if (num_loop > 1000)
-				return;
-		}
-	}
-
 	/// <summary>
 	/// Separates the original file content "lines" to equal portions in number of threads "numOfThreads".
+	/// Portions are views into "lines", every portion except the last one ends with '\n'.
 	/// </summary>
-	void SeparateFileST(std::string& lines, std::vector<std::string>& inputs_for_threads)
+	void SeparateFileST(text_view lines, std::vector<text_view>& inputs_for_threads)
 	{
-		const int sizeStep = lines.size() / numOfThreads;
+		const size_t sizeStep = lines.size / numOfThreads;
+		size_t begin = 0;
 
 		for (int i = 0; i < numOfThreads; i++)
 		{
-			std::string substr;
+			size_t read_until = lines.size;		// last portion should be rest of the file
+
 			if (i < numOfThreads - 1)
 			{
-				// Jump the sizeStep with iterator
-				auto str_it = lines.begin() + sizeStep;
-				size_t read_until = sizeStep;
-				FindEndOfLine(read_until, str_it);
-
-				// emplace chunk of file to vector and delete it from input
-				substr = lines.substr(0, read_until);
-				inputs_for_threads.emplace_back(substr);
-				lines.erase(lines.begin(), lines.begin() + read_until);
-				lines.shrink_to_fit();
-			}
-			else // last substr should be rest of the file
-			{
-				// emplace rest of the file to vector
-				substr = lines;
-				inputs_for_threads.emplace_back(substr);
-				lines.clear();
-				lines.shrink_to_fit();
+				// Jump the sizeStep and find end of the line there
+				const size_t eol = lines.find('\n', begin + sizeStep);
+				if (eol != std::string::npos) read_until = eol + 1;
 			}
-		}
-	}
 
-	bool m_get_my_line_MT(std::string& str, std::string& oneLine, bool& rn_delim, size_t& last_pos, size_t& pos)
-	{
-		pos = str.find('\n', pos + 1);
-
-		if (rn_delim) oneLine = str.substr(last_pos, pos - last_pos - 1);
-		else oneLine = str.substr(last_pos, pos - last_pos);
-
-		last_pos = pos + 1;
-
-		if (pos != std::string::npos) return true;
-		else return false;
+			inputs_for_threads.emplace_back(lines.data + begin, read_until - begin);
+			begin = read_until;
+		}
 	}
-
 };
 
@@ -8,9 +8,9 @@
 #include "clustering_time_embed.h"
 #include <cassert>
 
-void clustering_time_embed::do_clustering(std::string& lines, const ClusteringParams& new_params, volatile bool& abort)
+void clustering_time_embed::do_clustering(text_view lines, const ClusteringParams& new_params, volatile bool& abort)
 {
-	if (lines == "") return;
+	if (lines.empty()) return;
 	if (lines[0] != '#') return;
 	stat_reset();
 	log_clear();
@@ -44,7 +44,7 @@ void clustering_time_embed::do_clustering(std::string& lines, const ClusteringPa
 
 	/* Start data passing thread */
 	auto t_passLine = &clustering_time_embed::PassLineToSeparator;
-	auto t_passer = std::thread(t_passLine, this, std::ref(lines));
+	auto t_passer = std::thread(t_passLine, this, lines);
 
 	/* Start thread data separator */
 	auto t_dataSeparator = &clustering_time_embed::SeparateFileIntoThreadsCont;
@@ -32,7 +32,7 @@ class clustering_time_embed : public clustering_base, public cluster_definition
 public:
 	clustering_time_embed(volatile bool& abrt) : abort(abrt) {};
 
-	void do_clustering(std::string& lines, const ClusteringParams& new_params, volatile bool& abort);
+	void do_clustering(text_view lines, const ClusteringParams& new_params, volatile bool& abort);
 
 private:
 	void ProcessDispatchStation(uint16_t thread_num, const ClusteringParams params);
@@ -95,7 +95,7 @@ private:
 	std::mutex parsingMtx;
 	std::mutex sendingMtx;
 
-	void PassLineToSeparator(std::string& lines)
+	void PassLineToSeparator(text_view lines)
 	{
 		std::string oneLine;
 		while (get_my_line(lines, oneLine, params.rn_delim))
@@ -6,7 +6,20 @@
  */
 
 #include "file_loader.h"
+#include "pixel_binary.h"
+#include "katherine_readout.h"
 #include <fstream>
+#include <cstring>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 // load default file which should yield 2570 clusters
 std::string file_loader::loadDefaultFile()
@@ -29,16 +42,16 @@ void file_loader::loadPixelData(std::string path, std::string& input)
     
     if (in)
     {
-        unsigned int off = 0;
+        size_t off = 0;
         in.seekg(0, std::ios::end);
-        int size = static_cast<int>(in.tellg());
+        size_t size = static_cast<size_t>(in.tellg());
         in.seekg(0, std::ios::beg);
         while (in.peek() != '#') {
             in.seekg(++off, std::ios::beg); // run to the first '#' char - some rubbish was added to front of string
-            if (off > 10000) return;        // Error
+            if (off > mapped_file::MAX_RUBBISH) return;        // Error
         }
         input.resize(size - off);           // We have to resize the string first - or size == 0 -> undefined behaviour
-        in.read(&input[0], size - off);
+        in.read(&input[0], static_cast<std::streamsize>(size - off));
         in.close();
     }
     else {
@@ -48,6 +61,113 @@ void file_loader::loadPixelData(std::string path, std::string& input)
     return;
 }
 
+// Map default file which should yield 2570 clusters
+bool file_loader::mapDefaultFile(mapped_file& input)
+{
+    return input.open("../clustering/konvick.txt");
+}
+
+// Map pixel file specified by path into "input", the file stays mapped until input is closed or destroyed
+bool file_loader::mapPixelData(const std::string& path, mapped_file& input)
+{
+    return input.open(path);
+}
+
+const size_t mapped_file::MAX_RUBBISH;
+
+bool mapped_file::open(const std::string& path)
+{
+    close();
+
+#if defined(_WIN32)
+    HANDLE hFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(hFile, &fileSize) == 0 || fileSize.QuadPart == 0)
+    {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMapping == NULL)
+    {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    const void* view = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL)
+    {
+        CloseHandle(hMapping);
+        CloseHandle(hFile);
+        return false;
+    }
+
+    file = hFile;
+    mapping = hMapping;
+    data = static_cast<const char*>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close();
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+
+    madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);	// Read ahead aggressively, drop pages behind
+
+    data = static_cast<const char*>(view);
+    size = static_cast<size_t>(st.st_size);
+#endif
+
+    // Binary pixel file and raw readout are used as they are
+    if (pixel_binary::is_binary(text_view(data, size)) || katherine_readout::is_readout(text_view(data, size))) return true;
+
+    // Run to the first '#' char - some rubbish was added to front of file
+    const size_t searched = (size < MAX_RUBBISH) ? size : MAX_RUBBISH;
+    const void* hash = std::memchr(data, '#', searched);
+    if (hash == nullptr)
+    {
+        close();
+        return false;
+    }
+    offset = static_cast<size_t>(static_cast<const char*>(hash) - data);
+
+    return true;
+}
+
+void mapped_file::close()
+{
+#if defined(_WIN32)
+    if (data != nullptr) UnmapViewOfFile(data);
+    if (mapping != nullptr) CloseHandle(mapping);
+    if (file != nullptr) CloseHandle(file);
+    mapping = nullptr;
+    file = nullptr;
+#else
+    if (data != nullptr) munmap(const_cast<char*>(data), size);
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+#endif
+
+    data = nullptr;
+    size = 0;
+    offset = 0;
+}
+
 // Load calibration file specified by path
 std::string file_loader::loadCalibration(std::string path)
 {
@@ -7,6 +7,45 @@
 
 #pragma once
 #include <string>
+#include "text_view.h"
+
+/// <summary>
+/// mapped_file maps pixel file read-only into memory (mmap / MapViewOfFile) instead of reading it into std::string.
+/// Pages are loaded by OS on first access and read sequentially, so opening is instant even for huge files
+/// and no memory beyond the page cache is used. Rubbish before the first '#' is skipped in view(), same as loadPixelData.
+/// Binary pixel file (pixel_binary) and raw Katherine readout (katherine_readout) are viewed whole, from the first byte.
+/// </summary>
+class mapped_file
+{
+public:
+	mapped_file() {};
+	~mapped_file() { close(); };
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	/// <summary>
+	/// Map file at path, previously mapped file is closed. Returns false if file cant be opened or has no '#'.
+	/// </summary>
+	bool open(const std::string& path);
+	void close();
+
+	bool is_open() const { return data != nullptr; };
+	text_view view() const { return text_view(data + offset, size - offset); };
+
+	static const size_t MAX_RUBBISH = 10000;	// Max bytes before the first '#'
+
+private:
+	const char* data = nullptr;
+	size_t size = 0;		// Size of whole file
+	size_t offset = 0;		// Position of first '#'
+#if defined(_WIN32)
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
 
 class file_loader
 {
@@ -14,6 +53,8 @@ class file_loader
 public:
 	static std::string loadDefaultFile();
 	static void loadPixelData(std::string path, std::string& input);
+	static bool mapDefaultFile(mapped_file& input);
+	static bool mapPixelData(const std::string& path, mapped_file& input);
 	static std::string loadCalibration(std::string path);
 };
 
@@ -7,12 +7,13 @@
 
 #include "file_saver.h"
 #include "file_loader.h"
+#include "pixel_binary.h"
 #include <fstream>
 #include <iomanip>
 #include <ctime>
 #include <sstream>
 
-std::string file_saver::savePixelFile(std::vector<ClusterType>& doneClusters)
+std::string file_saver::savePixelFile(std::vector<ClusterType>& doneClusters, bool binary)
 {
 	size_t numOfClusters = doneClusters.size();
 	size_t numOfPixels = 0;
@@ -50,6 +51,49 @@ std::string file_saver::savePixelFile(std::vector<ClusterType>& doneClusters)
 	out << ret;
 	out.close();
 
+	if (binary) savePixelBinaryFile(doneClusters, timestamp);
+
+	return filename;
+}
+
+// Same name as the text pixel file, pixels are written straight from the clusters
+std::string file_saver::savePixelBinaryFile(std::vector<ClusterType>& doneClusters, std::string timestamp)
+{
+	std::string filename = "../saved_pixel_data/";
+	filename.append(timestamp);
+	filename.append("_pixel_file.kpx");
+
+	if (pixel_binary::write_clusters(doneClusters, filename) == false) return "";
+
+	return filename;
+}
+
+std::string file_saver::convertToBinary(std::string path)
+{
+	mapped_file input;
+	if (file_loader::mapPixelData(path, input) == false) return "";
+
+	text_view text = input.view();
+	if (pixel_binary::is_binary(text)) return path;		// Already converted
+
+	// Files saved by savePixelFile have x, y, ToT, ToA (ns), other text files are exported from Katherine
+	const std::string savedHeader = "# Pixel save file";
+	pixel_parser::line_format format = (text.substr(0, savedHeader.size()) == savedHeader) ? pixel_parser::xy_tot_toa : pixel_parser::katherine_raw;
+
+	std::string filename = path;
+	size_t dot = filename.find_last_of('.');
+	size_t slash = filename.find_last_of("/\\");
+	if (dot != std::string::npos && (slash == std::string::npos || slash < dot)) filename.erase(dot);
+	filename.append(".kpx");
+
+	if (katherine_readout::is_readout(text))
+	{
+		if (pixel_binary::convert_readout(text, filename) == false) return "";
+		return filename;
+	}
+
+	if (pixel_binary::convert_text(text, format, filename) == false) return "";
+
 	return filename;
 }
 
@@ -105,10 +149,9 @@ std::vector<ClusterType> file_saver::loadClustersFromFile(std::string path)
 {
 	std::vector<ClusterType> clusters;
 
-	// Load the file
-	std::string input;
-	file_loader::loadPixelData(path, input);
-	if (input == "" || input == "fault") return std::vector<ClusterType>();	// Error handling = return empty vector
+	// Map the file
+	mapped_file input;
+	if (file_loader::mapPixelData(path, input) == false) return std::vector<ClusterType>();	// Error handling = return empty vector
 
 	std::string oneLine;
 	const double toaLsb = 25;
@@ -117,7 +160,7 @@ std::vector<ClusterType> file_saver::loadClustersFromFile(std::string path)
 	char* rows[4] = { 0, 0, 0, 0 };
 	bool newCluster = false;
 
-	while (get_my_line(input, oneLine, true)) {      // Gets lines without ending line chars - ex. "\n"
+	while (get_my_line(input.view(), oneLine, true)) {      // Gets lines without ending line chars - ex. "\n"
 
 		if (oneLine[0] == '#') continue;
 		
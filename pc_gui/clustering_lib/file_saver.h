@@ -35,17 +35,24 @@
 	- then, if newCluster is True: add new cluster to array of clusters and make newCluster = False, then continue reading another line
 	- if newCluster is False: add new pixel to last cluster added and update ToA and coordinates stats, then continue reading another line
 	- if all lines were read, return array of clusters, ready to be processed further by human
+
+	With binary = true, savePixelFile() saves the pixels also to binary pixel file (.kpx) of the same name, see pixel_binary.h.
+	ToA is in ns there, ToT as saved in text.
+	Existing pixel files (text from Katherine, saved ones or raw readout captures) are converted by convertToBinary() to .kpx next to them
+	(Convert To Binary button in GUI converts the selected pixel file).
 */
 
 
 class file_saver : protected clustering_base
 {
 public:
-	static std::string savePixelFile(std::vector<ClusterType>& doneClusters);
+	static std::string savePixelFile(std::vector<ClusterType>& doneClusters, bool binary = false);
 	static std::string saveClusterFile(std::vector<ClusterType>& doneClusters);
+	static std::string convertToBinary(std::string path);
 	static std::vector<ClusterType> loadClustersFromFile(std::string path);
 
 private:
+	static std::string savePixelBinaryFile(std::vector<ClusterType>& doneClusters, std::string timestamp);
 	static std::string createHeader(size_t numOfClusters, size_t numOfPixels, std::string datetime);
 	static std::string getDateTime();
 };
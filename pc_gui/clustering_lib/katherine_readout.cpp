@@ -0,0 +1,227 @@
+
+/**
+ * @katherine_readout.cpp
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+#include "katherine_readout.h"
+#include <algorithm>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define KATHERINE_READOUT_NEON
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define KATHERINE_READOUT_AVX2
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define KATHERINE_READOUT_SSSE3
+#endif
+
+const size_t katherine_readout::WORD_BYTES;
+const size_t katherine_readout::DETECT_WORDS;
+const size_t katherine_readout::RUN_WORDS;
+
+// fToA * 1.5625 ns
+const double katherine_readout::FTOA_NS[16] = {
+	0.0, 1.5625, 3.125, 4.6875, 6.25, 7.8125, 9.375, 10.9375,
+	12.5, 14.0625, 15.625, 17.1875, 18.75, 20.3125, 21.875, 23.4375
+};
+
+namespace
+{
+	const double toaLsb = 25;
+
+	inline bool is_known(int type)
+	{
+		return katherine_readout::is_pixel(type) || type == katherine_readout::time_offset || type == katherine_readout::frame_start ||
+			type == katherine_readout::frame_end || type == katherine_readout::lost_pixels;
+	}
+
+	/*
+	*	Word byte layout: lo = bytes 0 - 3 (fToA, ToT, ToA, lowest 4 bits of x), hi = bytes 3 - 5 (x, y, type)
+	*	Shuffles below put lo and hi of consecutive words into 32 bit lanes.
+	*/
+#if defined(KATHERINE_READOUT_NEON)
+	const size_t STEP = 4;
+	const size_t STEP_WORDS = 5;	// Loads read 28 B for 4 words
+
+	const uint8_t LO_IDX[8] = { 0, 1, 2, 3, 6, 7, 8, 9 };
+	const uint8_t HI_IDX[8] = { 3, 4, 5, 255, 9, 10, 11, 255 };	// Out of range index gives 0
+
+	inline void split_step(const char* p, katherine_readout::columns& cols, size_t i)
+	{
+		const uint8x8_t loIdx = vld1_u8(LO_IDX);
+		const uint8x8_t hiIdx = vld1_u8(HI_IDX);
+
+		const uint8x16_t a = vld1q_u8(reinterpret_cast<const uint8_t*>(p));			// Words 0, 1
+		const uint8x16_t b = vld1q_u8(reinterpret_cast<const uint8_t*>(p + 12));	// Words 2, 3
+		uint8x8x2_t ta;
+		ta.val[0] = vget_low_u8(a);
+		ta.val[1] = vget_high_u8(a);
+		uint8x8x2_t tb;
+		tb.val[0] = vget_low_u8(b);
+		tb.val[1] = vget_high_u8(b);
+
+		const uint32x4_t lo = vreinterpretq_u32_u8(vcombine_u8(vtbl2_u8(ta, loIdx), vtbl2_u8(tb, loIdx)));
+		const uint32x4_t hi = vreinterpretq_u32_u8(vcombine_u8(vtbl2_u8(ta, hiIdx), vtbl2_u8(tb, hiIdx)));
+
+		vst1q_u32(&cols.ftoa[i], vandq_u32(lo, vdupq_n_u32(0xF)));
+		vst1q_u32(&cols.tot[i], vandq_u32(vshrq_n_u32(lo, 4), vdupq_n_u32(0x3FF)));
+		vst1q_u32(&cols.toa[i], vandq_u32(vshrq_n_u32(lo, 14), vdupq_n_u32(0x3FFF)));
+		vst1q_u32(&cols.x[i], vandq_u32(vshrq_n_u32(hi, 4), vdupq_n_u32(0xFF)));
+		vst1q_u32(&cols.y[i], vandq_u32(vshrq_n_u32(hi, 12), vdupq_n_u32(0xFF)));
+	}
+#elif defined(KATHERINE_READOUT_AVX2)
+	const size_t STEP = 8;
+	const size_t STEP_WORDS = 9;	// Loads read 52 B for 8 words
+
+	inline __m256i load_pair(const char* p0, const char* p1)
+	{
+		const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p0));
+		const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1));
+		return _mm256_inserti128_si256(_mm256_castsi128_si256(l), h, 1);
+	}
+
+	inline void split_step(const char* p, katherine_readout::columns& cols, size_t i)
+	{
+		const __m256i loIdx = _mm256_setr_epi8(0, 1, 2, 3, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1,
+			0, 1, 2, 3, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1);
+		const __m256i hiIdx = _mm256_setr_epi8(3, 4, 5, -1, 9, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			3, 4, 5, -1, 9, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+		const __m256i a = load_pair(p, p + 24);			// Words 0, 1 | 4, 5
+		const __m256i b = load_pair(p + 12, p + 36);	// Words 2, 3 | 6, 7
+
+		const __m256i lo = _mm256_or_si256(_mm256_shuffle_epi8(a, loIdx), _mm256_slli_si256(_mm256_shuffle_epi8(b, loIdx), 8));
+		const __m256i hi = _mm256_or_si256(_mm256_shuffle_epi8(a, hiIdx), _mm256_slli_si256(_mm256_shuffle_epi8(b, hiIdx), 8));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&cols.ftoa[i]), _mm256_and_si256(lo, _mm256_set1_epi32(0xF)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&cols.tot[i]), _mm256_and_si256(_mm256_srli_epi32(lo, 4), _mm256_set1_epi32(0x3FF)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&cols.toa[i]), _mm256_and_si256(_mm256_srli_epi32(lo, 14), _mm256_set1_epi32(0x3FFF)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&cols.x[i]), _mm256_and_si256(_mm256_srli_epi32(hi, 4), _mm256_set1_epi32(0xFF)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&cols.y[i]), _mm256_and_si256(_mm256_srli_epi32(hi, 12), _mm256_set1_epi32(0xFF)));
+	}
+#elif defined(KATHERINE_READOUT_SSSE3)
+	const size_t STEP = 4;
+	const size_t STEP_WORDS = 5;	// Loads read 28 B for 4 words
+
+	inline void split_step(const char* p, katherine_readout::columns& cols, size_t i)
+	{
+		const __m128i loIdx = _mm_setr_epi8(0, 1, 2, 3, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1);
+		const __m128i hiIdx = _mm_setr_epi8(3, 4, 5, -1, 9, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+		const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));			// Words 0, 1
+		const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12));	// Words 2, 3
+
+		const __m128i lo = _mm_or_si128(_mm_shuffle_epi8(a, loIdx), _mm_slli_si128(_mm_shuffle_epi8(b, loIdx), 8));
+		const __m128i hi = _mm_or_si128(_mm_shuffle_epi8(a, hiIdx), _mm_slli_si128(_mm_shuffle_epi8(b, hiIdx), 8));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&cols.ftoa[i]), _mm_and_si128(lo, _mm_set1_epi32(0xF)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&cols.tot[i]), _mm_and_si128(_mm_srli_epi32(lo, 4), _mm_set1_epi32(0x3FF)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&cols.toa[i]), _mm_and_si128(_mm_srli_epi32(lo, 14), _mm_set1_epi32(0x3FFF)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&cols.x[i]), _mm_and_si128(_mm_srli_epi32(hi, 4), _mm_set1_epi32(0xFF)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&cols.y[i]), _mm_and_si128(_mm_srli_epi32(hi, 12), _mm_set1_epi32(0xFF)));
+	}
+#endif
+
+	inline void split_one(const char* p, katherine_readout::columns& cols, size_t i)
+	{
+		const uint64_t word = katherine_readout::load_word(p);
+		cols.ftoa[i] = static_cast<uint32_t>(word & 0xF);
+		cols.tot[i] = static_cast<uint32_t>((word >> 4) & 0x3FF);
+		cols.toa[i] = static_cast<uint32_t>((word >> 14) & 0x3FFF);
+		cols.x[i] = static_cast<uint32_t>((word >> 28) & 0xFF);
+		cols.y[i] = static_cast<uint32_t>((word >> 36) & 0xFF);
+	}
+
+	// Collects decoded pixels into vector, used by decode()
+	struct pixel_collector
+	{
+		std::vector<OnePixel>& out;
+		const uint32_t upFilter;
+		const uint32_t doFilter;
+
+		void control(uint64_t, int) {};
+
+		void pixels(const katherine_readout::columns& cols, size_t n)
+		{
+			for (size_t k = 0; k < n; k++)
+			{
+				if (cols.x[k] > upFilter || cols.x[k] < doFilter || cols.y[k] > upFilter || cols.y[k] < doFilter) continue;
+				out.emplace_back(static_cast<uint16_t>(cols.x[k]), static_cast<uint16_t>(cols.y[k]), static_cast<int>(cols.tot[k]), cols.time[k]);
+			}
+		}
+	};
+}
+
+void katherine_readout::control_word(uint64_t word, int type, state& st)
+{
+	switch (type)
+	{
+	case frame_start:
+		st.offset = 0;
+		st.frames++;
+		break;
+	case frame_end:
+		break;
+	case time_offset:
+		st.offset = word & 0xFFFFFFFF;
+		break;
+	case lost_pixels:
+		st.lost += word & 0x0FFFFFFFFFFF;	// First 44 bits, the rest is data type
+		break;
+	default:
+		st.unknown++;
+		break;
+	}
+}
+
+bool katherine_readout::is_readout(text_view data)
+{
+	const uint64_t checked = std::min<uint64_t>(words(data), DETECT_WORDS);
+	if (checked == 0) return false;
+
+	for (uint64_t i = 0; i < checked; i++)
+	{
+		if (is_known(word_type(data.data + (i * WORD_BYTES))) == false) return false;
+	}
+
+	return true;
+}
+
+void katherine_readout::split_words(const char* data, size_t n, uint64_t offset, columns& cols)
+{
+	size_t i = 0;
+
+#if defined(KATHERINE_READOUT_NEON) || defined(KATHERINE_READOUT_AVX2) || defined(KATHERINE_READOUT_SSSE3)
+	for (; i + STEP_WORDS <= n; i += STEP)
+	{
+		split_step(data + (i * WORD_BYTES), cols, i);
+	}
+#endif
+
+	for (; i < n; i++)
+	{
+		split_one(data + (i * WORD_BYTES), cols, i);
+	}
+
+	// Whole run shares the time offset
+	const uint64_t base = offset * 16384;
+	for (size_t k = 0; k < n; k++)
+	{
+		cols.time[k] = (static_cast<double>(cols.toa[k] + base) * toaLsb) - FTOA_NS[cols.ftoa[k]];
+	}
+}
+
+uint64_t katherine_readout::decode(text_view data, uint64_t first, uint64_t count, int outerFilterSize, state& st, std::vector<OnePixel>& out)
+{
+	const uint64_t total = words(data);
+	if (first >= total) return 0;
+
+	columns cols;
+	pixel_collector collector{ out, static_cast<uint32_t>(255 - outerFilterSize), static_cast<uint32_t>(outerFilterSize) };
+
+	return decode_words(data.data + (first * WORD_BYTES), std::min(count, total - first), st, cols, collector);
+}
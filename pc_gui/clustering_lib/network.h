@@ -28,9 +28,12 @@
 
 #include <fcntl.h>
 #define DEFAULT_PORT "21000"
-#define MIN_FRAME_BYTE_SIZE 50
+#include <algorithm>
+#include <cstring>
 #include <string>
+#include <vector>
 #include "utility.h"
+#include "serializer.h"
 #include <thread>
 
 class networking
@@ -130,6 +133,9 @@ public:
 
 		closesocket(listenFD);
 		buffer = new char[BUFF_SIZE];
+		rxBegin = 0;	// Nothing left from previous client
+		rxEnd = 0;
+		rxNeed = 0;
 		isConnected = true;
 	}
 
@@ -183,12 +189,10 @@ public:
 		return done;
 	}
 
-	// Non blocking
-	int recvDataPacket(std::string& data)
+	// Non blocking - read everything waiting on the socket (up to free space) into the receive buffer.
+	// Returns bytes read, 0 if nothing is waiting, -1 on error or disconnect
+	int recvFrames()
 	{
-		int len = 0;
-		size_t done = 0;
-
 		// Peek if data incoming
 		fd_set readfds;
 		struct timeval tv;
@@ -196,68 +200,61 @@ public:
 		tv.tv_usec = 0;
 		FD_ZERO(&readfds);
 		FD_SET(clientFD, &readfds);
-		len = select(clientFD + 1, &readfds, NULL, NULL, &tv);
+		int len = select(clientFD + 1, &readfds, NULL, NULL, &tv);
 		// return if no data are waiting, or if error
 		if (len == 0)	return 0;
 		else if (len == -1)	return -1;
 
-		// Read until we get minimum of the frame size
-		while (done < (MIN_FRAME_BYTE_SIZE-1))
+		// Move the unparsed rest (part of next frame) to the front, grow only for a frame bigger than the buffer
+		if (rxBegin > 0)
 		{
-			// TODO: Tady musim precist jen data jednoho framu, takze v recvData musim cist min, treba jen par bajtu
-			// A nebo to musim delat nejak jinak.. je to docela problem, takze musim stanovit v katherine, 
-			// ze se nebudou odesilat data, ktera jsou kratsi nez 100 bajtu!!
-			len = recvData(data, 2);
-			if (len == -1) return -1;
-			else if (len == 0)	// Client disconnected when len == 0
-			{
-				isConnected = false;
-				close();
-				return -1;
-			}
-			done += len;
-
-			if (data.find(';') != std::string::npos) break;	// break if end of header ';' was found
+			memmove(rxBuffer.data(), rxBuffer.data() + rxBegin, rxEnd - rxBegin);
+			rxEnd -= rxBegin;
+			rxBegin = 0;
 		}
+		size_t want = std::max(rxEnd + RECV_CHUNK, rxNeed);
+		if (rxBuffer.size() < want) rxBuffer.resize(std::max(want, 2 * rxBuffer.size()));
 
-		if (data.find(';') == std::string::npos) return 0;	// return error if nothing was found
+		len = recv(clientFD, rxBuffer.data() + rxEnd, static_cast<int>(rxBuffer.size() - rxEnd), 0);
+		if (len == -1) return -1;
+		else if (len == 0)	// Client disconnected when len == 0
+		{
+			isConnected = false;
+			close();
+			return -1;
+		}
 
-		// parse number of bytes to receive
-		size_t start = data.find('#');
-		size_t end = data.find(';');
-		if (start == std::string::npos || end == std::string::npos) return -1;	// error if end or start wasnt found
-		size_t length, rem = 0;
-		std::string number = data.substr((start + 1), (end - 1));
-		length = std::atoll(number.c_str());
-		int doneBefore = done;
-		rem = length - done;
+		rxEnd += len;
+		return len;
+	}
 
-		// increase buffer size in case necessary
-		if (length > BUFF_SIZE)
+	// Next complete frame from the receive buffer, false if there is none yet.
+	// Frame data point into the buffer - valid only until next recvFrames()
+	bool nextFrame(frame_view& frame)
+	{
+		int header = serializer::parse_header(rxBuffer.data() + rxBegin, rxEnd - rxBegin, frame);
+		if (header == 0) return false;		// Header not complete yet
+		else if (header < 0)
 		{
-			char* temp = new char[BUFF_SIZE];
-			memcpy(temp, buffer, BUFF_SIZE);
-			delete[] buffer;
-			size_t OLD_BUFF_SIZE = BUFF_SIZE;
-			BUFF_SIZE = 2 * length;
-			buffer = new char[BUFF_SIZE];
-			memset(buffer, 0, BUFF_SIZE);
-			memcpy(buffer, temp, OLD_BUFF_SIZE);	// Note: Buffer will not overrrun because BUFF_SIZE is always bigger than OLD_BUFF_SIZE
-			delete[] temp;
+			// Lost track of frames - nothing to resync on, throw the received data away
+			utility::print_info("Broken frame header, dropped bytes: ", static_cast<uint32_t>(rxEnd - rxBegin));
+			rxBegin = 0;
+			rxEnd = 0;
+			rxNeed = 0;
+			return false;
 		}
 
-		// Receive more data until we received the whole dataframe
-		while (length > done)
+		size_t bytes = header + frame.length;
+		if (rxEnd - rxBegin < bytes)
 		{
-			len = recv(clientFD, buffer + done, rem, 0);
-			done += len;
-			rem = length - done;
-
-			if (len == -1) return -1;
+			rxNeed = bytes;		// Buffer has to hold whole frame, it starts at the front after next compaction
+			return false;
 		}
 
-		data.append(buffer + doneBefore, done - doneBefore);	// append remaning data from buffer
-		return done;
+		frame.data = rxBuffer.data() + rxBegin + header;
+		rxBegin += bytes;
+		rxNeed = 0;
+		return true;
 	}
 
 	// Utility function for sendign the dta immediately back - for tests
@@ -311,6 +308,13 @@ private:
 	size_t BUFF_SIZE = 10000;
 	char* buffer;
 
+	// Receive buffer of frames - reused, parsed in place from rxBegin, received data appended at rxEnd
+	static const size_t RECV_CHUNK = 65536;
+	std::vector<char> rxBuffer;
+	size_t rxBegin = 0;
+	size_t rxEnd = 0;
+	size_t rxNeed = 0;	// Bytes of frame which does not fit the buffer yet
+
 	void WSA_init()
 	{
 		WSADATA wsaData;
@@ -0,0 +1,251 @@
+
+/**
+ * @pixel_binary.cpp
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+#include "pixel_binary.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+static_assert(sizeof(pixel_binary::file_header) == 64, "Binary pixel file header must have 64 B");
+
+const uint32_t pixel_binary::BLOCK_HITS;
+const uint16_t pixel_binary::VERSION;
+const size_t pixel_binary::HIT_BYTES;
+
+namespace
+{
+	const char MAGIC[4] = { 'K', 'P', 'X', 'B' };
+	const double toaLsb = 25;
+	const double toaFineLsb = 1.5625;
+
+	template <typename T>
+	inline T read_column(const char* column, size_t idx)
+	{
+		T value;
+		std::memcpy(&value, column + (idx * sizeof(T)), sizeof(T));
+		return value;
+	}
+}
+
+bool pixel_binary::is_binary(text_view data)
+{
+	file_header header;
+	return read_header(data, header);
+}
+
+bool pixel_binary::read_header(text_view data, file_header& header)
+{
+	if (data.size < sizeof(file_header)) return false;
+
+	std::memcpy(&header, data.data, sizeof(file_header));
+
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) return false;
+	if (header.version != VERSION || header.header_size != sizeof(file_header) || header.block_hits != BLOCK_HITS) return false;
+	if (header.toa_unit != katherine_ticks && header.toa_unit != nanoseconds) return false;
+	if ((data.size - sizeof(file_header)) / HIT_BYTES < header.hits) return false;	// Truncated file
+
+	return true;
+}
+
+uint64_t pixel_binary::decode(text_view data, const file_header& header, uint64_t first, uint64_t count, int outerFilterSize, std::vector<OnePixel>& out)
+{
+	const int upFilter = 255 - outerFilterSize;
+	const int doFilter = outerFilterSize;
+	const bool ticks = (header.toa_unit == katherine_ticks);
+
+	const uint64_t end = std::min(header.hits, first + count);
+	if (first >= end) return 0;
+
+	const size_t outStart = out.size();
+	out.reserve(outStart + static_cast<size_t>(end - first));
+
+	while (first < end)
+	{
+		const uint64_t block = first / BLOCK_HITS;
+		const size_t idx = static_cast<size_t>(first % BLOCK_HITS);
+		const size_t n = static_cast<size_t>(std::min<uint64_t>(BLOCK_HITS, header.hits - (block * BLOCK_HITS)));
+		const size_t take = static_cast<size_t>(std::min<uint64_t>(n - idx, end - first));
+
+		/* Columns of the block */
+		const char* toaCol = data.data + sizeof(file_header) + (block * BLOCK_HITS * HIT_BYTES);
+		const char* totCol = toaCol + (n * sizeof(int64_t));
+		const char* xyCol = totCol + (n * sizeof(int32_t));
+		const char* ftoaCol = xyCol + (n * sizeof(uint16_t));
+
+		for (size_t i = idx; i < idx + take; i++)
+		{
+			const uint16_t xy = read_column<uint16_t>(xyCol, i);
+			const int x = xy >> 8;
+			const int y = xy & 0xFF;
+			if (x > upFilter || x < doFilter || y > upFilter || y < doFilter) continue;
+
+			const int64_t toa = read_column<int64_t>(toaCol, i);
+			const double ToA = ticks ? (double)((toa * toaLsb) - (read_column<uint8_t>(ftoaCol, i) * toaFineLsb)) : (double)toa;
+
+			out.emplace_back(static_cast<uint16_t>(x), static_cast<uint16_t>(y), read_column<int32_t>(totCol, i), static_cast<decltype(OnePixel::ToA)>(ToA));
+		}
+
+		first += take;
+	}
+
+	return out.size() - outStart;
+}
+
+bool pixel_binary::convert_text(text_view text, pixel_parser::line_format format, const std::string& path)
+{
+	pixel_binary_writer writer;
+	if (writer.open(path, (format == pixel_parser::katherine_raw) ? katherine_ticks : nanoseconds) == false) return false;
+
+	const uint64_t BATCH_LINES = 65536;
+	volatile bool abort = false;
+	std::vector<OnePixel> batch;
+	pixel_parser::result res = { 0, 0, 0, false };
+
+	do
+	{
+		batch.clear();
+		res = pixel_parser::parse(text, res.stop, format, 0, batch, abort, BATCH_LINES);
+
+		for (const auto& pix : batch)
+		{
+			writer.add_pixel(pix);
+		}
+	} while (res.lines == BATCH_LINES);
+
+	return writer.close();
+}
+
+bool pixel_binary::convert_readout(text_view readout, const std::string& path)
+{
+	pixel_binary_writer writer;
+	if (writer.open(path, katherine_ticks) == false) return false;
+
+	const uint64_t BATCH_WORDS = 65536;
+	const uint64_t words = katherine_readout::words(readout);
+	katherine_readout::state st;
+	std::vector<OnePixel> batch;
+
+	for (uint64_t first = 0; first < words; first += BATCH_WORDS)
+	{
+		batch.clear();
+		katherine_readout::decode(readout, first, BATCH_WORDS, 0, st, batch);
+
+		for (const auto& pix : batch)
+		{
+			writer.add_pixel(pix);
+		}
+	}
+
+	return writer.close();
+}
+
+bool pixel_binary::write_clusters(const std::vector<ClusterType>& clusters, const std::string& path)
+{
+	pixel_binary_writer writer;
+	if (writer.open(path, nanoseconds) == false) return false;
+
+	for (const auto& cluster : clusters)
+	{
+		for (const auto& pix : cluster.pix)
+		{
+			writer.add_pixel(pix);
+		}
+	}
+
+	return writer.close();
+}
+
+bool pixel_binary_writer::open(const std::string& path, pixel_binary::toa_units unit)
+{
+	out.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out) return false;
+
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = pixel_binary::VERSION;
+	header.header_size = sizeof(pixel_binary::file_header);
+	header.block_hits = pixel_binary::BLOCK_HITS;
+	header.toa_unit = unit;
+	header.min_toa = std::numeric_limits<int64_t>::max();
+	header.max_toa = std::numeric_limits<int64_t>::min();
+
+	// Placeholder, rewritten with final counts in close()
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	toa.reserve(pixel_binary::BLOCK_HITS);
+	tot.reserve(pixel_binary::BLOCK_HITS);
+	xy.reserve(pixel_binary::BLOCK_HITS);
+	ftoa.reserve(pixel_binary::BLOCK_HITS);
+
+	return static_cast<bool>(out);
+}
+
+void pixel_binary_writer::add(uint16_t x, uint16_t y, int64_t toaValue, uint8_t ftoaValue, int32_t totValue)
+{
+	toa.push_back(toaValue);
+	tot.push_back(totValue);
+	xy.push_back(static_cast<uint16_t>((x << 8) | (y & 0xFF)));
+	ftoa.push_back(ftoaValue);
+
+	if (toaValue < header.min_toa) header.min_toa = toaValue;
+	if (toaValue > header.max_toa) header.max_toa = toaValue;
+	header.hits++;
+
+	if (toa.size() == pixel_binary::BLOCK_HITS) flush_block();
+}
+
+void pixel_binary_writer::add_pixel(const OnePixel& pix)
+{
+	const double ToA = static_cast<double>(pix.ToA);
+
+	if (header.toa_unit == pixel_binary::nanoseconds)
+	{
+		add(pix.x, pix.y, static_cast<int64_t>(ToA), 0, pix.ToT);
+		return;
+	}
+
+	// ToA = 25 * ticks - 1.5625 * fToA, fToA is 0 - 15 -> ticks is the nearest multiple of 25 ns at or above ToA
+	const int64_t ticks = static_cast<int64_t>(std::ceil(ToA / toaLsb));
+	const int64_t fine = static_cast<int64_t>(std::llround(((ticks * toaLsb) - ToA) / toaFineLsb));
+	add(pix.x, pix.y, ticks, static_cast<uint8_t>(fine), pix.ToT);
+}
+
+bool pixel_binary_writer::close()
+{
+	if (!out.is_open()) return false;
+
+	flush_block();
+
+	if (header.hits == 0)
+	{
+		header.min_toa = 0;
+		header.max_toa = 0;
+	}
+
+	out.seekp(0, std::ios::beg);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	const bool ok = static_cast<bool>(out);
+	out.close();
+	return ok;
+}
+
+void pixel_binary_writer::flush_block()
+{
+	if (toa.empty()) return;
+
+	out.write(reinterpret_cast<const char*>(toa.data()), static_cast<std::streamsize>(toa.size() * sizeof(int64_t)));
+	out.write(reinterpret_cast<const char*>(tot.data()), static_cast<std::streamsize>(tot.size() * sizeof(int32_t)));
+	out.write(reinterpret_cast<const char*>(xy.data()), static_cast<std::streamsize>(xy.size() * sizeof(uint16_t)));
+	out.write(reinterpret_cast<const char*>(ftoa.data()), static_cast<std::streamsize>(ftoa.size() * sizeof(uint8_t)));
+
+	toa.clear();
+	tot.clear();
+	xy.clear();
+	ftoa.clear();
+}
@@ -0,0 +1,124 @@
+
+/**
+ * @pixel_binary.h
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+#pragma once
+
+#include "cluster_definition.h"
+#include "pixel_parser.h"
+#include "katherine_readout.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+	Binary pixel file documentation (.kpx)
+	- all numbers are little-endian
+	- file is 64 B header followed by blocks of BLOCK_HITS hits, last block holds the rest
+	- every block stores columns one after another, so they can be read with plain loops:
+
+	Header:
+		char	 magic[4]		"KPXB"
+		uint16_t version		1
+		uint16_t header_size	64
+		uint32_t block_hits		hits in one full block (4096)
+		uint32_t toa_unit		0 = Katherine ticks, 1 = nanoseconds
+		uint64_t hits			number of hits in file
+		int64_t  min_toa		lowest value of toa column
+		int64_t  max_toa		highest value of toa column
+		uint8_t  reserved[24]
+
+	Block of n hits (15 B per hit, full block size is multiple of 8 -> columns stay aligned):
+		int64_t  toa[n]			ToA ticks (25 ns) or ToA in ns, by toa_unit
+		int32_t  tot[n]			ToT
+		uint16_t xy[n]			(x << 8) | y
+		uint8_t  ftoa[n]		fine ToA (1.5625 ns), 0 for toa_unit == ns
+
+	ToA of pixel in ns:
+		ticks:	toa * 25 - ftoa * 1.5625	(same as text file coord \t ToA \t fToA \t ToT)
+		ns:		toa							(same as saved text file x \t y \t ToT \t ToA)
+*/
+
+class pixel_binary
+{
+public:
+	enum toa_units : uint32_t
+	{
+		katherine_ticks = 0, nanoseconds = 1
+	};
+
+	struct file_header
+	{
+		char magic[4];
+		uint16_t version;
+		uint16_t header_size;
+		uint32_t block_hits;
+		uint32_t toa_unit;
+		uint64_t hits;
+		int64_t min_toa;
+		int64_t max_toa;
+		uint8_t reserved[24];
+	};
+
+	static const uint32_t BLOCK_HITS = 4096;
+	static const uint16_t VERSION = 1;
+	static const size_t HIT_BYTES = sizeof(int64_t) + sizeof(int32_t) + sizeof(uint16_t) + sizeof(uint8_t);
+
+	/// <summary>
+	/// True if data start with valid header of binary pixel file.
+	/// </summary>
+	static bool is_binary(text_view data);
+
+	/// <summary>
+	/// Read header, returns false if data are not complete binary pixel file.
+	/// </summary>
+	static bool read_header(text_view data, file_header& header);
+
+	/// <summary>
+	/// Append count hits starting with hit first to out as OnePixel (ToA in ns).
+	/// Pixels with x or y inside outerFilterSize from the edge of the matrix are dropped. Returns number of appended pixels.
+	/// </summary>
+	static uint64_t decode(text_view data, const file_header& header, uint64_t first, uint64_t count, int outerFilterSize, std::vector<OnePixel>& out);
+
+	/// <summary>
+	/// Convert text pixel file (katherine_raw or xy_tot_toa) to binary pixel file at path. Returns false on error.
+	/// </summary>
+	static bool convert_text(text_view text, pixel_parser::line_format format, const std::string& path);
+
+	/// <summary>
+	/// Convert raw Katherine readout to binary pixel file at path (toa_unit = ticks). Returns false on error.
+	/// </summary>
+	static bool convert_readout(text_view readout, const std::string& path);
+
+	/// <summary>
+	/// Write pixels of clusters (ToA in ns) to binary pixel file at path, cluster after cluster. Returns false on error.
+	/// </summary>
+	static bool write_clusters(const std::vector<ClusterType>& clusters, const std::string& path);
+};
+
+/// <summary>
+/// pixel_binary_writer streams hits into binary pixel file, block by block. Header is written by close().
+/// </summary>
+class pixel_binary_writer
+{
+public:
+	bool open(const std::string& path, pixel_binary::toa_units unit);
+	void add(uint16_t x, uint16_t y, int64_t toa, uint8_t ftoa, int32_t tot);
+	void add_pixel(const OnePixel& pix);
+	bool close();
+
+private:
+	std::ofstream out;
+	pixel_binary::file_header header;
+
+	std::vector<int64_t> toa;
+	std::vector<int32_t> tot;
+	std::vector<uint16_t> xy;
+	std::vector<uint8_t> ftoa;
+
+	void flush_block();
+};
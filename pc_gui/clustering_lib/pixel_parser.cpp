@@ -0,0 +1,289 @@
+
+/**
+ * @pixel_parser.cpp
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+#include "pixel_parser.h"
+#include <cstring>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PIXEL_PARSER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PIXEL_PARSER_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// SWAR digit conversion expects first digit in the lowest byte
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define PIXEL_PARSER_NO_SWAR
+#endif
+
+namespace
+{
+	const int FIELDS = 4;
+	const int ABORT_CHECK_LINES = 4096;		// Check abort flag only once per this many lines
+
+	inline int count_trailing_zeros(uint32_t mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long idx = 0;
+		_BitScanForward(&idx, mask);
+		return static_cast<int>(idx);
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+#if defined(PIXEL_PARSER_AVX2)
+	const int BLOCK = 32;
+
+	// Bitmask of tabs and newlines in 32 bytes starting at p
+	inline uint32_t separator_mask(const char* p)
+	{
+		const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		const __m256i tabs = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\t'));
+		const __m256i newlines = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n'));
+		return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(tabs, newlines)));
+	}
+#elif defined(PIXEL_PARSER_SSE2)
+	const int BLOCK = 16;
+
+	// Bitmask of tabs and newlines in 16 bytes starting at p
+	inline uint32_t separator_mask(const char* p)
+	{
+		const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		const __m128i tabs = _mm_cmpeq_epi8(block, _mm_set1_epi8('\t'));
+		const __m128i newlines = _mm_cmpeq_epi8(block, _mm_set1_epi8('\n'));
+		return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(tabs, newlines)));
+	}
+#else
+	const int BLOCK = 8;
+
+	// Bitmask of tabs and newlines in 8 bytes starting at p
+	inline uint32_t separator_mask(const char* p)
+	{
+		uint32_t mask = 0;
+		for (int i = 0; i < BLOCK; i++)
+		{
+			mask |= static_cast<uint32_t>((p[i] == '\t') | (p[i] == '\n')) << i;
+		}
+		return mask;
+	}
+#endif
+
+	// Same behaviour as strtolong - reads digits until the first non digit character
+	inline uint64_t parse_digits_scalar(const char* p, const char* end)
+	{
+		uint64_t x = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			x = (x * 10) + static_cast<uint64_t>(*p - '0');
+			++p;
+		}
+		return x;
+	}
+
+#if !defined(PIXEL_PARSER_NO_SWAR)
+	// Converts 1 - 8 digits which end right before "end", bytes before them are padded with '0'
+	// Returns false if any of the bytes is not a digit
+	inline bool parse_8_digits(const char* end, size_t len, uint64_t& value)
+	{
+		uint64_t chunk = 0;
+		std::memcpy(&chunk, end - 8, 8);
+
+		const uint64_t zeros = 0x3030303030303030ULL;
+		const uint64_t pad = (len == 8) ? 0 : ((1ULL << (8 * (8 - len))) - 1);
+		chunk = (chunk & ~pad) | (zeros & pad);
+
+		// All bytes in '0' - '9'
+		if ((((chunk & 0xF0F0F0F0F0F0F0F0ULL) | (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) != 0x3333333333333333ULL))
+			return false;
+
+		chunk -= zeros;
+		chunk = (chunk * 10) + (chunk >> 8);
+		chunk = (((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+			(((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+
+		value = chunk;
+		return true;
+	}
+#endif
+
+	// Number in field [p, end), begin is start of the whole text (SWAR reads up to 16 bytes before end)
+	inline int64_t parse_field(const char* begin, const char* p, const char* end)
+	{
+		bool neg = false;
+		if (p < end && *p == '-')
+		{
+			neg = true;
+			++p;
+		}
+
+		const size_t len = static_cast<size_t>(end - p);
+		uint64_t value = 0;
+
+#if !defined(PIXEL_PARSER_NO_SWAR)
+		uint64_t high = 0;
+		if (len > 0 && len <= 8 && (end - begin) >= 8 && parse_8_digits(end, len, value))
+		{
+			return neg ? -static_cast<int64_t>(value) : static_cast<int64_t>(value);
+		}
+		if (len > 8 && len <= 16 && (end - begin) >= 16 && parse_8_digits(end - 8, len - 8, high) && parse_8_digits(end, 8, value))
+		{
+			value += high * 100000000ULL;
+			return neg ? -static_cast<int64_t>(value) : static_cast<int64_t>(value);
+		}
+#endif
+
+		value = parse_digits_scalar(p, end);
+		return neg ? -static_cast<int64_t>(value) : static_cast<int64_t>(value);
+	}
+}
+
+size_t pixel_parser::next_line(text_view text, size_t offset)
+{
+	if (offset >= text.size) return text.size;
+
+	const void* nl = std::memchr(text.data + offset, '\n', text.size - offset);
+	if (nl == nullptr) return text.size;
+
+	return static_cast<size_t>(static_cast<const char*>(nl) - text.data) + 1;
+}
+
+pixel_parser::result pixel_parser::parse(text_view text, size_t offset, line_format format, int outerFilterSize, std::vector<OnePixel>& out, volatile bool& abort, uint64_t maxLines)
+{
+	result res = { offset, 0, 0, false };
+
+	const int upFilter = 255 - outerFilterSize;
+	const int doFilter = outerFilterSize;
+	const double toaLsb = 25;
+	const double toaFineLsb = 1.5625;
+
+	const char* const begin = text.data;
+	const char* const end = text.data + text.size;
+	const char* line = text.data + offset;
+
+	const char* fieldStart[FIELDS];
+	const char* fieldEnd[FIELDS];
+	int checkAbort = 0;
+
+	const size_t expected = (text.size - offset) / 20;	// Line has circa 20 - 24 chars
+	out.reserve(out.size() + static_cast<size_t>(std::min<uint64_t>(expected, maxLines)));
+
+	while (line < end && res.lines < maxLines)
+	{
+		if (*line == '#' || *line == '\n' || *line == '\r')		// Comment or empty line
+		{
+			const size_t next = next_line(text, static_cast<size_t>(line - begin));
+			if (next == text.size && end[-1] != '\n') break;	// Incomplete last line
+			line = begin + next;
+			res.stop = next;
+			continue;
+		}
+
+		if (*line == 'C')	// Beginning of clusters
+		{
+			res.cluster_marker = true;
+			break;
+		}
+
+		if (++checkAbort == ABORT_CHECK_LINES)
+		{
+			checkAbort = 0;
+			if (abort) break;
+		}
+
+		/* Find separators of the line */
+		int found = 0;
+		const char* lineEnd = nullptr;
+		const char* field = line;
+		const char* p = line;
+
+		while (lineEnd == nullptr && p < end)
+		{
+			if (end - p >= BLOCK)
+			{
+				uint32_t mask = separator_mask(p);
+
+				while (mask != 0 && lineEnd == nullptr)
+				{
+					const char* sep = p + count_trailing_zeros(mask);
+					mask &= mask - 1;
+
+					if (sep > field && found < FIELDS)	// Empty fields are skipped, same as strtok
+					{
+						fieldStart[found] = field;
+						fieldEnd[found] = sep;
+						found++;
+					}
+					field = sep + 1;
+
+					if (*sep == '\n') lineEnd = sep;
+				}
+
+				p += BLOCK;
+			}
+			else
+			{
+				if (*p == '\t' || *p == '\n')
+				{
+					if (p > field && found < FIELDS)
+					{
+						fieldStart[found] = field;
+						fieldEnd[found] = p;
+						found++;
+					}
+					field = p + 1;
+
+					if (*p == '\n') lineEnd = p;
+				}
+
+				p++;
+			}
+		}
+
+		if (lineEnd == nullptr) break;	// Incomplete last line - wait for the rest of it
+
+		res.lines++;
+		line = lineEnd + 1;
+		res.stop = static_cast<size_t>(line - begin);
+
+		if (found < FIELDS) continue;	// Broken line
+
+		if (fieldEnd[FIELDS - 1][-1] == '\r') fieldEnd[FIELDS - 1]--;	// \r\n delimiter
+
+		int x = 0, y = 0, ToT = 0;
+		double ToA = 0;
+
+		if (format == katherine_raw)
+		{
+			const int64_t coord = parse_field(begin, fieldStart[0], fieldEnd[0]);
+			x = static_cast<int>(coord / 256);
+			y = static_cast<int>(coord % 256);
+			ToA = (double)((parse_field(begin, fieldStart[1], fieldEnd[1]) * toaLsb) - (parse_field(begin, fieldStart[2], fieldEnd[2]) * toaFineLsb));  // (ns) TimeFromBeginning = 25 * ToA - 1.5625 * fineToA
+			ToT = static_cast<int>(parse_field(begin, fieldStart[3], fieldEnd[3]));
+		}
+		else
+		{
+			x = static_cast<int>(parse_field(begin, fieldStart[0], fieldEnd[0]));
+			y = static_cast<int>(parse_field(begin, fieldStart[1], fieldEnd[1]));
+			ToT = static_cast<int>(parse_field(begin, fieldStart[2], fieldEnd[2]));
+			ToA = (double)parse_field(begin, fieldStart[3], fieldEnd[3]);
+		}
+
+		if (x > upFilter || x < doFilter || y > upFilter || y < doFilter) continue;
+
+		out.emplace_back(static_cast<uint16_t>(x), static_cast<uint16_t>(y), ToT, static_cast<decltype(OnePixel::ToA)>(ToA));
+		res.pixels++;
+	}
+
+	return res;
+}
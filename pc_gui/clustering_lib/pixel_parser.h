@@ -0,0 +1,54 @@
+
+/**
+ * @pixel_parser.h
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+#pragma once
+
+#include "cluster_definition.h"
+#include "text_view.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// pixel_parser converts text pixel files into OnePixel records, directly over the loaded buffer.
+///
+/// Tabs and newlines are searched with SIMD (AVX2 or SSE2 when compiled for it, scalar otherwise),
+/// numbers are converted 8 digits at once (SWAR). Lines starting with '#' are skipped,
+/// line starting with 'C' (file with clusters) stops the parsing. Line without ending '\n' is not parsed.
+///
+/// Formats:
+///		katherine_raw:	coord \t ToA \t fToA \t ToT		(x = coord / 256, y = coord % 256, ToA = 25 * ToA - 1.5625 * fToA ns)
+///		xy_tot_toa:		x \t y \t ToT \t ToA				(format of saved online pixels)
+/// </summary>
+class pixel_parser
+{
+public:
+	enum line_format
+	{
+		katherine_raw, xy_tot_toa
+	};
+
+	struct result
+	{
+		size_t stop;			// Offset where the parsing stopped (end of last parsed line or 'C' line)
+		uint64_t lines;			// Pixel lines read
+		uint64_t pixels;		// Pixels passed the outer filter
+		bool cluster_marker;	// Stopped at line starting with 'C'
+	};
+
+	/// <summary>
+	/// Parse pixel lines of text from offset and append them to out.
+	/// Pixels with x or y inside outerFilterSize from the edge of the matrix are dropped.
+	/// At most maxLines pixel lines are read - parsing continues from result.stop in next call.
+	/// </summary>
+	static result parse(text_view text, size_t offset, line_format format, int outerFilterSize, std::vector<OnePixel>& out, volatile bool& abort, uint64_t maxLines = UINT64_MAX);
+
+	/// <summary>
+	/// Returns offset of the line following the line at offset (text.size if there is none).
+	/// </summary>
+	static size_t next_line(text_view text, size_t offset);
+};
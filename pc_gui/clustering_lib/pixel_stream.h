@@ -0,0 +1,123 @@
+
+/**
+ * @pixel_stream.h
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+#pragma once
+
+#include "cluster_definition.h"
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/// <summary>
+/// pixel_batches hands parsed pixel batches from the parser thread over to the clustering thread.
+///
+/// Number of batches in flight (being parsed, waiting or being clustered) is bounded by capacity,
+/// so parser can never run ahead of clustering by more than capacity batches - memory stays constant
+/// regardless of file size. Consumed batches are returned and reused without new allocation.
+/// </summary>
+class pixel_batches
+{
+public:
+	explicit pixel_batches(size_t capacity) : capacity(capacity) {};
+
+	/// <summary>
+	/// Producer: get empty batch to fill. Blocks while all batches are in flight.
+	/// Returns false if consumer cancelled the stream.
+	/// </summary>
+	bool acquire(std::vector<OnePixel>& batch)
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		space.wait(lock, [this] { return in_flight < capacity || cancelled; });
+		if (cancelled) return false;
+
+		in_flight++;
+		if (free_batches.empty() == false)
+		{
+			batch = std::move(free_batches.back());
+			free_batches.pop_back();
+		}
+		batch.clear();
+		return true;
+	}
+
+	/// <summary>
+	/// Producer: hand filled batch over to consumer.
+	/// </summary>
+	void push(std::vector<OnePixel>&& batch)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			full_batches.emplace_back(std::move(batch));
+		}
+		data.notify_one();
+	}
+
+	/// <summary>
+	/// Producer: no more batches will come.
+	/// </summary>
+	void finish()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			finished = true;
+		}
+		data.notify_one();
+	}
+
+	/// <summary>
+	/// Consumer: wait for next batch. Returns false when producer finished and all batches were taken.
+	/// </summary>
+	bool pop(std::vector<OnePixel>& batch)
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		data.wait(lock, [this] { return full_batches.empty() == false || finished; });
+		if (full_batches.empty()) return false;
+
+		batch = std::move(full_batches.front());
+		full_batches.pop_front();
+		return true;
+	}
+
+	/// <summary>
+	/// Return batch (consumed or unused) for reuse.
+	/// </summary>
+	void release(std::vector<OnePixel>&& batch)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			free_batches.emplace_back(std::move(batch));
+			in_flight--;
+		}
+		space.notify_one();
+	}
+
+	/// <summary>
+	/// Consumer: stop the producer, it will not get any more batches.
+	/// </summary>
+	void cancel()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			cancelled = true;
+		}
+		space.notify_one();
+	}
+
+private:
+	const size_t capacity;
+	size_t in_flight = 0;
+	bool finished = false;
+	bool cancelled = false;
+
+	std::deque<std::vector<OnePixel>> full_batches;		// Parsed, waiting for clustering
+	std::vector<std::vector<OnePixel>> free_batches;	// Consumed, ready for reuse
+
+	std::mutex mtx;
+	std::condition_variable space;		// Producer waits for free batch
+	std::condition_variable data;		// Consumer waits for parsed batch
+};
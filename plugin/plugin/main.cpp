@@ -31,19 +31,21 @@
 #include <iostream>
 #include <thread>
 #include "plugin_main.h"
+#include "lan_sender.h"
 
 //-static-libstdc++
 
 void calculate_clustering()
 {
 	offline_clustering clstr;
-	std::string lines = file_loader::loadDefaultFile();
+	mapped_file lines;
+	file_loader::mapDefaultFile(lines);
 	ClusteringParams params = {false, 200000, 200, 0, true};
 	volatile bool _abort = false;
 
 	auto start = std::chrono::high_resolution_clock::now();
 
-	clstr.do_clustering(lines, params, _abort);
+	clstr.do_clustering(lines.view(), params, _abort);
 
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> duration = end - start;
@@ -59,7 +61,7 @@ void calculate_clustering()
 
 	offline_clustering th_clstr;
 
-	auto call = [&]() { th_clstr.do_clustering(lines, params, _abort); };
+	auto call = [&]() { th_clstr.do_clustering(lines.view(), params, _abort); };
 	std::thread worker(call);
 	worker.join();
 
@@ -80,36 +82,37 @@ void benchmark_clustering_files()
 
 
 	// File Konvick
-	std::string lines = file_loader::loadDefaultFile();
-	clstr.do_clustering(lines, params, _abort);
+	mapped_file lines;
+	file_loader::mapDefaultFile(lines);
+	clstr.do_clustering(lines.view(), params, _abort);
 	std::cout << "FILE A: ";
 	printf(clstr.stat_print().c_str());
 	fflush(stdout);
 
 	// FILE DEG
-	file_loader::loadPixelData("/bin/katherine/deg60_5_embedded.txt", lines);
-	clstr.do_clustering(lines, params, _abort);
+	file_loader::mapPixelData("/bin/katherine/deg60_5_embedded.txt", lines);
+	clstr.do_clustering(lines.view(), params, _abort);
 	std::cout << "FILE B: ";
 	printf(clstr.stat_print().c_str());
 	fflush(stdout);
 
 	// FILE PROTONS
-	file_loader::loadPixelData("/bin/katherine/protons_embedded.txt", lines);
-	clstr.do_clustering(lines, params, _abort);
+	file_loader::mapPixelData("/bin/katherine/protons_embedded.txt", lines);
+	clstr.do_clustering(lines.view(), params, _abort);
 	std::cout << "FILE C: ";
 	printf(clstr.stat_print().c_str());
 	fflush(stdout);
 
 	// FILE ATLAS
-	file_loader::loadPixelData("/bin/katherine/atlas_mix_embedded.txt", lines);
-	clstr.do_clustering(lines, params, _abort);
+	file_loader::mapPixelData("/bin/katherine/atlas_mix_embedded.txt", lines);
+	clstr.do_clustering(lines.view(), params, _abort);
 	std::cout << "FILE D: ";
 	printf(clstr.stat_print().c_str());
 	fflush(stdout);
 
 	// FILE ELECTRONS
-	file_loader::loadPixelData("/bin/katherine/electrons_angle30.txt", lines);
-	clstr.do_clustering(lines, params, _abort);
+	file_loader::mapPixelData("/bin/katherine/electrons_angle30.txt", lines);
+	clstr.do_clustering(lines.view(), params, _abort);
 	std::cout << "FILE E: ";
 	printf(clstr.stat_print().c_str());
 	fflush(stdout);
@@ -119,13 +122,13 @@ void benchmark_clustering_files()
 //-----------------------------------PLUGIN BEGINS HERE---------------------------------------------------------
 
 plugin_main* plugin;
+lan_sender* sender;
 bool program_running;
 
 size_t sent_pixels = 0;
+int wire = wire_format::wire_text;	// Data frame encoding negotiated in config, text until client asks for binary
 
-template <typename T>
-void send_to_lan(networking* netw, std::vector<T> output, dataframe_types type);
-void send_to_lan(networking* netw, std::string message, dataframe_types type);
+void send_to_lan(std::string message, dataframe_types type);
 
 std::string get_help()
 {
@@ -161,42 +164,42 @@ std::string get_latest_command(const std::string& command)
 }
 
 // send command acknowledgement
-void acknowledge_command(std::string command, networking* netw)
+void acknowledge_command(std::string command)
 {
 	if (command == "") return;
 
-	send_to_lan(netw, command, dataframe_types::acknowledge);
+	send_to_lan(command, dataframe_types::acknowledge);
 }
 
 // handle incoming commands from socket
-void handle_incoming_commands(const std::string& command, networking* netw)
+void handle_incoming_commands(const std::string& command)
 {
 	int status = 0;
 
 	if (command == command_simple_recv)
 	{
 		status = plugin->plugin_start(plugins::simple_receiver);
-		if (status >= 0) acknowledge_command(command, netw);
+		if (status >= 0) acknowledge_command(command);
 	}
 	else if (command == command_clustering_energy)
 	{
 		status = plugin->plugin_start(plugins::clustering_energies);
-		if (status >= 0) acknowledge_command(command, netw);
+		if (status >= 0) acknowledge_command(command);
 	}
 	else if (command == command_clustering)
 	{
 		status = plugin->plugin_start(plugins::clustering_clusters);
-		if (status >= 0) acknowledge_command(command, netw);
+		if (status >= 0) acknowledge_command(command);
 	}
 	else if (command == command_idle)
 	{
 		status = plugin->plugin_start(plugins::idle);
-		if (status >= 0) acknowledge_command(command, netw);
+		if (status >= 0) acknowledge_command(command);
 	}
 	else if (command == command_pixel_counting)
 	{
 		status = plugin->plugin_start(plugins::pixel_counting);
-		if (status >= 0) acknowledge_command(command, netw);
+		if (status >= 0) acknowledge_command(command);
 	}
 	else if (command == command_shutdown)
 	{
@@ -206,25 +209,25 @@ void handle_incoming_commands(const std::string& command, networking* netw)
 	else if (command == command_help)
 	{
 		std::string help = get_help();
-		send_to_lan(netw, help, dataframe_types::messages);
+		send_to_lan(help, dataframe_types::messages);
 		return;
 	}
 	else
 	{
 		std::string message = "Uknown command! Type help to view commands.";
-		send_to_lan(netw, message, dataframe_types::messages);
+		send_to_lan(message, dataframe_types::messages);
 		return;
 	}
 
 	// If starting of plugin failed, it defaulted to IDLE mode
 	if (status < 0)
 	{
-		acknowledge_command(command_idle, netw);
+		acknowledge_command(command_idle);
 	}
 }
 
 // configure clustering parameters - and check boundaries - if successful, send acknowledgement
-void set_config(std::string config, networking* netw)
+void set_config(std::string config)
 {
 	ClusteringParamsOnline params = serializer::deserialize_params(config);
 
@@ -245,12 +248,45 @@ void set_config(std::string config, networking* netw)
 	{
 		params.maxClusterDelay = 200000;
 	}
+	if (params.backpressure < backpressure_policy::block_reader || params.backpressure > backpressure_policy::sample)
+	{
+		params.backpressure = backpressure_policy::block_reader;
+	}
+	if (params.sampleEvery < 2)
+	{
+		params.sampleEvery = FEEDER_SAMPLE_EVERY;
+	}
+	if (params.highWatermark < 1 || params.highWatermark > static_cast<int64_t>(FEEDER_QUEUE_BYTES - (FEEDER_QUEUE_BYTES / 8)))	// Leave room for blocks being filled
+	{
+		params.highWatermark = FEEDER_HIGH_WATERMARK;
+	}
+	if (params.lowWatermark < 0 || params.lowWatermark >= params.highWatermark)
+	{
+		params.lowWatermark = params.highWatermark / 2;
+	}
+	if (params.threads < 1 || params.threads > static_cast<int>(std::max(1u, std::thread::hardware_concurrency())))
+	{
+		params.threads = 1;
+	}
+	if (params.wireFormat < wire_format::wire_text || params.wireFormat > wire_format::wire_compact)	// Unknown formats fall back to text
+	{
+		params.wireFormat = wire_format::wire_text;
+	}
+	if (params.sendBatchBytes < 1 || params.sendBatchBytes > static_cast<int64_t>(SEND_QUEUE_BYTES))
+	{
+		params.sendBatchBytes = SEND_BATCH_BYTES;
+	}
+	if (params.sendMaxLatency < 1 || params.sendMaxLatency > 1000)
+	{
+		params.sendMaxLatency = SEND_MAX_LATENCY_MS;
+	}
 
 	plugin->set_params(params);
+	wire = params.wireFormat;	// Used right away, does not depend on clustering mode
+	sender->set_batching(static_cast<size_t>(params.sendBatchBytes), params.sendMaxLatency);
 
 	std::string ack = serializer::serialize_params(params);
-	serializer::attach_header(ack, dataframe_types::config);
-	netw->send_to_lan(ack);
+	sender->post(dataframe_types::config, std::move(ack), false, true);	// Text header - client may not know binary ones
 }
 
 // read data from socket and handle it accordingly
@@ -262,7 +298,8 @@ void read_lan(networking* netw)
 	// Serves disconnected somehow - try to reconnect
 	if (status < 0)	// Reading from LAN was unsuccesful
 	{
-		netw->reconnect_lan();
+		sender->reconnect();	// Sender does not use the socket meanwhile, its queued frames are dropped
+		wire = wire_format::wire_text;	// Client on the other side may be older, wait for its config
 		return;
 	}
 
@@ -276,7 +313,7 @@ void read_lan(networking* netw)
 	case dataframe_types::command:
 		if (message.find('-', 0) == std::string::npos) return;	// Dummy check
 		message = get_latest_command(message);	// latest command
-		handle_incoming_commands(message, netw);
+		handle_incoming_commands(message);
 		break;
 	case dataframe_types::errors:
 		// Possible error handling in future
@@ -286,7 +323,7 @@ void read_lan(networking* netw)
 	case dataframe_types::acknowledge:
 		break;
 	case dataframe_types::config:
-		set_config(message, netw);
+		set_config(message);
 		break;
 	default:
 		message.insert(0, "UNEXPECTED MES: ");
@@ -296,20 +333,16 @@ void read_lan(networking* netw)
 	return;
 }
 
-// send data to socket
-void send_to_lan(networking* netw, std::string message, dataframe_types type)
+// send data to socket - payload is moved to the sender, header is sent with it separately (no copy)
+void send_to_lan(std::string message, dataframe_types type)
 {
-	serializer::attach_header(message, type);
-	int bytes = netw->send_to_lan(message);
-	if (bytes < 0) perror("message not sent\n");
-}
+	// Client which asked for binary frames parses binary headers too
+	bool binary_header = (wire != wire_format::wire_text);
 
-/* Output - ClusterType | Energies(uint16_t) | OnePixel */
-template <typename T>
-void send_to_lan(networking* netw, std::vector<T> output, dataframe_types type)
-{
-	int bytes = netw->send_to_lan(reinterpret_cast<const char*>(output.data()), output.size() * sizeof(T));
-	if (bytes < 0) perror("vector not sent\n");
+	// Data frames wait for the batch, messages go out right away
+	bool urgent = (type == dataframe_types::messages || type == dataframe_types::errors || type == dataframe_types::acknowledge
+		|| type == dataframe_types::config || type == dataframe_types::command);
+	sender->post(type, std::move(message), binary_header, urgent);
 }
 
 /*
@@ -359,6 +392,10 @@ int main(int argc, char **argv) {
 		}
 	}
 
+	// Output is sent from its own thread, main loop only queues the frames
+	sender = new lan_sender(network);
+	sender->start();
+
 	/* MAIN LOOP */
 	uint32_t pending_timer = 0;
 	program_running = true;
@@ -383,7 +420,7 @@ int main(int argc, char **argv) {
 
 			if (last_meas_state == false)
 			{
-				send_to_lan(network, "MEAS STARTED", dataframe_types::messages);
+				send_to_lan("MEAS STARTED", dataframe_types::messages);
 				pending_timer = 0;
 				pending_meas_finished = false;
 			}
@@ -394,17 +431,32 @@ int main(int argc, char **argv) {
 				fflush(stdout);
 
 				// Debug output
-				char buf_string[200];
+				char buf_string[300];
 				snprintf(buf_string, sizeof(buf_string), "\nReads = %d, Messages: %d, Pixels = %d, real out Pixels = %d", plugin->get_reads(), plugin->get_mes(), plugin->get_pix(), plugin->pixels_num);
 				printf(buf_string);
+
+				const size_t batches = plugin->get_batches();
+				const size_t batch_pixels = plugin->get_batch_pixels();
+				const size_t busy_us = plugin->get_batch_busy_us();
+				snprintf(buf_string, sizeof(buf_string), "\nBatches = %zu, pixels per batch = %zu, processing = %.2f Mpix/s",
+					batches, (batches > 0) ? (batch_pixels / batches) : 0, (busy_us > 0) ? (static_cast<double>(batch_pixels) / busy_us) : 0.0);
+				printf(buf_string);
+				fflush(stdout);
+
+				// Exact number of pixels lost and where, also to the PC
+				const pixel_feeder::drop_stats drops = plugin->get_drop_stats();
+				snprintf(buf_string, sizeof(buf_string), "MEAS STATS: sampled out = %zu, dropped oldest = %zu, queue full = %zu, lost on board = %zu, reader blocked = %zu ms",
+					drops.sampled_out, drops.dropped_oldest, drops.queue_full, drops.lost_on_board, drops.blocked_us / 1000);
+				printf("\n%s", buf_string);
 				fflush(stdout);
+				send_to_lan(buf_string, dataframe_types::messages);
 
 				plugin->pixels_num = 0;
 
 				pending_timer = 0;
 				pending_meas_finished = false;
 
-				send_to_lan(network, "MEAS FINISHED", dataframe_types::messages);
+				send_to_lan("MEAS FINISHED", dataframe_types::messages);
 			}
 		}
 
@@ -414,24 +466,65 @@ int main(int argc, char **argv) {
 
 		plugin->check_err_state();	// Check network and reconnect if necessary
 		plugins mode = plugin->get_running_plugins();
+		const bool can_send = (sender->is_full() == false);	// Else output waits in clustering
 
 		// State machine - send output data according to the running mode
 		switch (mode) {
 		case plugins::simple_receiver:
-			if (plugin->is_done_pixels_big())
-				send_to_lan(network, serializer::serialize_pixels(plugin->get_done_pixels()), dataframe_types::pixels);
+			if (can_send && plugin->is_done_pixels_big())
+			{
+				std::string payload = sender->get_buffer();	// Serialized right into a pooled buffer
+				if (wire != wire_format::wire_text)
+				{
+					serializer::serialize_pixels_binary(plugin->get_done_pixels(), wire == wire_format::wire_compact, payload);
+					send_to_lan(std::move(payload), dataframe_types::pixels_binary);
+				}
+				else
+				{
+					serializer::serialize_pixels(plugin->get_done_pixels(), payload);
+					send_to_lan(std::move(payload), dataframe_types::pixels);
+				}
+			}
 			break;
 		case plugins::clustering_clusters:
-			if(plugin->is_done_clusters_big())
-				send_to_lan(network, serializer::serialize_clusters(plugin->get_done_clusters()), dataframe_types::clusters);
+			if (can_send && plugin->is_done_clusters_big())
+			{
+				std::string payload = sender->get_buffer();
+				if (wire != wire_format::wire_text)
+				{
+					serializer::serialize_clusters_binary(plugin->get_done_clusters(), wire == wire_format::wire_compact, payload);
+					send_to_lan(std::move(payload), dataframe_types::clusters_binary);
+				}
+				else
+				{
+					serializer::serialize_clusters(plugin->get_done_clusters(), payload);
+					send_to_lan(std::move(payload), dataframe_types::clusters);
+				}
+			}
 			break;
 		case plugins::clustering_energies:
-			if (plugin->is_done_histograms_big())
-				send_to_lan(network, serializer::serialize_histograms(plugin->get_done_histograms(), plugin->get_pixel_counts_for_energies()), dataframe_types::energies);
+			if (can_send && plugin->is_done_histograms_big())
+			{
+				std::string payload = sender->get_buffer();
+				serializer::serialize_histograms(plugin->get_done_histograms(), plugin->get_pixel_counts_for_energies(), payload);
+				send_to_lan(std::move(payload), dataframe_types::energies);
+			}
 			break;
 		case plugins::pixel_counting:
-			if (plugin->is_done_counts_big())
-				send_to_lan(network, serializer::serialize_pixel_counts(plugin->get_done_counts()), dataframe_types::pixel_counts);
+			if (can_send && plugin->is_done_counts_big())
+			{
+				std::string payload = sender->get_buffer();
+				if (wire != wire_format::wire_text)
+				{
+					serializer::serialize_pixel_counts_binary(plugin->get_done_counts(), wire == wire_format::wire_compact, payload);
+					send_to_lan(std::move(payload), dataframe_types::pixel_counts_binary);
+				}
+				else
+				{
+					serializer::serialize_pixel_counts(plugin->get_done_counts(), payload);
+					send_to_lan(std::move(payload), dataframe_types::pixel_counts);
+				}
+			}
 			break;
 		case plugins::idle:
 			// Flush the pipe - Do nothing - < 0 means timeout, in that case, dont sleep
@@ -445,7 +538,7 @@ int main(int argc, char **argv) {
 			break;
 		default:
 			utility::print_info("Error: Running unexpected mode, switching to idle!",0);
-			send_to_lan(network, "Running unexpected mode! Switch mode to fix.", dataframe_types::errors);
+			send_to_lan("Running unexpected mode! Switch mode to fix.", dataframe_types::errors);
 			plugin->plugin_start(plugins::idle);
 			perror("Running in unexpected mode\n");
 			fflush(stdout);
@@ -453,11 +546,12 @@ int main(int argc, char **argv) {
 		}
 		fflush(stdout);
 
-		// Send data to PC every X milliseconds
-		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		// Take output as soon as there is some - sender batches it, commands are checked at least every WAIT_TIMEOUT_MS
+		plugin->wait_for_output(WAIT_TIMEOUT_MS);
 	}
 
 	// Cleanup the pointers
+	delete sender;
 	delete network;
 	delete plugin;
 
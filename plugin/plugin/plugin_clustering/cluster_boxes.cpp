@@ -0,0 +1,81 @@
+/**
+ * @cluster_boxes.cpp
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+#include "cluster_boxes.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CLUSTER_BOXES_NEON
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CLUSTER_BOXES_SSE2
+#endif
+
+const size_t cluster_boxes::LANES;
+
+void cluster_boxes::candidates(uint16_t x, uint16_t y, std::vector<uint32_t>& out) const
+{
+	out.clear();
+
+	const int16_t px = static_cast<int16_t>(x);
+	const int16_t py = static_cast<int16_t>(y);
+	const size_t blocks = (count + LANES - 1) / LANES;
+
+#if defined(CLUSTER_BOXES_NEON)
+	const int16x8_t vx = vdupq_n_s16(px);
+	const int16x8_t vy = vdupq_n_s16(py);
+
+	for (size_t b = 0; b < blocks; b++)
+	{
+		const size_t i = b * LANES;
+
+		// Lanes are 0xFFFF where xLo <= x <= xHi and yLo <= y <= yHi
+		const uint16x8_t inX = vandq_u16(vcleq_s16(vld1q_s16(&xLo[i]), vx), vcgeq_s16(vld1q_s16(&xHi[i]), vx));
+		const uint16x8_t inY = vandq_u16(vcleq_s16(vld1q_s16(&yLo[i]), vy), vcgeq_s16(vld1q_s16(&yHi[i]), vy));
+		const uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(vandq_u16(inX, inY))), 0);	// Byte per lane
+
+		if (mask == 0) continue;
+
+		for (size_t lane = 0; lane < LANES; lane++)
+		{
+			if ((mask >> (lane * 8)) & 0xFF) out.push_back(static_cast<uint32_t>(i + lane));
+		}
+	}
+#elif defined(CLUSTER_BOXES_SSE2)
+	const __m128i vx = _mm_set1_epi16(px);
+	const __m128i vy = _mm_set1_epi16(py);
+
+	for (size_t b = 0; b < blocks; b++)
+	{
+		const size_t i = b * LANES;
+
+		// Lanes are 0xFFFF where pixel is outside of the box (xLo > x || x > xHi || yLo > y || y > yHi)
+		const __m128i outX = _mm_or_si128(_mm_cmpgt_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&xLo[i])), vx),
+			_mm_cmpgt_epi16(vx, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&xHi[i]))));
+		const __m128i outY = _mm_or_si128(_mm_cmpgt_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&yLo[i])), vy),
+			_mm_cmpgt_epi16(vy, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&yHi[i]))));
+		const uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(outX, outY))) & 0xFFFF;	// 2 bits per lane
+
+		if (mask == 0) continue;
+
+		for (size_t lane = 0; lane < LANES; lane++)
+		{
+			if ((mask >> (lane * 2)) & 0x1) out.push_back(static_cast<uint32_t>(i + lane));
+		}
+	}
+#else
+	for (size_t b = 0; b < blocks; b++)
+	{
+		const size_t i = b * LANES;
+
+		for (size_t lane = 0; lane < LANES; lane++)
+		{
+			const size_t j = i + lane;
+			if (xLo[j] <= px && px <= xHi[j] && yLo[j] <= py && py <= yHi[j]) out.push_back(static_cast<uint32_t>(j));
+		}
+	}
+#endif
+}
@@ -0,0 +1,164 @@
+/**
+ * @cluster_boxes.h
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+#ifndef PLUGIN_CLUSTERING_CLUSTER_BOXES_H_
+#define PLUGIN_CLUSTERING_CLUSTER_BOXES_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/*
+ * List of open clusters kept as struct of arrays - id, generation and bounding box of every cluster
+ * lie in parallel arrays, in order of creation of the clusters.
+ *
+ * Pixel first goes through candidates(), which compares it with LANES bounding boxes at once
+ * (NEON / SSE2, scalar otherwise) without touching the clusters in cluster_forest.
+ * Only the clusters whose box (grown by 1 pixel) contains the pixel are then checked pixel by pixel.
+ *
+ * Removed clusters are only marked (kill) - their box never matches. Entries are dropped by compact(),
+ * which keeps the order of the rest.
+ */
+
+class cluster_boxes
+{
+public:
+	static const size_t LANES = 8;		// Boxes compared in one step, arrays are padded to multiple of LANES
+
+	size_t size() const { return count; };
+	uint32_t id(size_t idx) const { return ids[idx]; };
+	uint32_t generation(size_t idx) const { return generations[idx]; };
+	int64_t min_toa(size_t idx) const { return minToA[idx]; };
+	int64_t max_toa(size_t idx) const { return maxToA[idx]; };
+
+	/// <summary>
+	/// Append open cluster (root id and its node from cluster_forest).
+	/// </summary>
+	template <typename Node>
+	void push(uint32_t root, const Node& n)
+	{
+		if (count == ids.size()) grow();
+		set(count, root, n);
+		count++;
+	}
+
+	/// <summary>
+	/// Overwrite entry with cluster (after adding pixel or joining clusters).
+	/// </summary>
+	template <typename Node>
+	void set(size_t idx, uint32_t root, const Node& n)
+	{
+		ids[idx] = root;
+		generations[idx] = n.generation;
+		minToA[idx] = n.minToA;
+		maxToA[idx] = n.maxToA;
+		xLo[idx] = static_cast<int16_t>(n.xMin - 1);
+		xHi[idx] = static_cast<int16_t>(n.xMax + 1);
+		yLo[idx] = static_cast<int16_t>(n.yMin - 1);
+		yHi[idx] = static_cast<int16_t>(n.yMax + 1);
+	}
+
+	/// <summary>
+	/// Mark entry as removed - it is never returned by candidates() again.
+	/// </summary>
+	void kill(size_t idx)
+	{
+		xLo[idx] = INT16_MAX;
+		xHi[idx] = INT16_MIN;
+	}
+
+	/// <summary>
+	/// Entry was removed by kill() - its id can still be an open root (cluster joined under this id lives in another entry).
+	/// </summary>
+	bool is_killed(size_t idx) const
+	{
+		return xLo[idx] > xHi[idx];
+	}
+
+	/// <summary>
+	/// Fill out with indices of entries whose box contains pixel (x, y), in order of entries.
+	/// </summary>
+	void candidates(uint16_t x, uint16_t y, std::vector<uint32_t>& out) const;
+
+	/// <summary>
+	/// Drop entries which are not open roots in forest anymore (killed, joined or closed), order of the rest is kept.
+	/// </summary>
+	template <typename Forest>
+	void compact(const Forest& forest)
+	{
+		size_t keep = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (is_killed(i) || forest.is_open_root(ids[i], generations[i]) == false) continue;
+
+			ids[keep] = ids[i];
+			generations[keep] = generations[i];
+			minToA[keep] = minToA[i];
+			maxToA[keep] = maxToA[i];
+			xLo[keep] = xLo[i];
+			xHi[keep] = xHi[i];
+			yLo[keep] = yLo[i];
+			yHi[keep] = yHi[i];
+			keep++;
+		}
+
+		for (size_t i = keep; i < count; i++)
+		{
+			kill(i);	// Keep padding harmless
+		}
+		count = keep;
+	}
+
+	/// <summary>
+	/// Delete all entries and free the memory.
+	/// </summary>
+	void clear()
+	{
+		count = 0;
+		ids.clear();
+		ids.shrink_to_fit();
+		generations.clear();
+		generations.shrink_to_fit();
+		minToA.clear();
+		minToA.shrink_to_fit();
+		maxToA.clear();
+		maxToA.shrink_to_fit();
+		xLo.clear();
+		xLo.shrink_to_fit();
+		xHi.clear();
+		xHi.shrink_to_fit();
+		yLo.clear();
+		yLo.shrink_to_fit();
+		yHi.clear();
+		yHi.shrink_to_fit();
+	}
+
+private:
+	size_t count = 0;
+
+	std::vector<uint32_t> ids;			// Root of the cluster in cluster_forest
+	std::vector<uint32_t> generations;	// Generation of the root when it was stored
+	std::vector<int64_t> minToA;
+	std::vector<int64_t> maxToA;
+	std::vector<int16_t> xLo, xHi;		// xMin - 1, xMax + 1
+	std::vector<int16_t> yLo, yHi;		// yMin - 1, yMax + 1
+
+	void grow()
+	{
+		const size_t size = ids.size() + LANES;
+
+		ids.resize(size, 0);
+		generations.resize(size, 0);
+		minToA.resize(size, 0);
+		maxToA.resize(size, 0);
+		xLo.resize(size, INT16_MAX);	// Padding never matches
+		xHi.resize(size, INT16_MIN);
+		yLo.resize(size, INT16_MAX);
+		yHi.resize(size, INT16_MIN);
+	}
+};
+
+#endif /* PLUGIN_CLUSTERING_CLUSTER_BOXES_H_ */
@@ -20,6 +20,7 @@
 #include <cmath>
 #include <array>
 #include <cassert>
+#include <utility>
 
 struct OnePixel		// Pixel data
 {
@@ -45,7 +46,7 @@ struct ClusterType
 
 	ClusterType(std::vector<OnePixel> pix, int64_t minToA, int64_t maxToA,
 		uint16_t xMax, uint16_t xMin, uint16_t yMax, uint16_t yMin)
-		: pix(pix), minToA(minToA), maxToA(maxToA), xMax(xMax), xMin(xMin), yMax(yMax), yMin(yMin)
+		: pix(std::move(pix)), minToA(minToA), maxToA(maxToA), xMax(xMax), xMin(xMin), yMax(yMax), yMin(yMin)
 	{
 	};
 };
@@ -55,7 +56,7 @@ struct CompactClusterType
 {
 	std::vector<OnePixel> pix;
 
-	CompactClusterType(std::vector<OnePixel> pix) : pix(pix)
+	CompactClusterType(std::vector<OnePixel> pix) : pix(std::move(pix))
 	{
 	};
 };
@@ -80,6 +81,36 @@ struct ClusteringParamsOnline
 	int clusterFilterSize;
 	int outerFilterSize;
 	bool filterBiggerClusters;
+
+	// Feeder backpressure - what to do when queued pixels reach highWatermark (bytes), until they drop to lowWatermark
+	int backpressure;			// backpressure_policy
+	int sampleEvery;			// Keep every Nth pixel with backpressure_policy::sample
+	int64_t highWatermark;
+	int64_t lowWatermark;
+
+	// Online clustering threads - pixel stream is cut into time slices clustered in parallel, 1 is single threaded
+	int threads;
+
+	// Encoding of data frames - client asks for one (wire_format), device acknowledges the one it will use
+	int wireFormat;
+
+	// Sending of output - queued frames are sent when they reach sendBatchBytes or the oldest waits sendMaxLatency (ms)
+	int64_t sendBatchBytes;
+	int sendMaxLatency;
+};
+
+enum backpressure_policy
+{
+	block_reader,	// Stop reading the detector pipe - board reports the pixels it could not send as lost
+	drop_oldest,	// Throw away oldest queued pixels
+	sample			// Keep only every sampleEvery-th pixel
+};
+
+enum wire_format
+{
+	wire_text,		// Text frames, understood by every version
+	wire_binary,	// Binary cluster, pixel and pixel_counts frames, packed
+	wire_compact	// Binary frames, delta and varint coded - smallest
 };
 
 struct OnePixelCount
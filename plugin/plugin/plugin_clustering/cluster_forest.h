@@ -0,0 +1,387 @@
+/**
+ * @cluster_forest.h
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <cassert>
+#include <queue>
+#include <functional>
+
+/// <summary>
+/// cluster_forest keeps open clusters as disjoint sets (union-find with path halving and union by size).
+///
+/// Pixels of a cluster are stored in fixed-size chunks linked into a list, so joining two clusters
+/// only splices the chunk lists - no pixel is copied and no cluster vector is shifted.
+/// The whole cluster (std::vector of pixels) is materialised only when it is closed.
+///
+/// Cluster is referenced by id of its root node. After unite() only the returned root is valid as a cluster,
+/// other ids of the set can be resolved by find() until the cluster is released.
+/// </summary>
+template <typename Pixel>
+class cluster_forest
+{
+public:
+	typedef decltype(Pixel::ToA) TimeType;
+
+	static const uint32_t NONE = 0xFFFFFFFF;
+	static const uint32_t CHUNK_SIZE = 16;		// Pixels per chunk, most clusters fit into one
+
+	struct node
+	{
+		uint32_t parent;
+		uint32_t size;			// Number of pixels (valid in root)
+		uint32_t head, tail;	// Chunk list of pixels (valid in root)
+		uint32_t first_member;	// List of nodes of the set, used for releasing (valid in root)
+		uint32_t last_member;
+		uint32_t next_member;
+		uint32_t generation;	// Bumped every time the node is reused for new cluster
+		bool open;				// Cluster was not released yet
+		TimeType minToA;
+		TimeType maxToA;
+		uint16_t xMax;
+		uint16_t xMin;
+		uint16_t yMax;
+		uint16_t yMin;
+	};
+
+	/// <summary>
+	/// Create a new cluster with one pixel, returns its id.
+	/// </summary>
+	uint32_t make_cluster(const Pixel& pix)
+	{
+		uint32_t id = 0;
+
+		if (free_nodes.empty())
+		{
+			id = static_cast<uint32_t>(nodes.size());
+			nodes.emplace_back();
+		}
+		else
+		{
+			id = free_nodes.back();
+			free_nodes.pop_back();
+		}
+
+		node& n = nodes[id];
+		n.parent = id;
+		n.generation++;
+		n.open = true;
+		n.size = 1;
+		n.head = n.tail = alloc_chunk();
+		n.first_member = n.last_member = id;
+		n.next_member = NONE;
+		n.minToA = n.maxToA = pix.ToA;
+		n.xMax = n.xMin = pix.x;
+		n.yMax = n.yMin = pix.y;
+
+		chunk_pixels[n.tail * CHUNK_SIZE] = pix;
+		chunk_fill[n.tail] = 1;
+
+		return id;
+	}
+
+	/// <summary>
+	/// Find root of the cluster, halving the path on the way.
+	/// </summary>
+	uint32_t find(uint32_t id)
+	{
+		while (nodes[id].parent != id)
+		{
+			nodes[id].parent = nodes[nodes[id].parent].parent;
+			id = nodes[id].parent;
+		}
+
+		return id;
+	}
+
+	/// <summary>
+	/// Append pixel to the cluster and update its limits.
+	/// </summary>
+	void add_pixel(uint32_t root, const Pixel& pix)
+	{
+		node& n = nodes[root];
+		assert("Pixel can be added only to root" && n.parent == root);
+
+		/* Update Min Max coord values */
+		if (pix.x > n.xMax) n.xMax = pix.x;
+		else if (pix.x < n.xMin) n.xMin = pix.x;
+		if (pix.y > n.yMax) n.yMax = pix.y;
+		else if (pix.y < n.yMin) n.yMin = pix.y;
+		if (n.minToA > pix.ToA) n.minToA = pix.ToA; // Save ToA min
+		if (n.maxToA < pix.ToA) n.maxToA = pix.ToA; // Save ToA max
+
+		if (chunk_fill[n.tail] == CHUNK_SIZE)
+		{
+			uint32_t chunk = alloc_chunk();
+			chunk_next[n.tail] = chunk;
+			n.tail = chunk;
+		}
+
+		chunk_pixels[(n.tail * CHUNK_SIZE) + chunk_fill[n.tail]] = pix;
+		chunk_fill[n.tail]++;
+		n.size++;
+	}
+
+	/// <summary>
+	/// Join source cluster into target cluster. Pixels of source follow pixels of target.
+	/// Returns the new root - smaller set is always hung under the bigger one.
+	/// </summary>
+	uint32_t unite(uint32_t target, uint32_t source)
+	{
+		assert("Only roots can be united" && nodes[target].parent == target && nodes[source].parent == source);
+		if (target == source) return target;
+
+		node& to = nodes[target];
+		node& from = nodes[source];
+
+		// Splice chunk and member lists - order is kept as target, source
+		chunk_next[to.tail] = from.head;
+		nodes[to.last_member].next_member = from.first_member;
+
+		const uint32_t root = (to.size >= from.size) ? target : source;
+		const uint32_t child = (root == target) ? source : target;
+		node& r = nodes[root];
+		node& c = nodes[child];
+
+		r.head = to.head;
+		r.tail = from.tail;
+		r.first_member = to.first_member;
+		r.last_member = from.last_member;
+		r.size = to.size + from.size;
+
+		/* Join min max values of clusters */
+		if (c.xMax > r.xMax) r.xMax = c.xMax;
+		if (c.xMin < r.xMin) r.xMin = c.xMin;
+		if (c.yMax > r.yMax) r.yMax = c.yMax;
+		if (c.yMin < r.yMin) r.yMin = c.yMin;
+		if (c.minToA < r.minToA) r.minToA = c.minToA; // Merge ToA min
+		if (c.maxToA > r.maxToA) r.maxToA = c.maxToA; // Merge ToA max
+
+		c.parent = root;
+		return root;
+	}
+
+	/// <summary>
+	/// Returns true if id is still root of an open cluster created in given generation.
+	/// </summary>
+	bool is_open_root(uint32_t id, uint32_t generation) const
+	{
+		const node& n = nodes[id];
+		return n.open && n.parent == id && n.generation == generation;
+	}
+
+	/// <summary>
+	/// Access cluster data (limits, size) of root.
+	/// </summary>
+	const node& get(uint32_t root) const
+	{
+		return nodes[root];
+	}
+
+	/// <summary>
+	/// Returns true if predicate is true for any pixel of the cluster. Stops on first match.
+	/// </summary>
+	template <typename Func>
+	bool any_pixel(uint32_t root, Func pred) const
+	{
+		for (uint32_t chunk = nodes[root].head; chunk != NONE; chunk = chunk_next[chunk])
+		{
+			const Pixel* pix = &chunk_pixels[chunk * CHUNK_SIZE];
+			for (uint32_t i = 0; i < chunk_fill[chunk]; i++)
+			{
+				if (pred(pix[i])) return true;
+			}
+		}
+
+		return false;
+	}
+
+	/// <summary>
+	/// Copy pixels of the cluster into vector, cluster stays open.
+	/// </summary>
+	std::vector<Pixel> pixels(uint32_t root) const
+	{
+		std::vector<Pixel> out;
+		out.reserve(nodes[root].size);
+
+		for (uint32_t chunk = nodes[root].head; chunk != NONE; chunk = chunk_next[chunk])
+		{
+			const Pixel* pix = &chunk_pixels[chunk * CHUNK_SIZE];
+			out.insert(out.end(), pix, pix + chunk_fill[chunk]);
+		}
+
+		return out;
+	}
+
+	/// <summary>
+	/// Materialise closed cluster as Cluster (pix, minToA, maxToA, xMax, xMin, yMax, yMin) and release it.
+	/// </summary>
+	template <typename Cluster>
+	Cluster take(uint32_t root)
+	{
+		const node& n = nodes[root];
+		Cluster cluster(pixels(root), n.minToA, n.maxToA, n.xMax, n.xMin, n.yMax, n.yMin);
+		release(root);
+		return cluster;
+	}
+
+	/// <summary>
+	/// Materialise only pixels of closed cluster and release it.
+	/// </summary>
+	std::vector<Pixel> take_pixels(uint32_t root)
+	{
+		std::vector<Pixel> out = pixels(root);
+		release(root);
+		return out;
+	}
+
+	/// <summary>
+	/// Return chunks and nodes of the cluster back to the pools.
+	/// </summary>
+	void release(uint32_t root)
+	{
+		uint32_t chunk = nodes[root].head;
+		while (chunk != NONE)
+		{
+			uint32_t next = chunk_next[chunk];
+			chunk_next[chunk] = NONE;
+			chunk_fill[chunk] = 0;
+			free_chunks.push_back(chunk);
+			chunk = next;
+		}
+
+		uint32_t member = nodes[root].first_member;
+		while (member != NONE)
+		{
+			uint32_t next = nodes[member].next_member;
+			nodes[member].open = false;
+			free_nodes.push_back(member);
+			member = next;
+		}
+	}
+
+	/// <summary>
+	/// Delete all clusters and free the memory.
+	/// </summary>
+	void clear()
+	{
+		nodes.clear();
+		nodes.shrink_to_fit();
+		free_nodes.clear();
+		free_nodes.shrink_to_fit();
+		chunk_pixels.clear();
+		chunk_pixels.shrink_to_fit();
+		chunk_next.clear();
+		chunk_next.shrink_to_fit();
+		chunk_fill.clear();
+		chunk_fill.shrink_to_fit();
+		free_chunks.clear();
+		free_chunks.shrink_to_fit();
+	}
+
+private:
+	std::vector<node> nodes;
+	std::vector<uint32_t> free_nodes;
+
+	std::vector<Pixel> chunk_pixels;		// CHUNK_SIZE pixels per chunk
+	std::vector<uint32_t> chunk_next;		// Next chunk of the same cluster
+	std::vector<uint32_t> chunk_fill;		// Used pixels in chunk
+	std::vector<uint32_t> free_chunks;
+
+	uint32_t alloc_chunk()
+	{
+		if (free_chunks.empty() == false)
+		{
+			uint32_t chunk = free_chunks.back();
+			free_chunks.pop_back();
+			return chunk;
+		}
+
+		chunk_pixels.resize(chunk_pixels.size() + CHUNK_SIZE, Pixel(0, 0, 0, 0));
+		chunk_next.push_back(NONE);
+		chunk_fill.push_back(0);
+		return static_cast<uint32_t>(chunk_next.size() - 1);
+	}
+};
+
+/// <summary>
+/// cluster_expiry orders open clusters of cluster_forest by their maxToA (min-heap).
+///
+/// Only clusters which really expired are touched when closing - instead of checking delay of every open cluster.
+/// Entries are lazy: joined or released clusters are skipped when they get to the top, and cluster
+/// which got new pixels since its entry was pushed is pushed again with its current maxToA.
+/// Every open root needs one entry pushed on creation, joins need nothing - root keeps its entry with lower maxToA.
+/// </summary>
+template <typename Pixel>
+class cluster_expiry
+{
+public:
+	typedef typename cluster_forest<Pixel>::TimeType TimeType;
+
+	/// <summary>
+	/// Register newly created cluster.
+	/// </summary>
+	void push(const cluster_forest<Pixel>& forest, uint32_t id)
+	{
+		heap.push(entry{ forest.get(id).maxToA, id, forest.get(id).generation });
+	}
+
+	/// <summary>
+	/// Get next cluster with (ToA - maxToA) > delay. Returns false if there is none.
+	/// Caller is responsible for closing (releasing) the returned cluster.
+	/// </summary>
+	template <typename Delay>
+	bool pop_expired(const cluster_forest<Pixel>& forest, TimeType ToA, Delay delay, uint32_t& id)
+	{
+		while (!heap.empty() && (ToA - heap.top().maxToA) > delay)
+		{
+			entry top = heap.top();
+			heap.pop();
+
+			if (forest.is_open_root(top.id, top.generation) == false) continue;	// Joined into another cluster or closed
+
+			if ((ToA - forest.get(top.id).maxToA) > delay)
+			{
+				id = top.id;
+				return true;
+			}
+
+			// Cluster got new pixels since the entry was pushed
+			top.maxToA = forest.get(top.id).maxToA;
+			heap.push(top);
+		}
+
+		return false;
+	}
+
+	/// <summary>
+	/// Delete all entries and free the memory.
+	/// </summary>
+	void clear()
+	{
+		heap = decltype(heap)();
+	}
+
+private:
+	struct entry
+	{
+		TimeType maxToA;
+		uint32_t id;
+		uint32_t generation;
+
+		bool operator>(const entry& other) const { return maxToA > other.maxToA; };
+	};
+
+	std::priority_queue<entry, std::vector<entry>, std::greater<entry>> heap;	// Oldest maxToA on top
+};
+
+template <typename Pixel>
+const uint32_t cluster_forest<Pixel>::NONE;
+
+template <typename Pixel>
+const uint32_t cluster_forest<Pixel>::CHUNK_SIZE;
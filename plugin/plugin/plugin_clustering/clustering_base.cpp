@@ -6,6 +6,9 @@
 
 #include <clustering_base.h>
 
+const uint64_t clustering_base::STREAM_BATCH_LINES;
+const size_t clustering_base::STREAM_BATCHES;
+
 int clustering_base::test_all_lines_used() {
     assert("Fault = lines processed doesnt match" && stat_lines_processed == stat_lines_saved);
 
@@ -17,7 +20,7 @@ int clustering_base::test_all_lines_used() {
     return -1;  // Fault
 }
 
-bool clustering_base::get_my_line(const std::string& str, std::string& oneLine, const bool& rn_delim)
+bool clustering_base::get_my_line(text_view str, std::string& oneLine, const bool& rn_delim)
 {
     static size_t pos = 0;
     static size_t last_pos = 0;
@@ -40,7 +43,7 @@ bool clustering_base::get_my_line(const std::string& str, std::string& oneLine,
     else return false;
 }
 
-bool clustering_base::get_my_line_MT(const std::string& str, std::string& oneLine, const bool& rn_delim, size_t& last_pos)
+bool clustering_base::get_my_line_MT(text_view str, std::string& oneLine, const bool& rn_delim, size_t& last_pos)
 {
     size_t pos = 0;
     pos = str.find('\n', pos + 1);
@@ -150,3 +153,23 @@ void clustering_base::set_calibs(double* a, double* b, double* c, double* t)
         calib_t[i] = *t++;
     }
 }
+
+pixel_parser::result clustering_base::parse_pixels(text_view text, size_t offset, pixel_parser::line_format format, int outerFilterSize, bool calibReady, std::vector<OnePixel>& pixels, volatile bool& abort, uint64_t maxLines)
+{
+    const size_t first = pixels.size();
+    pixel_parser::result res = pixel_parser::parse(text, offset, format, outerFilterSize, pixels, abort, maxLines);
+
+    stat_lines_sorted += res.lines;
+    stat_lines_processed += res.pixels;
+
+    if (calibReady)
+    {
+        for (size_t i = first; i < pixels.size(); i++)
+        {
+            OnePixel& pix = pixels[i];
+            pix.ToT = static_cast<int32_t>(energy_calc(pix.x, pix.y, pix.ToT));
+        }
+    }
+
+    return res;
+}
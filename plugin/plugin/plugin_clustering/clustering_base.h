@@ -8,6 +8,9 @@
 
 #include "utility.h"
 #include "cluster_definition.h"
+#include "pixel_parser.h"
+#include "pixel_stream.h"
+#include <thread>
 #include <cmath>
 
 class clustering_base : public utility
@@ -60,8 +63,83 @@ public:
 	}
 
 protected:
-	bool get_my_line_MT(const std::string& str, std::string& oneLine, const bool& rn_delim, size_t& last_pos);
-	bool get_my_line(const std::string& str, std::string& oneLine, const bool& rn_delim);
+	/// <summary>
+	/// Parse pixel lines of text (pixel_parser), update line stats and calibrate ToT when enabled
+	/// </summary>
+	pixel_parser::result parse_pixels(text_view text, size_t offset, pixel_parser::line_format format, int outerFilterSize, bool calibReady, std::vector<OnePixel>& pixels, volatile bool& abort, uint64_t maxLines = UINT64_MAX);
+
+	/// <summary>
+	/// Parse text in batches of STREAM_BATCH_LINES lines and pass every batch to consume(const std::vector<OnePixel>&) in file order.
+	/// Parser runs on its own thread at most STREAM_BATCHES batches ahead of consume, so only these batches are held in memory.
+	/// On single core both stages run in turn on the calling thread.
+	/// </summary>
+	template <typename Consume>
+	pixel_parser::result stream_pixels(text_view text, size_t offset, pixel_parser::line_format format, int outerFilterSize, bool calibReady, volatile bool& abort, Consume consume)
+	{
+		pixel_parser::result total = { offset, 0, 0, false };
+
+		// Parse one batch from the end of previous one, returns true if there may be more lines
+		auto parse_batch = [&](std::vector<OnePixel>& batch) {
+			pixel_parser::result res = parse_pixels(text, total.stop, format, outerFilterSize, calibReady, batch, abort, STREAM_BATCH_LINES);
+			total.stop = res.stop;
+			total.lines += res.lines;
+			total.pixels += res.pixels;
+			total.cluster_marker = res.cluster_marker;
+			return res.lines == STREAM_BATCH_LINES && abort == false;
+		};
+
+		if (std::thread::hardware_concurrency() < 2)
+		{
+			std::vector<OnePixel> batch;
+			bool more = true;
+			while (more)
+			{
+				batch.clear();
+				more = parse_batch(batch);
+				if (batch.empty() == false && abort == false) consume(static_cast<const std::vector<OnePixel>&>(batch));
+			}
+			return total;
+		}
+
+		pixel_batches batches(STREAM_BATCHES);
+
+		std::thread parser([&]() {
+			std::vector<OnePixel> batch;
+			bool more = true;
+			while (more && batches.acquire(batch))
+			{
+				more = parse_batch(batch);
+				if (batch.empty()) batches.release(std::move(batch));
+				else batches.push(std::move(batch));
+			}
+			batches.finish();
+		});
+
+		try
+		{
+			std::vector<OnePixel> batch;
+			while (batches.pop(batch))
+			{
+				if (abort == false) consume(static_cast<const std::vector<OnePixel>&>(batch));
+				batches.release(std::move(batch));
+			}
+		}
+		catch (...)
+		{
+			batches.cancel();
+			parser.join();
+			throw;
+		}
+
+		parser.join();
+		return total;
+	}
+
+	static const uint64_t STREAM_BATCH_LINES = 65536;	// Lines parsed into one batch
+	static const size_t STREAM_BATCHES = 4;				// Batches in flight between parser and clustering
+
+	bool get_my_line_MT(text_view str, std::string& oneLine, const bool& rn_delim, size_t& last_pos);
+	bool get_my_line(text_view str, std::string& oneLine, const bool& rn_delim);
 	double energy_calc(const int& x, const int& y, const int& ToT);
 	float perf_metric(int linesProcessed, float msElapsed);
 
@@ -0,0 +1,135 @@
+/**
+ * @katherine_readout.h
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+#ifndef PLUGIN_CLUSTERING_KATHERINE_READOUT_H_
+#define PLUGIN_CLUSTERING_KATHERINE_READOUT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+	Katherine readout words, as they come from the detector pipe
+	- every word has 6 B (48 bits, little-endian), type of word is in bits 44 - 47:
+
+		0x7		frame start				time offset is reset to 0
+		0xC		frame end
+		0x5		pixel timestamp offset	bits 0 - 31, ToA of following pixels is shifted by offset * 16384 ticks
+		0x4		pixel data				detector 0 (0x0 is the same pixel data)
+		0x0		pixel data
+		0xD		lost pixels				bits 0 - 43, number of pixels the board could not send
+
+	Pixel data word:
+		bits 0 - 3		fToA
+		bits 4 - 13		ToT
+		bits 14 - 27	ToA (25 ns ticks, lower 14 bits of timestamp)
+		bits 28 - 35	x
+		bits 36 - 43	y
+
+	ToA of pixel in ns: (ToA + offset * 16384) * 25 - (fToA * 15625) / 10000, integer as in plugin_definition.
+*/
+
+/// <summary>
+/// katherine_readout decodes blocks of readout words read from the pipe.
+///
+/// Words are decoded in runs of pixel words between control words. split_words() loads 4 words per step
+/// (8 with AVX2) by byte shuffle (NEON / SSSE3 / AVX2, scalar otherwise) and writes columns x, y, ToT and ToA,
+/// fine ToA correction is taken from 16-entry table. Control words are handled at their exact position in stream,
+/// so time offset always applies exactly to pixels which followed it on the wire.
+/// </summary>
+class katherine_readout
+{
+public:
+	enum word_types
+	{
+		pixel_data_alt = 0x0, pixel_data = 0x4, time_offset = 0x5, frame_start = 0x7, frame_end = 0xC, lost_pixels = 0xD
+	};
+
+	/// <summary>
+	/// Decoding state carried from one block of words to the next one.
+	/// </summary>
+	struct state
+	{
+		uint64_t offset = 0;			// Current pixel timestamp offset
+		uint64_t frames = 0;			// Frame starts seen
+		uint64_t lost = 0;				// Sum of lost pixels reported by the board
+		uint64_t unknown = 0;			// Words of unknown type (skipped)
+	};
+
+	static const size_t WORD_BYTES = 6;
+	static const size_t RUN_WORDS = 256;	// Pixel words decoded at once
+
+	/// <summary>
+	/// Pixel words of one run split into columns.
+	/// </summary>
+	struct columns
+	{
+		uint32_t x[RUN_WORDS];
+		uint32_t y[RUN_WORDS];
+		uint32_t tot[RUN_WORDS];
+		uint32_t toa[RUN_WORDS];		// Coarse ToA from the word (25 ns ticks, without time offset)
+		uint32_t ftoa[RUN_WORDS];
+		int64_t time[RUN_WORDS];		// ToA in ns, time offset included
+	};
+
+	static const int64_t FTOA_NS[16];		// Fine ToA correction (ns) for every fToA value
+
+	/// <summary>
+	/// Split n (at most RUN_WORDS) pixel words at data into columns, time offset is applied to time column.
+	/// </summary>
+	static void split_words(const char* data, size_t n, uint64_t offset, columns& cols);
+
+	/// <summary>
+	/// Decode count words at data in stream order. Every control word updates st and is passed to
+	/// handler.control(word, type), every run of pixel words to handler.pixels(cols, n). Returns number of pixel words.
+	/// </summary>
+	template <typename Handler>
+	static uint64_t decode_words(const char* data, uint64_t count, state& st, columns& cols, Handler& handler)
+	{
+		uint64_t read = 0;
+		uint64_t i = 0;
+
+		while (i < count)
+		{
+			/* Run of pixel words */
+			const uint64_t start = i;
+			while (i < count && (i - start) < RUN_WORDS && is_pixel(word_type(data + (i * WORD_BYTES)))) i++;
+
+			const size_t n = static_cast<size_t>(i - start);
+			if (n > 0)
+			{
+				split_words(data + (start * WORD_BYTES), n, st.offset, cols);
+				handler.pixels(static_cast<const columns&>(cols), n);
+				read += n;
+				continue;
+			}
+
+			/* Control word */
+			const uint64_t word = load_word(data + (i * WORD_BYTES));
+			const int type = word_type(data + (i * WORD_BYTES));
+			control_word(word, type, st);
+			handler.control(word, type);
+			i++;
+		}
+
+		return read;
+	}
+
+	// Words are little-endian, same as the board
+	static uint64_t load_word(const char* p)
+	{
+		uint64_t word = 0;
+		std::memcpy(&word, p, WORD_BYTES);
+		return word;
+	}
+
+	// Type is in the upper nibble of the last byte
+	static int word_type(const char* p) { return static_cast<uint8_t>(p[WORD_BYTES - 1]) >> 4; };
+	static bool is_pixel(int type) { return type == pixel_data || type == pixel_data_alt; };
+	static void control_word(uint64_t word, int type, state& st);
+};
+
+#endif /* PLUGIN_CLUSTERING_KATHERINE_READOUT_H_ */
@@ -5,176 +5,125 @@
  */
 
 #include <offline_clustering.h>
-#include <queue>
-#include "string.h"
 
-void offline_clustering::do_clustering(std::string& lines, const ClusteringParams& params, volatile bool& abort)
+void offline_clustering::do_clustering(text_view lines, const ClusteringParams& params, volatile bool& abort)
 {
-	if (lines == "") return;
+	if (lines.empty()) return;
 	if (lines[0] != '#') return;
 	stat_reset();
 
 	doneClusters.clear();
 	doneClusters.shrink_to_fit();
-	clusters.clear();
-	clusters.shrink_to_fit();
+	open_clusters.clear();
+	open_clusters.shrink_to_fit();
+	forest.clear();
 
-	// PARAMETERS
-	uint16_t upFilter = 255 - params.filterSize;
-	uint16_t doFilter = params.filterSize;
-	const double toaLsb = 25;
-	const double toaFineLsb = 1.5625;
-
-	// Loop variables
-	bool prevAdded = false;
-	bool rel {}, relX, relY = false;
-	size_t lastAddCluster = 0;
-
-	std::string oneLine;
-	char* context = nullptr;
-	char* rows[4] = { 0, 0, 0, 0 };
-	std::queue<OnePixel> pixelData;		// FIFO for pixelData
-
-	while (get_my_line(lines, oneLine, params.rn_delim))
-	{      // Gets lines without ending line chars - ex. "\n"
-
-		if (oneLine[0] == '#') continue;
+	ContinualTimer timer;
+	timer.Start();
 
-		if (abort)
-		{
-			return;
-		}
+	// Parsed batches flow straight into clustering - whole file is never held as pixels
+	stream_pixels(lines, 0, pixel_parser::katherine_raw, params.filterSize, params.calibReady, abort,
+		[this, &params](const std::vector<OnePixel>& batch) { cluster_pixels(batch, params); });
 
-		stat_lines_sorted++;
+	double elapsed = timer.Stop();
 
-		rows[0] = strtok_r((char*) oneLine.data(), "\t", &context);
-		rows[1] = strtok_r(NULL, "\t", &context);
-		rows[2] = strtok_r(NULL, "\t", &context);
-		rows[3] = strtok_r(NULL, "\t", &context);
+	if (abort)
+	{
+		open_clusters.clear();
+		forest.clear();
+		return;
+	}
 
-		// ATOI 6300 ms vs STRTOINT 6100 ms with 20 PIX filter
-		// ATOI CCA 200 ms slower than my Fast strtoint
-		int32_t coordX = strtoint(rows[0]) / 256; // std::atoi(rows[0]) / 256;
-		int32_t coordY = strtoint(rows[0]) % 256; // std::atoi(rows[0]) % 256;
-		double toaAbsTime = (double) ((strtolong(rows[1]) * toaLsb) - (strtolong(rows[2]) * toaFineLsb)); // (ns) TimeFromBeginning = 25 * ToA - 1.5625 * fineToA
-		int32_t ToTValue = strtoint(rows[3]);  //std::atoi(rows[3]);
-		if (coordX > upFilter || coordX < doFilter || coordY > upFilter || coordY < doFilter) continue; // This is faster after the inlined funkctions, not after coordY
+	/* POSTPROCESS Clusters */
+	for (auto id : open_clusters) // Remaining move to DONE
+	{
+		doneClusters.emplace_back(forest.take<ClusterType>(id));
+	}
+	open_clusters.clear();
+	open_clusters.shrink_to_fit();
+	forest.clear();
 
-		if (params.calibReady)
-		{
-			ToTValue = energy_calc(coordX, coordY, ToTValue);
-		}
+	/* Utility functions after the clustering */
+	test_saved_clusters();
+	stat_save(elapsed, doneClusters.size());
+	return;
+}
 
-		pixelData.push(std::move(OnePixel(coordX, coordY, ToTValue, toaAbsTime)));
-		stat_lines_processed++;
-	}
+/*
+ *  Clustering of parsed pixels - open clusters are roots in forest, open_clusters holds their ids in order of creation.
+ *  Joined and closed clusters are dropped from open_clusters by compacting it during the pass.
+ */
+void offline_clustering::cluster_pixels(const std::vector<OnePixel>& pixelData, const ClusteringParams& params)
+{
+	// Loop variables
+	bool prevAdded = false;
+	size_t lastAddCluster = 0;
 
-	OnePixel inPixel(0, 0, 0, 0);
+	auto inPixel = pixelData.begin();
 
-	ContinualTimer timer;
-	timer.Start();
+	auto isNeighbour = [&inPixel](const OnePixel& pixs) {
+		bool relX = ((inPixel->x) == (pixs.x + 1)) || ((inPixel->x) == (pixs.x - 1)) || ((inPixel->x) == (pixs.x));    // is (X + 1 == my_X) OR (X - 1 == my_X)
+		bool relY = ((inPixel->y) == (pixs.y + 1)) || ((inPixel->y) == (pixs.y - 1)) || ((inPixel->y) == (pixs.y));    // is (Y + 1 == my_Y) OR (Y - 1 == my_Y)
+		return relX && relY;       // Is related in both X AND Y
+	};
 
-	while (!pixelData.empty())
+	for (; inPixel != pixelData.end(); ++inPixel)
 	{
-		inPixel = pixelData.front();
-		pixelData.pop();
+		size_t keep = 0;	// Open clusters which stay open after this pixel
+
+		for (size_t i = 0; i < open_clusters.size(); i++) {
 
-		for (auto clstr = clusters.begin(); clstr != clusters.end(); clstr++) {
+			const uint32_t id = open_clusters[i];
+			const auto& clstr = forest.get(id);
 
-			if ((inPixel.ToA - clstr->maxToA) > params.maxClusterDelay) // Close Old cluster
+			if ((inPixel->ToA - clstr.maxToA) > params.maxClusterDelay) // Close Old cluster
 			{
-				if ((clstr - clusters.begin()) > 1)
+				if (keep > 1)
 				{
-					doneClusters.emplace_back(*clstr);
-					clstr = clusters.erase(clstr);
-					clstr--;
+					doneClusters.emplace_back(forest.take<ClusterType>(id));
+					continue;
 				}
 
+				open_clusters[keep++] = id;
 				continue;
 			}
 
 			/* ToA range check */
 			// NOTE: m_abs() or double-if causes maxClusterSpan to be double sided, downwards and upwards
-			if ((inPixel.ToA - clstr->minToA) > params.maxClusterSpan || (inPixel.ToA - clstr->minToA) < -params.maxClusterSpan) {   // Cant add to this cluster
+			if ((inPixel->ToA - clstr.minToA) > params.maxClusterSpan || (inPixel->ToA - clstr.minToA) < -params.maxClusterSpan ||   // Cant add to this cluster
+				/* Decide if its worth to go through this cluster */
+				/* IS TOO FAR UNDER || IS TOO FAR UP */
+				inPixel->y < (clstr.yMin - 1) || inPixel->y > (clstr.yMax + 1) ||
+				inPixel->x < (clstr.xMin - 1) || inPixel->x > (clstr.xMax + 1) ||
+				forest.any_pixel(id, isNeighbour) == false)   // Cycle through Pixels of Cluster
+			{
+				open_clusters[keep++] = id;
 				continue;
 			}
 
-			/* Decide if its worth to go through this cluster */
-			/* IS TOO FAR UNDER || IS TOO FAR UP */
-			if (inPixel.y < (clstr->yMin - 1) || inPixel.y >(clstr->yMax + 1)) {
-				continue;
-			}
-			if (inPixel.x < (clstr->xMin - 1) || inPixel.x >(clstr->xMax + 1)) {
-				continue;
+			if (prevAdded)  // Join clusters
+			{
+				// Join current Cluster into LastAddedTo cluster, current one is dropped from open clusters
+				open_clusters[lastAddCluster] = forest.unite(open_clusters[lastAddCluster], id);
 			}
-
-			for (const auto& pixs : clstr->pix) {  // Cycle through Pixels of Cluster
-				//for (auto& pixs : reverse(*clstr)) {  // Cycle through Pixels of Cluster
-
-				relX = ((inPixel.x) == (pixs.x + 1)) || ((inPixel.x) == (pixs.x - 1)) || ((inPixel.x) == (pixs.x));    // is (X + 1 == my_X) OR (X - 1 == my_X)
-				relY = ((inPixel.y) == (pixs.y + 1)) || ((inPixel.y) == (pixs.y - 1)) || ((inPixel.y) == (pixs.y));    // is (Y + 1 == my_Y) OR (Y - 1 == my_Y)
-				rel = relX && relY;       // Is related in both X AND Y
-
-				if (rel)    // If Neighbor, add to cluster
-				{
-					if (prevAdded)  // Join clusters
-					{
-						// Join current Cluster into LastAddedTo cluster and Erase the current one
-						clusters[lastAddCluster].pix.insert(clusters[lastAddCluster].pix.end(), clstr->pix.begin(), clstr->pix.end());
-
-						/* Join min max values of clusters */
-						if (clstr->xMax > clusters[lastAddCluster].xMax) clusters[lastAddCluster].xMax = clstr->xMax;
-						if (clstr->xMin < clusters[lastAddCluster].xMin) clusters[lastAddCluster].xMin = clstr->xMin;
-						if (clstr->yMax > clusters[lastAddCluster].yMax) clusters[lastAddCluster].yMax = clstr->yMax;
-						if (clstr->yMin < clusters[lastAddCluster].yMin) clusters[lastAddCluster].yMin = clstr->yMin;
-						if (clstr->minToA < clusters[lastAddCluster].minToA) clusters[lastAddCluster].minToA = clstr->minToA; // Merge ToA min
-						if (clstr->maxToA > clusters[lastAddCluster].maxToA) clusters[lastAddCluster].maxToA = clstr->maxToA; // Merge ToA max
-
-						clstr = clusters.erase(clstr);       // Erase the current Cluster
-						clstr--;
-					}
-					else            // Simply Add Pixel
-					{
-						/* Update Min Max coord values */
-						if (inPixel.x > clstr->xMax) clstr->xMax = inPixel.x;
-						else if (inPixel.x < clstr->xMin) clstr->xMin = inPixel.x;
-						if (inPixel.y > clstr->yMax) clstr->yMax = inPixel.y;
-						else if (inPixel.y < clstr->yMin) clstr->yMin = inPixel.y;
-						if (clstr->minToA > inPixel.ToA) clstr->minToA = inPixel.ToA; // Save ToA min
-						if (clstr->maxToA < inPixel.ToA) clstr->maxToA = inPixel.ToA; // Save ToA max
-
-						OnePixel newPixel = OnePixel{ inPixel.x, inPixel.y, inPixel.ToT, inPixel.ToA };
-						clstr->pix.emplace_back(std::move(newPixel));
-						lastAddCluster = static_cast<size_t>(clstr - clusters.begin());
-						prevAdded = true;
-					}
-
-					break;  // Pixel was added to cluster => try NEXT cluster
-				}
+			else            // Simply Add Pixel
+			{
+				forest.add_pixel(id, *inPixel);
+				lastAddCluster = keep;
+				open_clusters[keep++] = id;
+				prevAdded = true;
 			}
 		}
 
+		open_clusters.resize(keep);
+
 		if (prevAdded)    // Reset FLAGS
 		{
-			rel = false;
 			prevAdded = false;
 		}
 		else        // Pixel doesnt match to any Cluster - Place new cluster
 		{
-			ClusterType cluster = ClusterType{ PixelCluster{ OnePixel {(uint16_t)inPixel.x, (uint16_t)inPixel.y, inPixel.ToT, inPixel.ToA} }, inPixel.ToA, inPixel.ToA, (uint16_t)inPixel.x, (uint16_t)inPixel.x, (uint16_t)inPixel.y, (uint16_t)inPixel.y };
-			clusters.emplace_back(std::move(cluster));    // Add new cluster
+			open_clusters.push_back(forest.make_cluster(*inPixel));    // Add new cluster
 		}
 	}
-
-	double elapsed = timer.Stop();
-
-	/* POSTPROCESS Clusters */
-	doneClusters.insert(doneClusters.end(), clusters.begin(), clusters.end()); // Remaining move to DONE
-	clusters.clear();
-	clusters.shrink_to_fit();
-
-	/* Utility functions after the clustering */
-	test_saved_clusters();
-	stat_save(elapsed, doneClusters.size());
-	return;
 }
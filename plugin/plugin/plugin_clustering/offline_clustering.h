@@ -8,13 +8,18 @@
 
 #include <clustering_base.h>
 #include "file_loader.h"
+#include "cluster_forest.h"
 
 class offline_clustering : public clustering_base, public cluster_definition
 {
 	public:
-		void do_clustering(std::string& lines, const ClusteringParams& params, volatile bool& abort);
+		void do_clustering(text_view lines, const ClusteringParams& params, volatile bool& abort);
 
 	private:
+		cluster_forest<OnePixel> forest;		// Storage of open clusters
+		std::vector<uint32_t> open_clusters;	// Roots of open clusters in order of creation
+
+		void cluster_pixels(const std::vector<OnePixel>& pixelData, const ClusteringParams& params);
 
 		void test_saved_clusters()
 		{
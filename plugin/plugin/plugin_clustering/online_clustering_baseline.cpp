@@ -6,241 +6,185 @@
 
 #include <online_clustering_baseline.h>
 
-void online_clustering_baseline::cluster_pixel(OnePixel&& pix, std::shared_ptr<MTVector<CompactClusterType>>& done_clusters, ClusteringParamsOnline& params)
+void online_clustering_baseline::cluster_pixel(OnePixel&& pix, std::vector<CompactClusterType>& done_clusters, ClusteringParamsOnline& params)
 {
-	// Loop variables
-	bool prevAdded = false;
-	bool rel{}, relX, relY = false;
-	int lastAddCluster = 0;
-	auto clstr = open_clusters.begin();
+	close_expired(pix.ToA, done_clusters, params);
+	cluster_open(pix, params);
+	return;
+}
+
+// Same as cluster_pixel for every pixel of the batch, the loop keeps open clusters in cache for the whole batch
+void online_clustering_baseline::cluster_pixels(const OnePixel* pixels, size_t count, std::vector<CompactClusterType>& done_clusters, ClusteringParamsOnline& params)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		close_expired(pixels[i].ToA, done_clusters, params);
+		cluster_open(pixels[i], params);
+	}
+}
+
+// Actually slower than normal clustering, energy is postprocess of cluster
+void online_clustering_baseline::cluster_for_energy(OnePixel&& pix, std::vector<uint16_t>& done_energies, std::shared_ptr<MTVariable<size_t>> pixel_count, ClusteringParamsOnline& params)
+{
+	size_t pixels_done = 0;
+	close_expired_energy(pix.ToA, done_energies, pixels_done, params);
+	cluster_open(pix, params);
+
+	// count pixels from cluster -> very important for PC application
+	if (pixels_done > 0) pixel_count->Add_To_Value(pixels_done);
+	return;
+}
+
+// Batch version of cluster_for_energy, pixel count is added once per batch
+void online_clustering_baseline::cluster_for_energies(const OnePixel* pixels, size_t count, std::vector<uint16_t>& done_energies, std::shared_ptr<MTVariable<size_t>> pixel_count, ClusteringParamsOnline& params)
+{
+	size_t pixels_done = 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		close_expired_energy(pixels[i].ToA, done_energies, pixels_done, params);
+		cluster_open(pixels[i], params);
+	}
 
-	while (clstr != open_clusters.end()) {
+	if (pixels_done > 0) pixel_count->Add_To_Value(pixels_done);
+}
 
-		// Send complete clusters
-		if ((pix.ToA - clstr->maxToA) > params.maxClusterDelay)
+// Send complete clusters - only the expired ones are touched
+void online_clustering_baseline::close_expired(int64_t toa, std::vector<CompactClusterType>& done_clusters, const ClusteringParamsOnline& params)
+{
+	uint32_t id = 0;
+
+	while (expiry.pop_expired(forest, toa, params.maxClusterDelay, id))
+	{
+		stale++;
+
+		if (is_filtered(forest.get(id).size, params))
 		{
-			// Filter smaller/bigger clusters
-			if (params.clusterFilterSize > 0)
-			{
-				// filter smaller clusters -> delete them and continues
-				if (params.filterBiggerClusters == false && clstr->pix.size() < static_cast<uint32_t>(params.clusterFilterSize))
-				{
-					clstr = open_clusters.erase(clstr);
-					continue;
-				}
-
-				// filter bigger clusters -> delete them and continue
-				if (params.filterBiggerClusters == true && clstr->pix.size() > static_cast<uint32_t>(params.clusterFilterSize))
-				{
-					clstr = open_clusters.erase(clstr);
-					continue;
-				}
-			}
-
-			// done_clusters (CompactClusterType), gets only clstr->pix part of the cluster
-			// Other part is thrown out and can be later deduced during postprocessing
-			done_clusters->Emplace_Back(std::move(clstr->pix));
-			clstr = open_clusters.erase(clstr);
+			forest.release(id);
 			continue;
 		}
 
-		/* ToA range check */
-		// NOTE: m_abs() or double-if makes maxClusterSpan to be double sided, downwards and upwards
-		if ((pix.ToA - clstr->minToA) > params.maxClusterSpan || (pix.ToA - clstr->minToA) < -params.maxClusterSpan) {   // Cant add to this cluster
-			clstr++;
-			continue;
-		}
+		// done_clusters (CompactClusterType), gets only pixels of the cluster
+		// Other part is thrown out and can be later deduced during postprocessing
+		done_clusters.emplace_back(forest.take_pixels(id));
+	}
+}
 
-		/* Decide if its worth to go through this cluster */
-		/* IS TOO FAR UNDER || IS TOO FAR UP */
-		if (pix.y < (clstr->yMin - 1) || pix.y >(clstr->yMax + 1)) {
-			clstr++;
-			continue;
-		}
-		if (pix.x < (clstr->xMin - 1) || pix.x >(clstr->xMax + 1)) {
-			clstr++;
+// Close old clusters and send only their energy, pixels of sent clusters are added to pixels_done
+void online_clustering_baseline::close_expired_energy(int64_t toa, std::vector<uint16_t>& done_energies, size_t& pixels_done, const ClusteringParamsOnline& params)
+{
+	uint32_t id = 0;
+
+	// NOTE: This is working properly, tested!
+	while (expiry.pop_expired(forest, toa, params.maxClusterDelay, id))
+	{
+		stale++;
+
+		if (is_filtered(forest.get(id).size, params))
+		{
+			forest.release(id);
 			continue;
 		}
 
-		for (const auto& pixs : clstr->pix) {  // Cycle through Pixels of Cluster
-			//for (auto& pixs : reverse(*clstr)) {  // Cycle through Pixels of Cluster
-
-			relX = ((pix.x) == (pixs.x + 1)) || ((pix.x) == (pixs.x - 1)) || ((pix.x) == (pixs.x));    // is (X + 1 == my_X) OR (X - 1 == my_X)
-			relY = ((pix.y) == (pixs.y + 1)) || ((pix.y) == (pixs.y - 1)) || ((pix.y) == (pixs.y));    // is (Y + 1 == my_Y) OR (Y - 1 == my_Y)
-			rel = relX && relY;       // Is related in both X AND Y
-
-			if (rel)    // If Neighbor, add to cluster
-			{
-				if (prevAdded)  // Join clusters
-				{
-					// Join current Cluster into LastAddedTo cluster and Erase the current one
-					open_clusters[lastAddCluster].pix.insert(open_clusters[lastAddCluster].pix.end(), clstr->pix.begin(), clstr->pix.end());
-
-					/* Join min max values of clusters */
-					if (clstr->xMax > open_clusters[lastAddCluster].xMax) open_clusters[lastAddCluster].xMax = clstr->xMax;
-					if (clstr->xMin < open_clusters[lastAddCluster].xMin) open_clusters[lastAddCluster].xMin = clstr->xMin;
-					if (clstr->yMax > open_clusters[lastAddCluster].yMax) open_clusters[lastAddCluster].yMax = clstr->yMax;
-					if (clstr->yMin < open_clusters[lastAddCluster].yMin) open_clusters[lastAddCluster].yMin = clstr->yMin;
-					if (clstr->minToA < open_clusters[lastAddCluster].minToA) open_clusters[lastAddCluster].minToA = clstr->minToA; // Merge ToA min
-					if (clstr->maxToA > open_clusters[lastAddCluster].maxToA) open_clusters[lastAddCluster].maxToA = clstr->maxToA; // Merge ToA max
-
-					clstr = open_clusters.erase(clstr);       // Erase the current Cluster
-				}
-				else            // Simply Add Pixel
-				{
-					/* Update Min Max coord values */
-					if (pix.x > clstr->xMax) clstr->xMax = pix.x;
-					else if (pix.x < clstr->xMin) clstr->xMin = pix.x;
-					if (pix.y > clstr->yMax) clstr->yMax = pix.y;
-					else if (pix.y < clstr->yMin) clstr->yMin = pix.y;
-					if (clstr->minToA > pix.ToA) clstr->minToA = pix.ToA; // Save ToA min
-					if (clstr->maxToA < pix.ToA) clstr->maxToA = pix.ToA; // Save ToA max
-
-					OnePixel newPixel = OnePixel{ pix.x, pix.y, pix.ToT, pix.ToA };
-					clstr->pix.emplace_back(std::move(newPixel));
-					lastAddCluster = clstr - open_clusters.begin();
-					prevAdded = true;
-					clstr++;
-				}
-
-				break;  // Pixel was added to cluster => try NEXT cluster
-			}
+		uint16_t energy = 0;
+		forest.any_pixel(id, [&energy](const OnePixel& elem) {
+			energy += elem.ToT;
+			return false;
+		});
+
+		pixels_done += forest.get(id).size;
+
+		// Emplace a new energy
+		done_energies.emplace_back(energy);
+		forest.release(id);
+	}
+}
+
+// Add pixel into open clusters - only clusters whose bounding box contains the pixel are checked
+void online_clustering_baseline::cluster_open(const OnePixel& pix, const ClusteringParamsOnline& params)
+{
+	open_clusters.candidates(pix.x, pix.y, candidates);
+
+	for (uint32_t idx : candidates)
+	{
+		if (forest.is_open_root(open_clusters.id(idx), open_clusters.generation(idx)) == false)	// Closed by expiry
+		{
+			open_clusters.kill(idx);
+			continue;
 		}
 
-		if (rel == false)
-			clstr++;
+		join_pixel(pix, idx, params);
 	}
 
 	if (prevAdded == false)  // Pixel doesnt match to any Cluster - Place new cluster
 	{
-		ClusterType cluster = ClusterType{ PixelCluster{ OnePixel {(uint16_t)pix.x, (uint16_t)pix.y, pix.ToT, pix.ToA} },
-			pix.ToA, pix.ToA, (uint16_t)pix.x, (uint16_t)pix.x, (uint16_t)pix.y, (uint16_t)pix.y };
-		open_clusters.emplace_back(std::move(cluster));    // Add new cluster
+		const uint32_t id = forest.make_cluster(pix);    // Add new cluster
+		open_clusters.push(id, forest.get(id));
+		expiry.push(forest, id);
 	}
 
-	return;
+	prevAdded = false;
+
+	// Drop closed and joined entries once they make half of the list
+	if (stale > cluster_boxes::LANES && (stale * 2) > open_clusters.size())
+	{
+		open_clusters.compact(forest);
+		stale = 0;
+	}
 }
 
-// Actually slower than normal clustering, energy is postprocess of cluster
-void online_clustering_baseline::cluster_for_energy(OnePixel&& pix, std::shared_ptr<MTVector<uint16_t>>& done_energies, std::shared_ptr<MTVariable<size_t>> pixel_count, ClusteringParamsOnline& params)
+// Filter smaller/bigger clusters -> they are deleted when closing
+bool online_clustering_baseline::is_filtered(uint32_t size, const ClusteringParamsOnline& params)
 {
-	// Loop variables
-	bool prevAdded = false;
-	bool rel{}, relX, relY = false;
-	int lastAddCluster = 0;
-	auto clstr = open_clusters.begin();
+	if (params.clusterFilterSize > 0)
+	{
+		// filter smaller clusters
+		if (params.filterBiggerClusters == false && size < static_cast<uint32_t>(params.clusterFilterSize))
+			return true;
+
+		// filter bigger clusters
+		if (params.filterBiggerClusters == true && size > static_cast<uint32_t>(params.clusterFilterSize))
+			return true;
+	}
 
-	while (clstr != open_clusters.end()) {
+	return false;
+}
 
-		// NOTE: This is working properly, tested!
-		if ((pix.ToA - clstr->maxToA) > params.maxClusterDelay) // Close Old cluster
-		{
-			// Filter smaller/bigger clusters
-			if (params.clusterFilterSize > 0)
-			{
-				// filter smaller clusters -> delete them and continues
-				if (params.filterBiggerClusters == false && clstr->pix.size() < static_cast<uint32_t>(params.clusterFilterSize))
-				{
-					clstr = open_clusters.erase(clstr);
-					continue;
-				}
-
-				// filter bigger clusters -> delete them and continue
-				if (params.filterBiggerClusters == true && clstr->pix.size() > static_cast<uint32_t>(params.clusterFilterSize))
-				{
-					clstr = open_clusters.erase(clstr);
-					continue;
-				}
-			}
-
-			uint16_t energy = 0;
-			for (auto &elem : clstr->pix)
-			{
-				energy += elem.ToT;
-			}
-
-			// count pixels from cluster -> very important for PC application
-			pixel_count->Add_To_Value(clstr->pix.size());
-
-			// Emplace a new energy
-			done_energies->Emplace_Back(std::move(energy));
-			clstr = open_clusters.erase(clstr);
-			continue;
-		}
+// Try to add pixel into open cluster at idx of open_clusters, or join the cluster into the one pixel was added to before
+void online_clustering_baseline::join_pixel(const OnePixel& pix, uint32_t idx, const ClusteringParamsOnline& params)
+{
+	const uint32_t id = open_clusters.id(idx);
 
-		/* ToA range check */
-		// NOTE: m_abs() or double-if makes maxClusterSpan to be double sided, downwards and upwards
-		if ((pix.ToA - clstr->minToA) > params.maxClusterSpan || (pix.ToA - clstr->minToA) < -params.maxClusterSpan) {   // Cant add to this cluster
-			clstr++;
-			continue;
-		}
+	/* ToA range check */
+	// NOTE: m_abs() or double-if makes maxClusterSpan to be double sided, downwards and upwards
+	if ((pix.ToA - open_clusters.min_toa(idx)) > params.maxClusterSpan || (pix.ToA - open_clusters.min_toa(idx)) < -params.maxClusterSpan) {   // Cant add to this cluster
+		return;
+	}
 
-		/* Decide if its worth to go through this cluster */
-		/* IS TOO FAR UNDER || IS TOO FAR UP */
-		if (pix.y < (clstr->yMin - 1) || pix.y >(clstr->yMax + 1)) {
-			clstr++;
-			continue;
-		}
-		if (pix.x < (clstr->xMin - 1) || pix.x >(clstr->xMax + 1)) {
-			clstr++;
-			continue;
-		}
+	/* Bounding box was already checked by candidates() */
 
-		for (const auto& pixs : clstr->pix) {  // Cycle through Pixels of Cluster
-			//for (auto& pixs : reverse(*clstr)) {  // Cycle through Pixels of Cluster
-
-			relX = ((pix.x) == (pixs.x + 1)) || ((pix.x) == (pixs.x - 1)) || ((pix.x) == (pixs.x));    // is (X + 1 == my_X) OR (X - 1 == my_X)
-			relY = ((pix.y) == (pixs.y + 1)) || ((pix.y) == (pixs.y - 1)) || ((pix.y) == (pixs.y));    // is (Y + 1 == my_Y) OR (Y - 1 == my_Y)
-			rel = relX && relY;       // Is related in both X AND Y
-
-			if (rel)    // If Neighbor, add to cluster
-			{
-				if (prevAdded)  // Join clusters
-				{
-					// Join current Cluster into LastAddedTo cluster and Erase the current one
-					open_clusters[lastAddCluster].pix.insert(open_clusters[lastAddCluster].pix.end(), clstr->pix.begin(), clstr->pix.end());
-
-					/* Join min max values of clusters */
-					if (clstr->xMax > open_clusters[lastAddCluster].xMax) open_clusters[lastAddCluster].xMax = clstr->xMax;
-					if (clstr->xMin < open_clusters[lastAddCluster].xMin) open_clusters[lastAddCluster].xMin = clstr->xMin;
-					if (clstr->yMax > open_clusters[lastAddCluster].yMax) open_clusters[lastAddCluster].yMax = clstr->yMax;
-					if (clstr->yMin < open_clusters[lastAddCluster].yMin) open_clusters[lastAddCluster].yMin = clstr->yMin;
-					if (clstr->minToA < open_clusters[lastAddCluster].minToA) open_clusters[lastAddCluster].minToA = clstr->minToA; // Merge ToA min
-					if (clstr->maxToA > open_clusters[lastAddCluster].maxToA) open_clusters[lastAddCluster].maxToA = clstr->maxToA; // Merge ToA max
-
-					clstr = open_clusters.erase(clstr);       // Erase the current Cluster
-				}
-				else            // Simply Add Pixel
-				{
-					/* Update Min Max coord values */
-					if (pix.x > clstr->xMax) clstr->xMax = pix.x;
-					else if (pix.x < clstr->xMin) clstr->xMin = pix.x;
-					if (pix.y > clstr->yMax) clstr->yMax = pix.y;
-					else if (pix.y < clstr->yMin) clstr->yMin = pix.y;
-					if (clstr->minToA > pix.ToA) clstr->minToA = pix.ToA; // Save ToA min
-					if (clstr->maxToA < pix.ToA) clstr->maxToA = pix.ToA; // Save ToA max
-
-					OnePixel newPixel = OnePixel{ pix.x, pix.y, pix.ToT, pix.ToA };
-					clstr->pix.emplace_back(std::move(newPixel));
-					lastAddCluster = clstr - open_clusters.begin();
-					prevAdded = true;
-					clstr++;
-				}
-
-				break;  // Pixel was added to cluster => try NEXT cluster
-			}
-		}
+	// Cycle through Pixels of Cluster
+	bool rel = forest.any_pixel(id, [&pix](const OnePixel& pixs) {
+		bool relX = ((pix.x) == (pixs.x + 1)) || ((pix.x) == (pixs.x - 1)) || ((pix.x) == (pixs.x));    // is (X + 1 == my_X) OR (X - 1 == my_X)
+		bool relY = ((pix.y) == (pixs.y + 1)) || ((pix.y) == (pixs.y - 1)) || ((pix.y) == (pixs.y));    // is (Y + 1 == my_Y) OR (Y - 1 == my_Y)
+		return relX && relY;       // Is related in both X AND Y
+	});
 
-		if (rel == false)
-			clstr++;
-	}
+	if (rel == false) return;
 
-	if (prevAdded == false)  // Pixel doesnt match to any Cluster - Place new cluster
+	if (prevAdded)  // Join clusters
 	{
-		ClusterType cluster = ClusterType{ PixelCluster{ OnePixel {(uint16_t)pix.x, (uint16_t)pix.y, pix.ToT, pix.ToA} },
-			pix.ToA, pix.ToA, (uint16_t)pix.x, (uint16_t)pix.x, (uint16_t)pix.y, (uint16_t)pix.y };
-		open_clusters.emplace_back(std::move(cluster));    // Add new cluster
+		// Join current Cluster into LastAddedTo cluster, current one is dropped from open clusters
+		const uint32_t root = forest.unite(open_clusters.id(lastAddCluster), id);
+		open_clusters.set(lastAddCluster, root, forest.get(root));
+		open_clusters.kill(idx);
+		stale++;
+		return;
 	}
 
-	return;
+	// Simply Add Pixel
+	forest.add_pixel(id, pix);
+	open_clusters.set(idx, id, forest.get(id));
+	lastAddCluster = idx;
+	prevAdded = true;
 }
@@ -9,6 +9,8 @@
 
 #include <clustering_base.h>
 #include "MTQueue.h"
+#include "cluster_forest.h"
+#include "cluster_boxes.h"
 #include <memory>
 
 /*
@@ -19,28 +21,72 @@ class online_clustering_baseline : public clustering_base, public cluster_defini
 {
 public:
 	// Note: Pass shared_ptr by reference because we dont want to take ownership of the ptr
-	void cluster_pixel(OnePixel&& pix, std::shared_ptr<MTVector<CompactClusterType>>& done_clusters, ClusteringParamsOnline& params);
-	void cluster_for_energy(OnePixel&& pix, std::shared_ptr<MTVector<uint16_t>>& done_energies, std::shared_ptr<MTVariable<size_t>> pixel_count, ClusteringParamsOnline& params);
+	// Done clusters (energies) are appended to done_clusters (done_energies) - private buffer of the calling thread
+	void cluster_pixel(OnePixel&& pix, std::vector<CompactClusterType>& done_clusters, ClusteringParamsOnline& params);
+	void cluster_for_energy(OnePixel&& pix, std::vector<uint16_t>& done_energies, std::shared_ptr<MTVariable<size_t>> pixel_count, ClusteringParamsOnline& params);
+
+	// Batch versions - whole block of pixels (in time order) at once
+	void cluster_pixels(const OnePixel* pixels, size_t count, std::vector<CompactClusterType>& done_clusters, ClusteringParamsOnline& params);
+	void cluster_for_energies(const OnePixel* pixels, size_t count, std::vector<uint16_t>& done_energies, std::shared_ptr<MTVariable<size_t>> pixel_count, ClusteringParamsOnline& params);
+
+	// Pixel at toa was clustered elsewhere - clusters expired by it are closed as in cluster_pixels, it is not added
+	void expire(int64_t toa, std::vector<CompactClusterType>& done_clusters, ClusteringParamsOnline& params)
+	{
+		close_expired(toa, done_clusters, params);
+	}
 
 	// Note: Inaccurate -> this emplaces open_clusters right into done_clusters, although they are not eligible to be placed in there
-	void get_rest_of_clusters(std::shared_ptr<MTVector<CompactClusterType>>& done_clusters)
+	void get_rest_of_clusters(std::vector<CompactClusterType>& done_clusters)
 	{
 		// Emplace clusters one by one
-		for (auto& cluster : open_clusters)
+		for (size_t i = 0; i < open_clusters.size(); i++)
+		{
+			if (open_clusters.is_killed(i) == false && forest.is_open_root(open_clusters.id(i), open_clusters.generation(i)))
+				done_clusters.emplace_back(forest.pixels(open_clusters.id(i)));
+		}
+	}
+
+	// Move all open clusters (not filtered) into out and start with no open cluster, pixel storage is kept for next use
+	void take_open_clusters(std::vector<CompactClusterType>& out)
+	{
+		for (size_t i = 0; i < open_clusters.size(); i++)
 		{
-			done_clusters->Emplace_Back(cluster.pix);
+			if (open_clusters.is_killed(i) == false && forest.is_open_root(open_clusters.id(i), open_clusters.generation(i)))
+				out.emplace_back(forest.take_pixels(open_clusters.id(i)));
 		}
+
+		open_clusters.compact(forest);
+		expiry.clear();
+		stale = 0;
 	}
 
 	// Delete contents and free the memory
 	void reset_open_clusters()
 	{
 		open_clusters.clear();
-		open_clusters.shrink_to_fit();
+		candidates.clear();
+		candidates.shrink_to_fit();
+		stale = 0;
+		forest.clear();
+		expiry.clear();
 	}
 
 private:
-	Clusters open_clusters;
+	cluster_forest<OnePixel> forest;		// Storage of open clusters
+	cluster_boxes open_clusters;			// Roots and bounding boxes of open clusters in order of creation
+	cluster_expiry<OnePixel> expiry;		// Open clusters ordered by maxToA
+	std::vector<uint32_t> candidates;		// Entries of open_clusters whose box contains the pixel
+	size_t stale = 0;						// Entries of open_clusters closed or joined since last compaction
+
+	// Loop variables
+	bool prevAdded = false;
+	size_t lastAddCluster = 0;
+
+	bool is_filtered(uint32_t size, const ClusteringParamsOnline& params);
+	void join_pixel(const OnePixel& pix, uint32_t idx, const ClusteringParamsOnline& params);
+	void cluster_open(const OnePixel& pix, const ClusteringParamsOnline& params);
+	void close_expired(int64_t toa, std::vector<CompactClusterType>& done_clusters, const ClusteringParamsOnline& params);
+	void close_expired_energy(int64_t toa, std::vector<uint16_t>& done_energies, size_t& pixels_done, const ClusteringParamsOnline& params);
 };
 
 #endif /* PLUGIN_CLUSTERING_ONLINE_CLUSTERING_BASELINE_H_ */
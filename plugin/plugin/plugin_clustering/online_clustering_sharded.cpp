@@ -0,0 +1,526 @@
+/**
+ * @online_clustering_sharded.cpp
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+#include <online_clustering_sharded.h>
+#include <algorithm>
+#include <limits>
+
+const size_t online_clustering_sharded::SLICE_PIXELS;
+const int64_t online_clustering_sharded::SLICE_DELAYS;
+const size_t online_clustering_sharded::SLICE_MAX_PIXELS;
+const size_t online_clustering_sharded::SLICES_PER_THREAD;
+const int online_clustering_sharded::SLICE_IDLE_MS;
+
+namespace
+{
+	void toa_range(const CompactClusterType& cluster, int64_t& minToA, int64_t& maxToA)
+	{
+		minToA = cluster.pix.front().ToA;
+		maxToA = cluster.pix.front().ToA;
+		for (const OnePixel& pix : cluster.pix)
+		{
+			if (pix.ToA < minToA) minToA = pix.ToA;
+			if (pix.ToA > maxToA) maxToA = pix.ToA;
+		}
+	}
+}
+
+void online_clustering_sharded::start(const ClusteringParamsOnline& par)
+{
+	stop();
+
+	params = par;
+	unfiltered = par;
+	unfiltered.clusterFilterSize = 0;
+
+	const size_t threads = (params.threads > 1) ? static_cast<size_t>(params.threads) : 1;
+	max_in_flight = threads * SLICES_PER_THREAD;
+	filling = new_slice();
+
+	for (size_t i = 0; i < threads; i++)
+	{
+		workers.emplace_back(&online_clustering_sharded::worker, this);
+	}
+}
+
+void online_clustering_sharded::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		stopping = true;
+	}
+	work.notify_all();
+
+	for (std::thread& thread : workers)
+	{
+		if (thread.joinable()) thread.join();
+	}
+	workers.clear();
+
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		jobs.clear();
+		stopping = false;
+	}
+
+	// Free the memory
+	filling.reset();
+	in_flight.clear();
+	spare.clear();
+	spare.shrink_to_fit();
+	next_seq = 0;
+	newest_ToA = 0;
+	carry.clear();
+	carry.shrink_to_fit();
+	carry_seq.clear();
+	carry_seq.shrink_to_fit();
+	ranges.clear();
+	ranges.shrink_to_fit();
+	near_stitched.clear();
+	near_stitched.shrink_to_fit();
+	by_minToA.clear();
+	by_minToA.shrink_to_fit();
+	stitched.clear();
+	stitched.shrink_to_fit();
+	pixel_stitched.clear();
+	pixel_stitched.shrink_to_fit();
+	ticks.clear();
+	ticks.shrink_to_fit();
+	stitch_order.clear();
+	stitch_order.shrink_to_fit();
+	stitch_pixels.clear();
+	stitch_pixels.shrink_to_fit();
+	settled.clear();
+	settled.shrink_to_fit();
+	settled_seq.clear();
+	settled_seq.shrink_to_fit();
+	settled_closed.clear();
+	settled_closed.shrink_to_fit();
+	final_clusters.clear();
+	final_clusters.shrink_to_fit();
+	stitcher.reset_open_clusters();
+}
+
+void online_clustering_sharded::cluster_pixels(const OnePixel* pixels, size_t count, std::vector<CompactClusterType>& done)
+{
+	const int64_t slice_span = SLICE_DELAYS * params.maxClusterDelay;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		slice& sl = *filling;
+		const OnePixel& pix = pixels[i];
+
+		if (sl.pixels.empty())
+		{
+			sl.first_seq = next_seq;
+			sl.started = std::chrono::steady_clock::now();
+			sl.minToA = pix.ToA;
+			sl.maxToA = pix.ToA;
+		}
+		else
+		{
+			if (pix.ToA < sl.minToA) sl.minToA = pix.ToA;
+			if (pix.ToA > sl.maxToA) sl.maxToA = pix.ToA;
+		}
+		if (next_seq == 0 || pix.ToA > newest_ToA) newest_ToA = pix.ToA;
+		sl.pixels.push_back(pix);
+		next_seq++;
+
+		if (sl.pixels.size() >= SLICE_PIXELS && ((sl.maxToA - sl.minToA) > slice_span || sl.pixels.size() >= SLICE_MAX_PIXELS))
+		{
+			cut();
+		}
+	}
+
+	collect(false, done);
+}
+
+void online_clustering_sharded::idle(std::vector<CompactClusterType>& done)
+{
+	// Slice is cut by its age, not on every empty poll - tiny slices would cost more stitching than they save
+	if (filling->pixels.empty() == false &&
+		std::chrono::steady_clock::now() - filling->started >= std::chrono::milliseconds(SLICE_IDLE_MS))
+	{
+		cut();
+	}
+	collect(false, done);
+
+	// Last slice waits for the next one only with clusters which can still grow - others are closed, as one thread
+	// closes them once its time moves past. Pixels of filling slice could still join them
+	if (in_flight.size() != 1 || filling->pixels.empty() == false) return;
+
+	slice& sl = *in_flight.front();
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		if (sl.done == false) return;
+	}
+
+	close_slice(sl, newest_ToA, done);
+
+	spare.push_back(std::move(in_flight.front()));
+	in_flight.pop_front();
+}
+
+void online_clustering_sharded::finish(std::vector<CompactClusterType>& done)
+{
+	cut();
+	collect(true, done);
+
+	// Last slice could have been closed by idle() - its carried clusters have nothing more to wait for
+	for (CompactClusterType& cluster : carry)
+	{
+		done.emplace_back(std::move(cluster));
+	}
+	carry.clear();
+	carry_seq.clear();
+}
+
+// Hand the filled slice over to workers
+void online_clustering_sharded::cut()
+{
+	if (filling->pixels.empty()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		jobs.push_back(filling.get());
+	}
+	work.notify_one();
+
+	in_flight.push_back(std::move(filling));
+	filling = new_slice();
+}
+
+// Close slices in order. Slice is closed when its worker is done and the next slice is known (or wait_all at the end).
+// Waits for the oldest slice when there are too many in flight, so memory stays bounded when workers cant keep up
+void online_clustering_sharded::collect(bool wait_all, std::vector<CompactClusterType>& done)
+{
+	while (in_flight.empty() == false)
+	{
+		slice& sl = *in_flight.front();
+		const bool last = (in_flight.size() == 1);
+
+		if (last && wait_all == false) return;	// Clusters at its end can still grow in the next slice
+
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			if (sl.done == false)
+			{
+				if (wait_all == false && in_flight.size() <= max_in_flight) return;
+				finished.wait(lock, [&sl] { return sl.done; });
+			}
+		}
+
+		close_slice(sl, last ? std::numeric_limits<int64_t>::max() : in_flight[1]->minToA, done);
+
+		spare.push_back(std::move(in_flight.front()));
+		in_flight.pop_front();
+	}
+}
+
+// Stitch clusters of the slice with carried clusters, carry the ones near next slice and send the rest
+void online_clustering_sharded::close_slice(slice& sl, int64_t next_minToA, std::vector<CompactClusterType>& done)
+{
+	const int64_t delay = params.maxClusterDelay;
+	int64_t minToA = 0;
+	int64_t maxToA = 0;
+
+	settled.clear();
+	settled_seq.clear();
+	settled_closed.clear();
+	stitch_order.clear();
+
+	// Carried pixels go to stitching again, in order of arrival
+	size_t offset = 0;
+	for (const CompactClusterType& cluster : carry)
+	{
+		for (const OnePixel& pix : cluster.pix)
+		{
+			stitch_order.emplace_back(carry_seq[offset++], pix);
+		}
+	}
+	std::sort(stitch_order.begin(), stitch_order.end(), [](const std::pair<uint64_t, OnePixel>& a, const std::pair<uint64_t, OnePixel>& b) {
+		return a.first < b.first;
+	});
+
+	// Restore ToT of the slice pixels. Clusters which could have been joined with carried clusters are clustered again together
+	// with them, the rest is settled - closed by the worker already or open
+	select_stitched(sl);
+	pixel_stitched.assign(sl.pixels.size(), 0);
+	for (size_t i = 0; i < sl.clusters.size(); i++)
+	{
+		CompactClusterType& cluster = sl.clusters[i];
+
+		for (OnePixel& pix : cluster.pix)
+		{
+			const uint32_t idx = static_cast<uint32_t>(pix.ToT);
+			pix.ToT = sl.ToT[idx];
+
+			if (stitched[i])
+				pixel_stitched[idx] = 1;
+			else
+				settled_seq.push_back(sl.first_seq + idx);
+		}
+
+		if (stitched[i]) continue;
+
+		settled.emplace_back(std::move(cluster));
+		settled_closed.push_back(i < sl.closed);
+	}
+
+	if (carry.empty() == false)
+	{
+		// Same order as one thread would get them, tagged by position for restoring. Other pixels of the slice only close
+		// expired clusters, as they would on one thread
+		ticks.clear();
+		for (size_t i = 0; i < sl.pixels.size(); i++)
+		{
+			if (pixel_stitched[i] == 0)
+			{
+				ticks.emplace_back(stitch_order.size(), sl.pixels[i].ToA);
+				continue;
+			}
+
+			OnePixel pix = sl.pixels[i];
+			pix.ToT = sl.ToT[i];
+			stitch_order.emplace_back(sl.first_seq + i, pix);
+		}
+
+		stitch_pixels.clear();
+		for (const std::pair<uint64_t, OnePixel>& tagged : stitch_order)
+		{
+			stitch_pixels.push_back(tagged.second);
+			stitch_pixels.back().ToT = static_cast<int32_t>(stitch_pixels.size() - 1);
+		}
+
+		const size_t first_stitched = settled.size();
+		size_t fed = 0;
+		for (const std::pair<size_t, int64_t>& tick : ticks)
+		{
+			stitcher.cluster_pixels(stitch_pixels.data() + fed, tick.first - fed, settled, unfiltered);
+			stitcher.expire(tick.second, settled, unfiltered);
+			fed = tick.first;
+		}
+		stitcher.cluster_pixels(stitch_pixels.data() + fed, stitch_pixels.size() - fed, settled, unfiltered);
+		settled_closed.resize(settled.size(), 1);
+		stitcher.take_open_clusters(settled);
+		settled_closed.resize(settled.size(), 0);
+
+		for (size_t i = first_stitched; i < settled.size(); i++)
+		{
+			for (OnePixel& pix : settled[i].pix)
+			{
+				const std::pair<uint64_t, OnePixel>& tagged = stitch_order[pix.ToT];
+				settled_seq.push_back(tagged.first);
+				pix.ToT = tagged.second.ToT;
+			}
+		}
+	}
+
+	carry.clear();
+	carry_seq.clear();
+	final_clusters.clear();
+
+	// Open clusters which can still get pixels from the next slice are carried, the rest is final
+	offset = 0;
+	for (size_t i = 0; i < settled.size(); i++)
+	{
+		CompactClusterType& cluster = settled[i];
+		const size_t first = offset;
+		offset += cluster.pix.size();
+		toa_range(cluster, minToA, maxToA);
+
+		if (settled_closed[i] == false && maxToA >= next_minToA - delay)
+		{
+			carry_maxToA = carry.empty() ? maxToA : std::max(carry_maxToA, maxToA);
+			carry_seq.insert(carry_seq.end(), settled_seq.begin() + first, settled_seq.begin() + offset);
+			carry.emplace_back(std::move(cluster));
+			continue;
+		}
+
+		if (is_filtered(cluster.pix.size())) continue;
+
+		final_clusters.emplace_back(minToA, std::move(cluster));
+	}
+
+	std::sort(final_clusters.begin(), final_clusters.end(), [](const std::pair<int64_t, CompactClusterType>& a, const std::pair<int64_t, CompactClusterType>& b) {
+		return a.first < b.first;
+	});
+
+	for (std::pair<int64_t, CompactClusterType>& cluster : final_clusters)
+	{
+		done.emplace_back(std::move(cluster.second));
+	}
+
+	sl.pixels.clear();
+	sl.clusters.clear();
+}
+
+// Mark slice clusters which could be joined with carried clusters - they start within maxClusterDelay after end of the
+// carried ones, or they have a pixel next to a stitched cluster which can still take it (merged cluster can end later
+// than the carried ones, its pixels can also come after theirs within maxClusterSpan)
+void online_clustering_sharded::select_stitched(const slice& sl)
+{
+	const int64_t delay = params.maxClusterDelay;
+	const int64_t later = std::max(params.maxClusterDelay, params.maxClusterSpan);
+
+	stitched.assign(sl.clusters.size(), 0);
+	if (carry.empty()) return;
+
+	ranges.clear();
+	by_minToA.clear();
+	int maxX = 0;
+	int maxY = 0;
+	for (const CompactClusterType& cluster : sl.clusters)
+	{
+		int64_t minToA = 0;
+		int64_t maxToA = 0;
+		toa_range(cluster, minToA, maxToA);
+		by_minToA.push_back(static_cast<uint32_t>(ranges.size()));
+		ranges.emplace_back(minToA, maxToA);
+
+		for (const OnePixel& pix : cluster.pix)
+		{
+			maxX = std::max<int>(maxX, pix.x);
+			maxY = std::max<int>(maxY, pix.y);
+		}
+	}
+	for (const CompactClusterType& cluster : carry)
+	{
+		for (const OnePixel& pix : cluster.pix)
+		{
+			maxX = std::max<int>(maxX, pix.x);
+			maxY = std::max<int>(maxY, pix.y);
+		}
+	}
+
+	std::sort(by_minToA.begin(), by_minToA.end(), [this](uint32_t a, uint32_t b) {
+		return ranges[a].first < ranges[b].first;
+	});
+
+	// Pixels next to stitched ones, border of one pixel around the matrix
+	const size_t width = static_cast<size_t>(maxX) + 3;
+	near_stitched.assign(width * (static_cast<size_t>(maxY) + 3), 0);
+	auto mark = [this, width](const CompactClusterType& cluster) {
+		for (const OnePixel& pix : cluster.pix)
+		{
+			for (size_t y = pix.y; y < static_cast<size_t>(pix.y) + 3; y++)
+			{
+				uint8_t* row = &near_stitched[y * width + pix.x];
+				row[0] = row[1] = row[2] = 1;
+			}
+		}
+	};
+	auto is_near = [this, width](const CompactClusterType& cluster) {
+		for (const OnePixel& pix : cluster.pix)
+		{
+			if (near_stitched[(static_cast<size_t>(pix.y) + 1) * width + pix.x + 1]) return true;
+		}
+		return false;
+	};
+
+	for (const CompactClusterType& cluster : carry)
+	{
+		mark(cluster);
+	}
+
+	// All clusters near the carried ones in time
+	int64_t reach = carry_maxToA;
+	size_t first = 0;
+	while (first < by_minToA.size() && ranges[by_minToA[first]].first <= carry_maxToA + delay)
+	{
+		const uint32_t idx = by_minToA[first++];
+		stitched[idx] = 1;
+		mark(sl.clusters[idx]);
+		reach = std::max(reach, ranges[idx].second);
+	}
+
+	// Later ones only next to a stitched cluster, repeated until nothing is added
+	bool added = true;
+	while (added)
+	{
+		added = false;
+
+		for (size_t i = first; i < by_minToA.size(); i++)
+		{
+			const uint32_t idx = by_minToA[i];
+			if (ranges[idx].first > reach + later) break;
+			if (stitched[idx] || is_near(sl.clusters[idx]) == false) continue;
+
+			stitched[idx] = 1;
+			mark(sl.clusters[idx]);
+			reach = std::max(reach, ranges[idx].second);
+			added = true;
+		}
+	}
+}
+
+// Filter smaller/bigger clusters, same as online_clustering_baseline
+bool online_clustering_sharded::is_filtered(size_t size) const
+{
+	if (params.clusterFilterSize > 0)
+	{
+		// filter smaller clusters
+		if (params.filterBiggerClusters == false && size < static_cast<size_t>(params.clusterFilterSize))
+			return true;
+
+		// filter bigger clusters
+		if (params.filterBiggerClusters == true && size > static_cast<size_t>(params.clusterFilterSize))
+			return true;
+	}
+
+	return false;
+}
+
+std::unique_ptr<online_clustering_sharded::slice> online_clustering_sharded::new_slice()
+{
+	if (spare.empty())
+	{
+		return std::unique_ptr<slice>(new slice());
+	}
+
+	std::unique_ptr<slice> sl = std::move(spare.back());
+	spare.pop_back();
+	sl->done = false;	// Not in jobs, no worker touches it
+	return sl;
+}
+
+// Worker thread - cluster whole slices with own clustering, all clusters of the slice are given back
+void online_clustering_sharded::worker()
+{
+	online_clustering_baseline clustering;
+	ClusteringParamsOnline par = unfiltered;
+
+	while (true)
+	{
+		slice* sl = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			work.wait(lock, [this] { return stopping || jobs.empty() == false; });
+			if (stopping) return;
+
+			sl = jobs.front();
+			jobs.pop_front();
+		}
+
+		// Pixels are tagged by index, clustering does not use ToT
+		sl->ToT.resize(sl->pixels.size());
+		for (size_t i = 0; i < sl->pixels.size(); i++)
+		{
+			sl->ToT[i] = sl->pixels[i].ToT;
+			sl->pixels[i].ToT = static_cast<int32_t>(i);
+		}
+
+		clustering.cluster_pixels(sl->pixels.data(), sl->pixels.size(), sl->clusters, par);
+		sl->closed = sl->clusters.size();
+		clustering.take_open_clusters(sl->clusters);
+
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			sl->done = true;
+		}
+		finished.notify_all();
+	}
+}
@@ -0,0 +1,133 @@
+/**
+ * @online_clustering_sharded.h
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+#ifndef PLUGIN_CLUSTERING_ONLINE_CLUSTERING_SHARDED_H_
+#define PLUGIN_CLUSTERING_ONLINE_CLUSTERING_SHARDED_H_
+
+#include <online_clustering_baseline.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+ * Online clustering on more threads - pixel stream is cut into time slices, slices are clustered in parallel
+ *
+ * Caller thread fills slices and hands them over to worker threads (any free worker takes the next slice).
+ * Worker clusters the whole slice with its own online_clustering_baseline and gives back all clusters of the slice.
+ * Caller takes finished slices back in order and stitches clusters across slice borders:
+ *   - clusters starting within maxClusterDelay after the end of clusters carried from previous slice are clustered
+ *     again together with the carried ones (their pixels in arrival order, as one thread would see them)
+ *   - stitched clusters can grow past the carried ones (maxClusterSpan > maxClusterDelay), so later clusters with
+ *     a pixel next to a stitched one are stitched too, until no more are added
+ *   - other pixels of the slice are given to stitching only as time, so carried clusters expire as on one thread
+ *   - open clusters ending within maxClusterDelay before the start of next slice are carried to the next slice
+ *   - all other clusters are final - filtered by size and sent ordered by minToA (order is kept within slice)
+ * Slice is finished only when the next one was cut, so its clusters wait for more data like open clusters do.
+ * When input stops, the last slice is finished against the newest pixel instead, only clusters near it are carried.
+ * Workers tag pixels by their index in the slice (in ToT, restored on close), so arrival order is known when stitching.
+ */
+class online_clustering_sharded
+{
+public:
+	static const size_t SLICE_PIXELS = 16384;		// Slice is cut with at least this many pixels...
+	static const int64_t SLICE_DELAYS = 4;			// ...spanning at least this many maxClusterDelay
+	static const size_t SLICE_MAX_PIXELS = 262144;	// Slice is cut regardless of its time span
+	static const size_t SLICES_PER_THREAD = 2;		// Slices in flight per worker, caller waits for the oldest one above
+	static const int SLICE_IDLE_MS = 20;			// Idle input cuts the slice once it is this old
+
+	~online_clustering_sharded()
+	{
+		stop();
+	}
+
+	// Start params.threads workers, params are used until stop()
+	void start(const ClusteringParamsOnline& params);
+
+	// Stop workers and delete all slices and carried clusters
+	void stop();
+
+	bool is_running() const
+	{
+		return workers.empty() == false;
+	}
+
+	// Add block of pixels (in time order), final clusters of finished slices are appended to done
+	void cluster_pixels(const OnePixel* pixels, size_t count, std::vector<CompactClusterType>& done);
+
+	// Input has no more pixels for now - cut the slice if it waits too long and close clusters of the last slice
+	// which ended more than maxClusterDelay before the newest pixel, so they are not held back
+	void idle(std::vector<CompactClusterType>& done);
+
+	// End of measurement - wait for all slices and close all clusters
+	void finish(std::vector<CompactClusterType>& done);
+
+private:
+	struct slice
+	{
+		std::vector<OnePixel> pixels;
+		std::vector<CompactClusterType> clusters;	// All clusters of the slice, not filtered, ToT is index in pixels
+		size_t closed = 0;							// First clusters were closed by the worker, the rest is open
+		std::vector<int32_t> ToT;					// Real ToT of the pixels
+		uint64_t first_seq = 0;						// Arrival number of the first pixel
+		std::chrono::steady_clock::time_point started;
+		int64_t minToA = 0;
+		int64_t maxToA = 0;
+		bool done = false;							// Protected by mtx
+	};
+
+	ClusteringParamsOnline params{};
+	ClusteringParamsOnline unfiltered{};		// Params for workers and stitching - size filter only for final clusters
+	size_t max_in_flight = 0;
+
+	// Workers
+	std::vector<std::thread> workers;
+	std::mutex mtx;
+	std::condition_variable work;			// Slice for workers or stop
+	std::condition_variable finished;		// Worker finished a slice
+	std::deque<slice*> jobs;
+	bool stopping = false;
+
+	// Caller side
+	std::unique_ptr<slice> filling;						// Slice being filled
+	std::deque<std::unique_ptr<slice>> in_flight;		// Cut slices in order
+	std::vector<std::unique_ptr<slice>> spare;			// Recycled slices
+	uint64_t next_seq = 0;								// Arrival number of the next pixel
+	int64_t newest_ToA = 0;								// Highest ToA of all pixels
+
+	// Stitching
+	online_clustering_baseline stitcher;
+	std::vector<CompactClusterType> carry;				// Clusters which can still grow in the next slice
+	std::vector<uint64_t> carry_seq;					// Arrival numbers of carried pixels, in order of carry
+	int64_t carry_maxToA = 0;
+	std::vector<std::pair<int64_t, int64_t>> ranges;	// minToA and maxToA of slice clusters
+	std::vector<uint8_t> near_stitched;					// Pixels next to (or in) carried and stitched clusters
+	std::vector<uint8_t> pixel_stitched;				// Slice pixels by index
+	std::vector<std::pair<size_t, int64_t>> ticks;		// ToA of slice pixels not stitched, before which stitched pixel
+	std::vector<uint32_t> by_minToA;					// Slice clusters in order of minToA
+	std::vector<char> stitched;
+	std::vector<std::pair<uint64_t, OnePixel>> stitch_order;
+	std::vector<OnePixel> stitch_pixels;
+	std::vector<CompactClusterType> settled;
+	std::vector<uint64_t> settled_seq;
+	std::vector<uint8_t> settled_closed;				// Closed clusters are final, only open ones are carried
+	std::vector<std::pair<int64_t, CompactClusterType>> final_clusters;
+
+	void worker();
+	void cut();
+	void collect(bool wait_all, std::vector<CompactClusterType>& done);
+	void close_slice(slice& sl, int64_t next_minToA, std::vector<CompactClusterType>& done);
+	void select_stitched(const slice& sl);
+	bool is_filtered(size_t size) const;
+	std::unique_ptr<slice> new_slice();
+};
+
+#endif /* PLUGIN_CLUSTERING_ONLINE_CLUSTERING_SHARDED_H_ */
@@ -0,0 +1,53 @@
+/**
+ * @text_view.h
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+/// <summary>
+/// Read-only view over text of loaded or memory-mapped file - no copy of the data is made.
+/// Mirrors the few std::string members the clustering code uses (find, substr), positions and npos are the same.
+/// </summary>
+struct text_view
+{
+	const char* data;
+	size_t size;
+
+	text_view() : data(nullptr), size(0) {};
+	text_view(const char* data, size_t size) : data(data), size(size) {};
+	text_view(const std::string& str) : data(str.data()), size(str.size()) {};
+
+	bool empty() const { return size == 0; };
+	size_t length() const { return size; };
+	char operator[](size_t pos) const { return data[pos]; };
+
+	/// <summary>
+	/// Position of first c at or after pos, std::string::npos if there is none.
+	/// </summary>
+	size_t find(char c, size_t pos = 0) const
+	{
+		if (pos >= size) return std::string::npos;
+
+		const void* found = std::memchr(data + pos, c, size - pos);
+		if (found == nullptr) return std::string::npos;
+
+		return static_cast<size_t>(static_cast<const char*>(found) - data);
+	}
+
+	/// <summary>
+	/// Copy of part of the text, count is clamped to the end of the view.
+	/// </summary>
+	std::string substr(size_t pos, size_t count = std::string::npos) const
+	{
+		if (pos > size) pos = size;
+		if (count > size - pos) count = size - pos;
+
+		return std::string(data + pos, count);
+	}
+};
@@ -14,7 +14,7 @@
 #include <mutex>
 #include <atomic>
 #include <vector>
-#include <list>
+#include "wakeup.h"
 
 /* Multi threaded queue with sleep while waiting for unlock */
 template<typename T>
@@ -136,6 +136,103 @@ public:
 	}
 };
 
+/* Single producer / single consumer output buffer - whole batches are handed over by swapping buffers
+ *
+ * Producer appends into its private buffer (In()) without any lock and publishes it with Publish(),
+ * consumer collects the published batch with Take(). Nothing is copied, only buffer pointers are exchanged.
+ * There are three buffers: one being filled, one published (or spare) and one held by the consumer.
+ * When the consumer did not take the previous batch yet, producer keeps appending and publishes later.
+ * Buffers keep their capacity, so after warm-up no allocation happens. */
+/* ONLY one writer THREAD and one reader THREAD */
+template <typename T>
+class MTSwapBuffer
+{
+public:
+	MTSwapBuffer()
+		: fill_(&buffers_[0]), taken_(&buffers_[2])
+	{
+		spare_.store(&buffers_[1], std::memory_order_relaxed);
+	};
+
+	MTSwapBuffer(const MTSwapBuffer&) = delete;
+	MTSwapBuffer& operator=(const MTSwapBuffer&) = delete;
+
+	/* Producer: private buffer being filled */
+	std::vector<T>& In()
+	{
+		return *fill_;
+	}
+
+	void Emplace_Back(T&& element)
+	{
+		fill_->emplace_back(std::move(element));
+	}
+
+	/* Producer: hand the filled buffer over. Returns false when there was nothing to publish or consumer
+	 * did not take the previous batch yet (items stay in the private buffer) */
+	bool Publish()
+	{
+		if (fill_->empty()) return false;
+		if (ready_.load(std::memory_order_acquire) != nullptr) return false;
+
+		std::vector<T>* next = spare_.exchange(nullptr, std::memory_order_acquire);
+		if (next == nullptr) return false;	// Consumer is just returning its buffer, publish next time
+
+		ready_.store(fill_, std::memory_order_release);
+		fill_ = next;
+		return true;
+	}
+
+	/* Producer: throw away private and published items and free their memory */
+	void Discard()
+	{
+		fill_->clear();
+		fill_->shrink_to_fit();
+
+		std::vector<T>* batch = ready_.exchange(nullptr, std::memory_order_acquire);
+		if (batch == nullptr) return;
+
+		batch->clear();
+		batch->shrink_to_fit();
+		spare_.store(batch, std::memory_order_release);	// Spare is empty while a batch is published
+	}
+
+	/* Consumer: is there a published batch */
+	bool isReady() const
+	{
+		return ready_.load(std::memory_order_relaxed) != nullptr;
+	}
+
+	/* Consumer: take published batch (empty if there is none), valid until the next Take() or ClearOut() */
+	std::vector<T>& Take()
+	{
+		taken_->clear();
+
+		std::vector<T>* batch = ready_.exchange(nullptr, std::memory_order_acquire);
+		if (batch != nullptr)
+		{
+			spare_.store(taken_, std::memory_order_release);	// Spare is empty while a batch is published
+			taken_ = batch;
+		}
+
+		return *taken_;
+	}
+
+	/* Consumer: throw away published items and free memory of consumer buffer */
+	void ClearOut()
+	{
+		Take().clear();
+		taken_->shrink_to_fit();
+	}
+
+private:
+	std::vector<T> buffers_[3];
+	std::vector<T>* fill_;							// Producer only
+	std::vector<T>* taken_;							// Consumer only
+	std::atomic<std::vector<T>*> ready_{nullptr};	// Published batch
+	std::atomic<std::vector<T>*> spare_{nullptr};	// Empty buffer for producer
+};
+
 /* Spin Lock can be used for locking busy waiting, not wasting time
  * puttin thread to sleep before again checking if locked */
 class SpinLock {
@@ -175,89 +272,212 @@ private:
   SpinLock lock_;
 };
 
-/* Multi threaded queue with in and out buffer - not much waiting for unlock */
-/* ONLY one writer THREAD SAFE */
-template <typename T, size_t buffer_size> class MTQueueBuffered {
+/* Single producer / single consumer queue of pixel blocks - no lock and no allocation per item
+ *
+ * Ring of ring_blocks blocks (std::vector<T> with capacity block_size), blocks keep their capacity and are reused.
+ * Producer fills the block at head and publishes it whole (when full or on Flush), consumer takes blocks at tail
+ * and returns them when done. head and tail are the only shared state, sizes are kept in relaxed counters.
+ * When all blocks are published and not taken yet, producer drops items and counts them in dropped().
+ * Consumer waiting in Wait_Block() is woken by the producer as soon as a block is published,
+ * producer waiting in Wait_Space() is woken by the consumer when a block is released. */
+/* ONLY one writer THREAD and one reader THREAD */
+template <typename T, size_t block_size> class MTQueueBuffered {
 public:
-  MTQueueBuffered(){};
-  ~MTQueueBuffered(){};
-  size_t counter = 0;
-    void Emplace_Back(T &&item) {
-    	/*
-      lock_out_.lock();
-	  listOut_.emplace_back(item);
-	  lock_out_.unlock();
-	  */
-
-      // If lock successful, pushback into listIn_ and push the remaining elements from inputBuf_
-      // Else, emplace into temporary buffer
-      // Note: This is to avoid waiting for lock() - avoids collision with Flush() from other thread
-      //lock_in_.lock();
-      listIn_.emplace_back(std::forward<T &&>(item));
-	  //lock_in_.unlock();
-      counter++;
-
-      // Efectively only emplaces into listOut when both locks are "lucky" to lock - doesnt guarantee immediate emplacement,
-      // but avoids waiting for locking
-      // NOTE: No guarantee how long i will take to emplace
-      if (counter > buffer_size) {
-		// Commit to locking now!
-        lock_out_.lock();
-		//lock_in_.lock();
-		listOut_.splice(listOut_.end(), listIn_);
-		counter = 0;
-		//lock_in_.unlock();
-		lock_out_.unlock();
-      }
-    }
-    T Pop() {
-      lock_out_.lock();
-      auto obj(listOut_.front());
-      listOut_.pop_front();
-      lock_out_.unlock();
-      return obj;
-    }
-    void Flush() {
-    	lock_out_.lock();
-		//lock_in_.lock();
-		listOut_.splice(listOut_.end(), listIn_);
-		counter = 0;
-		//lock_in_.unlock();
-		lock_out_.unlock();
-    }
-    void ClearOut() {
-      lock_out_.lock();
-      //lock_in_.lock();
-      //listIn_.clear();
-      listOut_.clear();
-      lock_out_.unlock();
-      //lock_in_.unlock();
-    }
-    void ClearIn()
-    {
-    	listIn_.clear();
-    }
-    bool isEmpty()
-    {
-    	/*lock_out_.lock();
-    	bool empty = listOut_.empty();
-    	lock_out_.unlock();
-    	return empty;*/
-    	return listOut_.empty();
-    }
-    size_t sizeOut()
-    {
-    	lock_out_.lock();
-		size_t size = listOut_.size();
-		lock_out_.unlock();
-    	return size;
-    }
+	explicit MTQueueBuffered(size_t ring_blocks)
+		: blocks_(ring_blocks)
+	{
+	};
+	~MTQueueBuffered(){};
+
+	/* Producer */
+	void Emplace_Back(T &&item)
+	{
+		if (in_ == nullptr && Next_In() == false)
+		{
+			dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return;
+		}
+
+		in_->emplace_back(std::forward<T &&>(item));
+		if (in_->size() >= block_size) Flush();
+	}
+
+	/* Producer: publish partially filled block */
+	void Flush()
+	{
+		if (in_ == nullptr || in_->empty()) return;
+
+		pushed_.store(pushed_.load(std::memory_order_relaxed) + in_->size(), std::memory_order_relaxed);
+		in_ = nullptr;
+		head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		ready_.notify();
+	}
+
+	/* Producer: throw away items not published yet */
+	void ClearIn()
+	{
+		if (in_ != nullptr) in_->clear();
+	}
+
+	/* Producer: wait (spin, then sleep) up to timeout_ms until at most items are queued. Returns true if they are */
+	bool Wait_Space(size_t items, int timeout_ms)
+	{
+		return space_.wait([this, items] { return sizeOut() <= items; }, timeout_ms);
+	}
+
+	/* Producer: ask consumer to throw away oldest blocks until at most keep items are queued */
+	void Request_Trim(size_t keep)
+	{
+		trim_keep_.store(keep, std::memory_order_relaxed);
+		trim_.store(true, std::memory_order_release);
+	}
+
+	/* Consumer: oldest published block, nullptr if there is none. Stays valid until Release_Block() */
+	std::vector<T>* Front_Block()
+	{
+		if (trim_.load(std::memory_order_acquire)) Trim();
+
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+		if (tail == head_.load(std::memory_order_acquire)) return nullptr;
+
+		return &blocks_[tail % blocks_.size()];
+	}
+
+	/* Consumer: oldest published block, waits (spin, then sleep) up to timeout_ms for it. nullptr if there is none */
+	std::vector<T>* Wait_Block(int timeout_ms)
+	{
+		std::vector<T>* block = Front_Block();
+		if (block != nullptr) return block;
+
+		ready_.wait([this] { return isEmpty() == false; }, timeout_ms);
+		return Front_Block();
+	}
+
+	/* Any thread: wake consumer waiting in Wait_Block (state change, stop) */
+	void Wake()
+	{
+		ready_.signal();
+	}
+
+	/* Consumer: return front block to producer, items not taken by Pop() count as consumed */
+	void Release_Block()
+	{
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+		const size_t rest = blocks_[tail % blocks_.size()].size() - cursor_;
+
+		popped_.store(popped_.load(std::memory_order_relaxed) + rest, std::memory_order_relaxed);
+		cursor_ = 0;
+		tail_.store(tail + 1, std::memory_order_release);
+		space_.notify();
+	}
+
+	/* Consumer: take one item, queue must not be empty */
+	T Pop()
+	{
+		std::vector<T>& block = blocks_[tail_.load(std::memory_order_relaxed) % blocks_.size()];
+		T obj(std::move(block[cursor_++]));
+		popped_.store(popped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+		if (cursor_ == block.size()) Release_Block();
+		return obj;
+	}
+
+	/* Consumer: drop all published blocks and free their memory */
+	void ClearOut()
+	{
+		std::vector<T>* block = nullptr;
+		while ((block = Front_Block()) != nullptr)
+		{
+			popped_.store(popped_.load(std::memory_order_relaxed) + block->size() - cursor_, std::memory_order_relaxed);
+			std::vector<T>().swap(*block);		// Before release, producer owns the block after that
+			cursor_ = 0;
+			tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+		space_.notify();
+	}
+
+	/* Consumer */
+	bool isEmpty()
+	{
+		return tail_.load(std::memory_order_relaxed) == head_.load(std::memory_order_acquire);
+	}
+
+	/* Any thread: published items not consumed yet (approximate while both sides run) */
+	size_t sizeOut()
+	{
+		const size_t popped = popped_.load(std::memory_order_relaxed);
+		const size_t pushed = pushed_.load(std::memory_order_relaxed);
+		return (pushed > popped) ? (pushed - popped) : 0;
+	}
+
+	/* Any thread: published blocks not released yet */
+	size_t blocksOut()
+	{
+		return head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_relaxed);
+	}
+
+	/* Any thread: items dropped because the ring was full */
+	size_t dropped()
+	{
+		return dropped_.load(std::memory_order_relaxed);
+	}
+
+	/* Any thread: items thrown away by Request_Trim() */
+	size_t trimmed()
+	{
+		return trimmed_.load(std::memory_order_relaxed);
+	}
 
 private:
-  std::list<T> listOut_;
-  std::list<T> listIn_;
-  SpinLock lock_out_;
-  SpinLock lock_in_;
+	std::vector<std::vector<T>> blocks_;
+
+	// Producer side
+	std::vector<T>* in_ = nullptr;		// Block being filled, nullptr if not taken yet
+	std::atomic<size_t> head_{0};		// Blocks published
+	std::atomic<size_t> pushed_{0};		// Items published
+	std::atomic<size_t> dropped_{0};
+
+	// Consumer side
+	size_t cursor_ = 0;					// Items of front block taken by Pop()
+	std::atomic<size_t> tail_{0};		// Blocks released
+	std::atomic<size_t> popped_{0};		// Items consumed
+
+	std::atomic<size_t> trimmed_{0};	// Items thrown away on request of producer
+
+	// Shared requests
+	std::atomic<bool> trim_{false};
+	std::atomic<size_t> trim_keep_{0};
+
+	wakeup ready_;						// Consumer sleeps here when there is no block
+	wakeup space_;						// Producer sleeps here when too many items are queued
+
+	/* Consumer: release oldest blocks until at most trim_keep_ items are queued */
+	void Trim()
+	{
+		trim_.store(false, std::memory_order_relaxed);
+		const size_t keep = trim_keep_.load(std::memory_order_relaxed);
+
+		while (sizeOut() > keep && isEmpty() == false)
+		{
+			const size_t tail = tail_.load(std::memory_order_relaxed);
+			const size_t rest = blocks_[tail % blocks_.size()].size() - cursor_;
+
+			trimmed_.store(trimmed_.load(std::memory_order_relaxed) + rest, std::memory_order_relaxed);
+			Release_Block();
+		}
+	}
+
+	/* Producer: take next free block to fill */
+	bool Next_In()
+	{
+		const size_t head = head_.load(std::memory_order_relaxed);
+		if (head - tail_.load(std::memory_order_acquire) >= blocks_.size()) return false;
+
+		in_ = &blocks_[head % blocks_.size()];
+		in_->clear();
+		if (in_->capacity() < block_size) in_->reserve(block_size);
+		return true;
+	}
 };
 
 #endif /* PLUGIN_MAIN_MTQUEUE_H_ */
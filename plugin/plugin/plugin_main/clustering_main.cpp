@@ -11,10 +11,36 @@ void clustering_main::run()
 {
 	running = true;
 	is_finished = false;
+	batches = 0;
+	batch_pixels = 0;
+	batch_busy_us = 0;
 
 	while (running)
 	{
 		state_machine();
+
+		// Measurement ended - clusters still held by sharded clustering are closed and sent first
+		if (flush_requested && in_pixels->isEmpty())
+		{
+			flush_requested = false;
+			flush_sharded();
+			flush_pending = true;
+		}
+
+		publish_outputs();
+
+		if (flush_pending && out_clusters->In().empty() && out_energies->In().empty())
+		{
+			flush_pending = false;
+			flushed = true;
+		}
+
+		// Measurement ended and everything was sent - drop the rest
+		if (clear_requested && in_pixels->isEmpty())
+		{
+			clear_requested = false;
+			clear_and_free_memory();
+		}
 	}
 
 	// Clear and free memory
@@ -25,6 +51,7 @@ void clustering_main::run()
 void clustering_main::stop()
 {
 	running = false;
+	in_pixels->Wake();
 }
 
 void clustering_main::state_machine()
@@ -53,111 +80,153 @@ void clustering_main::state_machine()
 	}
 }
 
-void clustering_main::simply_receive()
+// Next block of pixels from the feeder, waits (spin, then sleep) for it up to WAIT_TIMEOUT_MS. nullptr if there is none
+std::vector<OnePixel>* clustering_main::next_batch()
 {
-	// Variable to determine how many loops there were no data
-	static uint16_t loops_wo_data = 0;
-	static uint16_t loops_timeout = 10;
+	std::vector<OnePixel>* batch = in_pixels->Wait_Block(WAIT_TIMEOUT_MS);
+	if (batch == nullptr) return nullptr;
 
-	// If empty, move to out buffer and return - then, next call to this fun can have at least some pixels
-	if (in_pixels->isEmpty() == true)
-	{
+	flushed = false;
+	flush_pending = false;
+	batch_start = std::chrono::steady_clock::now();
+	return batch;
+}
 
-		// Sleep if still no data incoming
-		loops_wo_data++;
-		if (loops_wo_data > loops_timeout)
-		{
-			//in_pixels->Flush();	// Move from IN to OUT buffer inside pix_input buffered Queue
-			loops_wo_data = 0;
-			std::this_thread::sleep_for(std::chrono::milliseconds(1));
-		}
-		return;
-	}
+// Give the block back to the feeder and count it
+void clustering_main::release_batch(size_t pixels)
+{
+	in_pixels->Release_Block();
 
-	loops_wo_data = 0;
-	out_pixels->Emplace_Back(std::move(in_pixels->Pop()));
+	const auto busy = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - batch_start);
+	batches.store(batches.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	batch_pixels.store(batch_pixels.load(std::memory_order_relaxed) + pixels, std::memory_order_relaxed);
+	batch_busy_us.store(batch_busy_us.load(std::memory_order_relaxed) + static_cast<size_t>(busy.count()), std::memory_order_relaxed);
 }
 
-// Process the pixel and place it in cluster - save to out_clusters
-void clustering_main::cluster_pixel()
+// Hand output over to the main loop - buffers are swapped, nothing is copied. Batches not taken by
+// the main loop yet stay published, new output is kept in private buffers and published next time
+void clustering_main::publish_outputs()
 {
-	static uint16_t loops_wo_data = 0;
-	static uint16_t loops_timeout = 10;
+	bool published = out_clusters->Publish();
+	published |= out_energies->Publish();
+	published |= out_pixels->Publish();
+	published |= out_pixel_counts->Publish();
 
-	// If empty, move to out buffer and return - then, next call to this fun can have at least some pixels
-	if (in_pixels->isEmpty() == true)
-	{
+	if (published) out_ready->post();	// Main loop can send the output
+}
 
-		// Sleep if still no data incoming
-		loops_wo_data++;
-		if (loops_wo_data > loops_timeout)
-		{
-			//in_pixels->Flush();	// Move from IN to OUT buffer inside pix_input buffered Queue
-			loops_wo_data = 0;
-			std::this_thread::sleep_for(std::chrono::milliseconds(1));
-		}
+void clustering_main::simply_receive()
+{
+	std::vector<OnePixel>* batch = next_batch();
+	if (batch == nullptr) return;
+
+	std::vector<OnePixel>& out = out_pixels->In();
+	out.insert(out.end(), batch->begin(), batch->end());
+	release_batch(batch->size());
+}
+
+// Process the block of pixels and place them in clusters - save to out_clusters
+void clustering_main::cluster_pixel()
+{
+	if (params.threads > 1)
+	{
+		cluster_sharded(false);
 		return;
 	}
 
+	std::vector<OnePixel>* batch = next_batch();
+	if (batch == nullptr) return;
 
-	// Do the clustering on the pixel - done clusters are moved to out_clusters
-	loops_wo_data = 0;
-	clustering.cluster_pixel(std::move(in_pixels->Pop()), out_clusters, params);
+	// Do the clustering on the pixels - done clusters are moved to out_clusters
+	clustering.cluster_pixels(batch->data(), batch->size(), out_clusters->In(), params);
+	release_batch(batch->size());
 }
 
 
 void clustering_main::receive_pixel_count()
 {
-	// Variable to determine how many loops there were no data
-	static uint16_t loops_wo_data = 0;
-	static uint16_t loops_timeout = 10;
-	static OnePixel pixel = {0,0,0,0};
+	std::vector<OnePixel>* batch = next_batch();
+	if (batch == nullptr) return;
 
-	// If empty, move to out buffer and return - then, next call to this fun can have at least some pixels
-	if (in_pixels->isEmpty() == true)
+	// Emplace only x and y coord of a pixel
+	std::vector<OnePixelCount>& counts = out_pixel_counts->In();
+	for (const OnePixel& pixel : *batch)
 	{
+		counts.emplace_back(pixel.x, pixel.y);
+	}
 
-		// Sleep if still no data incoming
-		loops_wo_data++;
-		if (loops_wo_data > loops_timeout)
-		{
-			//in_pixels->Flush();	// Move from IN to OUT buffer inside pix_input buffered Queue
-			loops_wo_data = 0;
-			std::this_thread::sleep_for(std::chrono::milliseconds(1));
-		}
+	release_batch(batch->size());
+}
+
+// Process the block of pixels and place them in clusters -> get only the energy - save to out_energies
+void clustering_main::cluster_energy()
+{
+	if (params.threads > 1)
+	{
+		cluster_sharded(true);
 		return;
 	}
 
-	loops_wo_data = 0;
+	std::vector<OnePixel>* batch = next_batch();
+	if (batch == nullptr) return;
 
-	// Emplace only x and y coord of a pixel
-	pixel = in_pixels->Pop();
-	out_pixel_counts->Emplace_Back(OnePixelCount(pixel.x, pixel.y));
+	// Do the clustering on the pixels - done clusters are moved to out_energies
+	clustering.cluster_for_energies(batch->data(), batch->size(), out_energies->In(), pixel_count_for_energy, params);
+	release_batch(batch->size());
 }
 
-// Process the pixel and place it in cluster -> get only the energy - save to out_energies
-void clustering_main::cluster_energy()
+// Clustering on more threads, block is copied into time slice and given back to the feeder right away.
+// Clusters (or their energies) come out once the slice and its neighbour are clustered
+void clustering_main::cluster_sharded(bool energies)
 {
-	static uint16_t loops_wo_data = 0;
-	static uint16_t loops_timeout = 10;
-
-	// If empty, move to out buffer and return - then, next call to this fun can have at least some pixels
-	if (in_pixels->isEmpty() == true)
+	std::vector<OnePixel>* batch = next_batch();
+	if (batch != nullptr)
 	{
+		if (sharded.is_running() == false) sharded.start(params);
 
-		// Sleep if still no data incoming
-		loops_wo_data++;
-		if (loops_wo_data > loops_timeout)
+		const size_t pixels = batch->size();
+		sharded.cluster_pixels(batch->data(), pixels, energies ? sharded_done : out_clusters->In());
+		release_batch(pixels);
+	}
+
+	if (sharded.is_running() == false) return;
+
+	// Feeder has nothing more now - dont hold back the partial slice for long
+	if (in_pixels->isEmpty()) sharded.idle(energies ? sharded_done : out_clusters->In());
+
+	sharded_energies();
+}
+
+// Energies of clusters finished by sharded clustering
+void clustering_main::sharded_energies()
+{
+	if (sharded_done.empty()) return;
+
+	size_t pixels_done = 0;
+	std::vector<uint16_t>& done_energies = out_energies->In();
+	for (const CompactClusterType& cluster : sharded_done)
+	{
+		uint16_t energy = 0;
+		for (const OnePixel& pix : cluster.pix)
 		{
-			//in_pixels->Flush();	// Move from IN to OUT buffer inside pix_input buffered Queue
-			loops_wo_data = 0;
-			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			energy += pix.ToT;
 		}
-		return;
+
+		pixels_done += cluster.pix.size();
+		done_energies.emplace_back(energy);
 	}
 
-	loops_wo_data = 0;
+	// count pixels from cluster -> very important for PC application
+	pixel_count_for_energy->Add_To_Value(pixels_done);
+	sharded_done.clear();
+}
+
+// Close all slices and carried clusters of sharded clustering, they get no more pixels
+void clustering_main::flush_sharded()
+{
+	if (sharded.is_running() == false) return;
 
-	// Do the clustering on the pixel - done clusters are moved to out_energies
-	clustering.cluster_for_energy(std::move(in_pixels->Pop()), out_energies, pixel_count_for_energy, params);
+	const bool energies = (plugin_running == plugins::clustering_energies);
+	sharded.finish(energies ? sharded_done : out_clusters->In());
+	sharded_energies();
 }
@@ -9,22 +9,27 @@
 
 #include <MTQueue.h>
 #include <online_clustering_baseline.h>
+#include <online_clustering_sharded.h>
 #include "plugin_definition.h"
+#include "wakeup.h"
 #include <memory>
 #include <thread>
 #include <unistd.h>
 #include <atomic>
+#include <chrono>
+#include <vector>
 
 class clustering_main : clustering_base
 {
 public:
 	// TODO: Ted to nejak rozdelim na ruzny pluginy a kazdy plugin bude mit svoji classu
 	clustering_main(std::shared_ptr<MTQueueBuffered<OnePixel, FEEDER_BUFF_SIZE>> shared_buf,
-			std::shared_ptr<MTVector<CompactClusterType>> done_cl,
-			std::shared_ptr<MTVector<uint16_t>> done_ene,
-			std::shared_ptr<MTVector<OnePixel>> out_pix,
-			std::shared_ptr<MTVector<OnePixelCount>> out_count,
-			std::shared_ptr<MTVariable<size_t>> out_count_for_energy)
+			std::shared_ptr<MTSwapBuffer<CompactClusterType>> done_cl,
+			std::shared_ptr<MTSwapBuffer<uint16_t>> done_ene,
+			std::shared_ptr<MTSwapBuffer<OnePixel>> out_pix,
+			std::shared_ptr<MTSwapBuffer<OnePixelCount>> out_count,
+			std::shared_ptr<MTVariable<size_t>> out_count_for_energy,
+			std::shared_ptr<wakeup> output_ready)
 	{
 		in_pixels = shared_buf;
 		out_clusters = done_cl;
@@ -32,6 +37,7 @@ public:
 		pixel_count_for_energy = out_count_for_energy;
 		out_pixels = out_pix;
 		out_pixel_counts = out_count;
+		out_ready = output_ready;
 		plugin_running = plugins::idle;
 		running = false;
 
@@ -41,11 +47,13 @@ public:
 		params.outerFilterSize = 0;
 		params.maxClusterSpan = 200;
 		params.maxClusterDelay = 200000;
+		params.threads = 1;
 	}
 
 	void set_plugin(plugins pl)
 	{
 		plugin_running = pl;
+		in_pixels->Wake();	// Switch right away, not after wait timeout
 	}
 
 	plugins get_plugin()
@@ -64,49 +72,93 @@ public:
 	// Note: Inaccurate -> this emplaces open_clusters right into done_clusters, although they are not eligible to be placed in there
 	void get_rest_of_clusters()
 	{
-		clustering.get_rest_of_clusters(out_clusters);
+		if (sharded.is_running())
+		{
+			sharded.finish(out_clusters->In());
+			return;
+		}
+
+		clustering.get_rest_of_clusters(out_clusters->In());
 	}
 
+	// Only from clustering thread (or when it is not running)
 	void clear_and_free_memory()
 	{
 		// Clear and free memory
 		clustering.reset_open_clusters();	// Free the memory of open clusters
-		out_clusters->EraseAll();
-		out_clusters->ShrinkToFit();
-		out_energies->EraseAll();
-		out_energies->ShrinkToFit();
-		out_pixel_counts->EraseAll();
-		out_pixel_counts->ShrinkToFit();
-		out_pixels->EraseAll();
-		out_pixels->ShrinkToFit();
+		sharded.stop();						// Stop its threads, parameters may change
+		out_clusters->Discard();
+		out_energies->Discard();
+		out_pixel_counts->Discard();
+		out_pixels->Discard();
 		in_pixels->ClearOut();
 	}
 
+	// Any thread: clear and free memory in clustering thread as soon as the feeder queue is empty
+	void request_clear()
+	{
+		clear_requested = true;
+		in_pixels->Wake();
+	}
+
+	// Any thread: end of measurement - close clusters held by clustering as soon as the feeder queue is empty
+	void request_flush()
+	{
+		flush_requested = true;
+		in_pixels->Wake();
+	}
+
+	// All clusters of received pixels were published (no pixel came since the flush)
+	bool is_flushed()
+	{
+		return flushed;
+	}
+
 	volatile std::atomic<bool> is_finished;
 
+	// Per-batch counters - blocks taken from the feeder, their pixels and time spent processing them
+	std::atomic<size_t> batches{0};
+	std::atomic<size_t> batch_pixels{0};
+	std::atomic<size_t> batch_busy_us{0};
+
 private:
 	// Plugin classes
 	online_clustering_baseline clustering;	// Performs enhanced bruteforce clustering - best performance for smaller clusters
 	// Note: Quadtree clustering performs better only for bigger clusters - big heavy ions etc.
+	online_clustering_sharded sharded;		// Same clustering on params.threads threads (time slices)
 
 	// Inputs
 	std::shared_ptr<MTQueueBuffered<OnePixel, FEEDER_BUFF_SIZE>> in_pixels;
 
 	// Outputs
-	std::shared_ptr<MTVector<CompactClusterType>> out_clusters;		/* Cluster output */
-	std::shared_ptr<MTVector<uint16_t>> out_energies;			/* Energy output for histogram */
+	// Written only by this thread into private buffers, published by publish_outputs()
+	std::shared_ptr<MTSwapBuffer<CompactClusterType>> out_clusters;		/* Cluster output */
+	std::shared_ptr<MTSwapBuffer<uint16_t>> out_energies;			/* Energy output for histogram */
 	std::shared_ptr<MTVariable<size_t>> pixel_count_for_energy;			// Pixel counter for energies
-	std::shared_ptr<MTVector<OnePixel>> out_pixels;			// Pixel output direct
-	std::shared_ptr<MTVector<OnePixelCount>> out_pixel_counts;	// Pixel count output
+	std::shared_ptr<MTSwapBuffer<OnePixel>> out_pixels;			// Pixel output direct
+	std::shared_ptr<MTSwapBuffer<OnePixelCount>> out_pixel_counts;	// Pixel count output
+	std::shared_ptr<wakeup> out_ready;		// Posted when output was published, main loop waits on it
 	// more...
 
 	// Plugin for state machine
 	volatile plugins plugin_running;
 	volatile std::atomic<bool> running;
+	std::atomic<bool> clear_requested{false};
+	std::atomic<bool> flush_requested{false};
+	std::atomic<bool> flushed{true};
+	bool flush_pending = false;		// Flushed clusters wait in private buffers to be published
 	ClusteringParamsOnline params;
 
+	// Batch variables
+	std::chrono::steady_clock::time_point batch_start;
+	std::vector<CompactClusterType> sharded_done;	// Final clusters from sharded clustering (energy mode)
+
 	void state_machine();
 
+	std::vector<OnePixel>* next_batch();
+	void release_batch(size_t pixels);
+	void publish_outputs();
+
 	void cluster_pixel();
 
 	void simply_receive();
@@ -114,6 +166,10 @@ private:
 	void receive_pixel_count();
 
 	void cluster_energy();
+
+	void cluster_sharded(bool energies);
+	void sharded_energies();
+	void flush_sharded();
 };
 
 #endif /* PLUGIN_MAIN_CLUSTERING_MAIN_H_ */
@@ -0,0 +1,190 @@
+/**
+ * @lan_sender.cpp
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+
+#include "lan_sender.h"
+#include <algorithm>
+#include <climits>
+
+void lan_sender::start()
+{
+	if (t_sender.joinable()) return;
+
+	running = true;
+	auto call_s = [&]() { run(); };
+	t_sender = std::thread(call_s);
+}
+
+void lan_sender::stop()
+{
+	if (t_sender.joinable() == false) return;
+
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		running = false;
+	}
+	cv.notify_one();
+	t_sender.join();
+}
+
+int lan_sender::reconnect()
+{
+	const bool was_running = t_sender.joinable();
+
+	if (was_running)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			running = false;
+
+			// Not sent to the new client - binary headers may be queued, it gets text ones until its config
+			pending.fetch_sub(queue_bytes, std::memory_order_relaxed);
+			recycle(queue);
+			queue_bytes = 0;
+			urgent_queued = false;
+		}
+		cv.notify_one();
+		t_sender.join();	// Batch being sent fails on the dead socket or gives up as stopped
+	}
+
+	int res = network->reconnect_lan();
+
+	if (was_running) start();
+	return res;
+}
+
+void lan_sender::set_batching(size_t bytes, int latency_ms)
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	batch_bytes = bytes;
+	max_latency_ms = latency_ms;
+}
+
+std::string lan_sender::get_buffer()
+{
+	std::lock_guard<std::mutex> lock(mtx);
+	if (pool.empty()) return std::string();
+
+	std::string buffer = std::move(pool.back());
+	pool.pop_back();
+	return buffer;
+}
+
+void lan_sender::post(dataframe_types type, std::string&& payload, bool binary_header, bool urgent)
+{
+	frame f;
+	if (binary_header)
+	{
+		serializer::put_header(f.header, type, payload.size());
+		f.header_length = serializer::BINARY_HEADER_BYTES;
+	}
+	else f.header_length = serializer::put_text_header(f.header, type, payload.size());
+	f.payload = std::move(payload);
+
+	const size_t bytes = f.header_length + f.payload.size();
+	bool notify = false;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		if (queue.empty()) oldest = std::chrono::steady_clock::now();
+
+		queue.emplace_back(std::move(f));
+		queue_bytes += bytes;
+		urgent_queued |= urgent;
+		pending.fetch_add(bytes, std::memory_order_relaxed);
+
+		// Sender waits for the first frame without timeout, then only for the flush conditions
+		notify = (queue.size() == 1) || flush_due();
+	}
+	if (notify) cv.notify_one();
+}
+
+bool lan_sender::flush_due() const
+{
+	if (queue.empty()) return false;
+
+	return urgent_queued || (queue_bytes >= batch_bytes)
+		|| (std::chrono::steady_clock::now() - oldest) >= std::chrono::milliseconds(max_latency_ms);
+}
+
+void lan_sender::run()
+{
+	std::unique_lock<std::mutex> lock(mtx);
+
+	while (true)
+	{
+		// Wait for a full batch, urgent frame or latency of the oldest frame
+		while (running && flush_due() == false)
+		{
+			if (queue.empty()) cv.wait(lock);
+			else cv.wait_until(lock, oldest + std::chrono::milliseconds(max_latency_ms));
+		}
+
+		if (queue.empty()) break;	// Stopped and everything was sent
+
+		batch.swap(queue);
+		size_t bytes = queue_bytes;
+		queue_bytes = 0;
+		urgent_queued = false;
+		lock.unlock();
+
+		if (send_batch() == false) perror("batch not sent\n");
+		pending.fetch_sub(bytes, std::memory_order_relaxed);
+
+		lock.lock();
+		recycle(batch);
+	}
+}
+
+// Payload buffers go back to the pool with their capacity
+void lan_sender::recycle(std::vector<frame>& frames)
+{
+	for (auto& f : frames)
+	{
+		if (pool.size() >= SEND_POOL_BUFFERS) break;
+
+		f.payload.clear();
+		pool.emplace_back(std::move(f.payload));
+	}
+	frames.clear();
+}
+
+// Whole batch goes out as header and payload iovecs, IOV_MAX of them per sendmsg() - all but the last with MSG_MORE
+bool lan_sender::send_batch()
+{
+	iov.clear();
+	for (auto& f : batch)
+	{
+		iov.push_back({f.header, f.header_length});
+		if (f.payload.empty() == false) iov.push_back({&f.payload[0], f.payload.size()});
+	}
+
+	size_t first = 0;
+	while (first < iov.size())
+	{
+		const size_t count = std::min(iov.size() - first, static_cast<size_t>(IOV_MAX));
+		int len = network->send_to_lan_nonblock(&iov[first], count, (first + count) < iov.size());
+		if (len < 0) return false;
+
+		// Skip what was sent, the iovec sent only partly continues where it stopped
+		size_t sent = static_cast<size_t>(len);
+		while (first < iov.size() && sent >= iov[first].iov_len)
+		{
+			sent -= iov[first].iov_len;
+			first++;
+		}
+		if (sent > 0)
+		{
+			iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + sent;
+			iov[first].iov_len -= sent;
+		}
+
+		// Socket full - wait until it takes more, give up only when stopping
+		if (len == 0 && network->wait_lan_writable(WAIT_TIMEOUT_MS) == false && running == false)
+			return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,107 @@
+/**
+ * @lan_sender.h
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+
+#ifndef PLUGIN_MAIN_LAN_SENDER_H_
+#define PLUGIN_MAIN_LAN_SENDER_H_
+
+#include "networking.h"
+#include "plugin_definition.h"
+#include "serializer.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/uio.h>
+
+/* Sender thread of frames to the server (PC)
+ *
+ * Main loop serializes output into frames and queues them with post(), the sender thread writes them to the socket
+ * meanwhile - so the next batch is serialized (and commands are handled) while the previous one is being sent.
+ * Queued frames are sent together when they reach batch_bytes or when the oldest of them waited max_latency_ms.
+ * Urgent frames (messages, acknowledges) are sent right away, together with all frames queued before them.
+ * Socket is written without blocking, when it is full the sender sleeps in poll() - it can be stopped any time.
+ * Header of a frame is kept apart from its payload, a batch goes to the kernel by sendmsg() as header and payload
+ * iovecs - payload is not copied after it was serialized. Payload buffers return to a pool once they were sent.
+ * Socket is used only by the sender thread while it runs - reconnect() stops it before the socket is replaced. */
+/* ONLY one posting THREAD */
+class lan_sender
+{
+public:
+	lan_sender(networking* netw)
+		: network(netw)
+	{
+	};
+
+	~lan_sender()
+	{
+		stop();
+	};
+
+	lan_sender(const lan_sender&) = delete;
+	lan_sender& operator=(const lan_sender&) = delete;
+
+	void start();
+
+	/* Sends what is queued (unless the socket stays full) and joins the thread */
+	void stop();
+
+	/* Connection was lost - stop the sender, drop queued frames (they were made for the old client) and connect
+	 * the socket again. Posting thread only, sender runs again on the new socket. Returns networking::reconnect_lan() */
+	int reconnect();
+
+	/* Flush thresholds, used from the next batch */
+	void set_batching(size_t batch_bytes, int max_latency_ms);
+
+	/* Empty payload buffer - from the pool when there is one, it keeps its capacity */
+	std::string get_buffer();
+
+	/* Queue payload as a frame of type, with binary or text header */
+	void post(dataframe_types type, std::string&& payload, bool binary_header, bool urgent);
+
+	/* Too much is waiting to be sent - main loop leaves the output in clustering until the sender catches up */
+	bool is_full() const
+	{
+		return pending.load(std::memory_order_relaxed) >= SEND_QUEUE_BYTES;
+	}
+
+private:
+	struct frame
+	{
+		char header[serializer::MAX_TEXT_HEADER_BYTES];
+		size_t header_length;
+		std::string payload;
+	};
+
+	void run();
+	bool flush_due() const;		// Under mtx
+	void recycle(std::vector<frame>& frames);	// Under mtx
+	bool send_batch();
+
+	networking* network;
+	std::thread t_sender;
+	std::atomic<bool> running{false};
+
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::vector<frame> queue;			// Posted frames, swapped with batch by the sender (both keep their capacity)
+	size_t queue_bytes = 0;
+	bool urgent_queued = false;
+	std::chrono::steady_clock::time_point oldest;	// Post time of the first queued frame
+	size_t batch_bytes = SEND_BATCH_BYTES;
+	int max_latency_ms = SEND_MAX_LATENCY_MS;
+
+	std::vector<std::string> pool;		// Sent payload buffers
+
+	std::vector<frame> batch;			// Sender thread only
+	std::vector<iovec> iov;
+	std::atomic<size_t> pending{0};		// Bytes queued or being sent
+};
+
+#endif /* PLUGIN_MAIN_LAN_SENDER_H_ */
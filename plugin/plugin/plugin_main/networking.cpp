@@ -31,10 +31,16 @@ networking::~networking()
 
 int networking::connect_detector()
 {
-	// Open fifo/pipe to read
+	// Shared memory ring of the readout process is preferred, fifo/pipe is the fallback
 	fd_pipe_plugin = -1;
 
 	while (fd_pipe_plugin < 0) {
+		if (ring.attach(SHM_RING_PATH)) {
+			printf("\nShared memory ring found....");
+			fflush(stdout);
+			return 0;
+		}
+
 		fd_pipe_plugin = open(FIFO_PATH, O_RDONLY | O_NONBLOCK);
 
 		if (fd_pipe_plugin < 0) {
@@ -57,6 +63,12 @@ int networking::disconnect_detector()
 
 	// auto remaining = read(fd_pipe_plugin, &buf, 6); for later
 
+	if (ring.is_open())
+	{
+		ring.close();
+		return 0;
+	}
+
 	while (timeout < c_timeout)
 	{
 		int result = close(fd_pipe_plugin);
@@ -89,6 +101,12 @@ int networking::flush_detector_data(int ms_timeout)
 	static std::chrono::time_point<std::chrono::steady_clock> last_time = std::chrono::steady_clock::now();
 	char buffer[264];
 
+	if (ring.is_open())
+	{
+		ring.consume_all();
+		return 0;
+	}
+
 	last_time = std::chrono::steady_clock::now();
 	while(read(fd_pipe_plugin, buffer, 264) > 0)
 	{
@@ -236,6 +254,30 @@ int networking::send_to_lan(const char* message, size_t length)
 	return static_cast<int>(done);
 }
 
+// Gathers iov in one call without blocking, more tells the kernel that next data follow right away (fills whole segments)
+int networking::send_to_lan_nonblock(const struct iovec* iov, size_t count, bool more)
+{
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = const_cast<struct iovec*>(iov);
+	msg.msg_iovlen = count;
+
+	int flags = MSG_DONTWAIT | MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+	ssize_t len = sendmsg(sock, &msg, flags);
+
+	if (len >= 0) return static_cast<int>(len);
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+
+	return -1;
+}
+
+// Returns false on timeout
+bool networking::wait_lan_writable(int ms_timeout)
+{
+	pollfd pfd = {sock, POLLOUT, 0};
+	return poll(&pfd, 1, ms_timeout) > 0;
+}
+
 std::string networking::read_from_lan()
 {
 	std::string message = "";
@@ -312,11 +354,7 @@ int networking::recv_data_packet(std::string& data)
 	{
 		len = recv_data(data, 2);
 		if (len == -1) return -1;
-		else if (len == 0)	// Client disconnected when len == 0
-		{
-			disconnect_lan();
-			return -1;
-		}
+		else if (len == 0) return -1;	// Client disconnected when len == 0, socket is replaced by reconnect_lan()
 		done += len;
 
 		if (data.find(';') != std::string::npos) break;	// break if end of header ';' was found
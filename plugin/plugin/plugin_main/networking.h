@@ -9,6 +9,8 @@
 #define PLUGIN_MAIN_NETWORKING_H_
 
 #define FIFO_PATH "/tmp/myfifo"
+#define SHM_RING_PATH "/dev/shm/katherine_ring"	// Used instead of fifo when readout process created it
+#define SHM_RING_SIZE (6 * 1024 * 1024)			// Default ring size of producers (1M words)
 #define MAX_BUF_SIZE 128
 
 #include <inttypes.h>
@@ -23,10 +25,14 @@
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <errno.h>
 #include <string.h>
 #include <string>
 #include <thread>
 #include <chrono>
+#include <shm_ring.h>
 
 class networking
 {
@@ -36,6 +42,7 @@ public:
 
 	/* Detector networking - incoming data hits */
 	int fd_pipe_plugin = -1;	// File descriptor for pipe
+	shm_ring ring;				// Shared memory ring, open when it is used instead of the pipe
 	int connect_detector();
 	int disconnect_detector();
 	int flush_detector_data(int ms_timeout);
@@ -46,6 +53,8 @@ public:
 	int disconnect_lan();
 	int send_to_lan(const std::string& message);
 	int send_to_lan(const char* message, size_t length);
+	int send_to_lan_nonblock(const struct iovec* iov, size_t count, bool more);	// Bytes sent (0 when socket is full) or -1
+	bool wait_lan_writable(int ms_timeout);
 	std::string read_from_lan();	// Blocking read from LAN until everything read
 	int recv_data(std::string& data, int length);
 	int recv_data_packet(std::string& data);
@@ -13,6 +13,8 @@ void pixel_feeder::run()
 	messages = 0;
 	real_pixels = 0;
 	reads = 0;
+	carry = 0;
+	readout = katherine_readout::state();
 	printf("Feeder start\n");
 	fflush(stdout);
 
@@ -27,109 +29,197 @@ void pixel_feeder::stop()
 	printf("Feeder stop\n");
 	fflush(stdout);
 	running = false;
+	stop_event.signal();	// Wake the feeder waiting for the pipe, ring wait ends within WAIT_TIMEOUT_MS
 }
 
 void pixel_feeder::pix_readout()
 {
-	// Variable to determine how many loops there were no data
-	static uint16_t loops_wo_data = 0;
-	static uint16_t loops_timeout = 10;
-	static OnePixel pixel_tmp_direct = {0,0,0,0};
-	uint64_t buf = 0;
+	if (apply_backpressure() == false) return;
 
-	int num = read(pipe->fd_pipe_plugin, &buf, 6);
+	if (pipe->ring.is_open())
+	{
+		ring_readout();
+		return;
+	}
+
+	// One read takes everything the pipe has (up to FEEDER_READ_SIZE), not only one word
+	ssize_t num = read(pipe->fd_pipe_plugin, read_buf.data() + carry, read_buf.size() - carry);
 	reads++;
 
 	if (num > 0) {
-		loops_wo_data = 0;
-		messages++;
-
-		int data_type = (buf >> 44) & 0xF;
-
-		switch (data_type) {
-		case 0x7:	// Frame start
-			finished = false;
-			timeoffset_for_run = 0;
-			pix_output->ClearIn();
-			snprintf(buf_string, sizeof(buf_string), "\nFrame start: %d, numBytes = %d", data_type, num);
-			printf(buf_string);
-			fflush(stdout);
-			break;
-
-		case 0xC:	// Frame end
-			snprintf(buf_string, sizeof(buf_string), "\nFrame END: %d, numBytes = %d", data_type, num);
-			printf(buf_string);
-			fflush(stdout);
-			pix_output->Flush();
-			pix_output->ClearIn();
-			finished = true;
-			break;
-
-		case 0x5:	// Pixel timestamp offset
-			timeoffset_for_run = buf & 0xFFFFFFFF;
-			break;
-
-		case 0x4:	// Pixel measurement data
-		{
-			// Handle too much data situation - dont emplace the pixel further
-			if (is_stable() == false) return;
+		const size_t avail = carry + static_cast<size_t>(num);
+		const size_t words = avail / katherine_readout::WORD_BYTES;
 
-			pixel_tmp_direct = pixel_process_directly(buf, timeoffset_for_run);
+		// Whole block at once, runs of pixel words are split to columns together
+		readout_handler handler{ *this };
+		katherine_readout::decode_words(read_buf.data(), words, readout, cols, handler);
+		messages += words;
 
-			// Filtering
-			if (doFilter > 0)
-			{
-				if (pixel_tmp_direct.x > upFilter || pixel_tmp_direct.x < doFilter || pixel_tmp_direct.y > upFilter || pixel_tmp_direct.y < doFilter) return;
-			}
+		// Keep incomplete word for the next read
+		carry = avail - (words * katherine_readout::WORD_BYTES);
+		if (carry > 0) memmove(read_buf.data(), read_buf.data() + (words * katherine_readout::WORD_BYTES), carry);
 
-			pix_output->Emplace_Back((std::move(pixel_tmp_direct)));
-			real_pixels++;
-			break;
-		}
-		case 0xD: 	// Number of lost pixels
-			no_lost_pixels += buf & 0x0FFFFFFFFFFF;	// First 44 bits, last 4 is masked (its data_type)
-			break;
-
-		case 0x0:
-			// Pixels from detector 0, 0x01 would be from detector 1
+		// Publish pixels of this read right away when clustering is about to run out of blocks, otherwise fill the block
+		// (partially filled blocks would use up the ring long before the watermarks are reached)
+		if (pix_output->blocksOut() < 2) pix_output->Flush();
+		return;
+	}
 
-			// Handle too much data situation - dont emplace the pixel further
-			if (is_stable() == false) return;
+	/* Wait for new data */
+	if (num < 0 && errno == EAGAIN)
+	{
+		// Sleep in poll until the pipe has data or feeder is stopped
+		pollfd fds[2] = { {pipe->fd_pipe_plugin, POLLIN, 0}, {stop_event.fd(), POLLIN, 0} };
+		poll(fds, 2, WAIT_TIMEOUT_MS);
+		if (fds[1].revents & POLLIN) stop_event.drain();
+	}
+	else
+	{
+		// No writer on the pipe (end of file) - poll would return immediately, sleep instead of busy waiting
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
 
-			pixel_tmp_direct = pixel_process_directly(buf, timeoffset_for_run);
+	return;
+}
 
-			// Filtering
-			if (doFilter > 0)
-			{
-				if (pixel_tmp_direct.x > upFilter || pixel_tmp_direct.x < doFilter || pixel_tmp_direct.y > upFilter || pixel_tmp_direct.y < doFilter) return;
-			}
+// Words are decoded in place in the shared memory ring, no syscall while the ring has data
+void pixel_feeder::ring_readout()
+{
+	size_t length = 0;
+	const char* data = pipe->ring.peek(length);
 
-			pix_output->Emplace_Back((std::move(pixel_tmp_direct)));
-			real_pixels++;
-			break;
-		default:
-			snprintf(buf_string, sizeof(buf_string), "\nUnknown data from pipe: %d, numBytes = %d", data_type, num);
-			printf(buf_string);
-			fflush(stdout);
-			break;
+	if (data == nullptr)
+	{
+		// Readout process exited, or crashed and was started again (its ring was never closed, the new one replaced it)
+		if (pipe->ring.producer_closed() || pipe->ring.is_replaced(SHM_RING_PATH))
+		{
+			// Take the new ring once it is created, the old one stays until then
+			if (pipe->ring.attach(SHM_RING_PATH) == false) std::this_thread::sleep_for(std::chrono::milliseconds(WAIT_TIMEOUT_MS));
+			return;
 		}
 
+		// Sleep on the ring futex until the producer writes. Ring is attached again only here,
+		// so stop() does not touch it - the timeout bounds how long stop waits for the feeder
+		if (running) pipe->ring.wait_data(WAIT_TIMEOUT_MS);
 		return;
 	}
 
-	/* Wait for new data */
-	loops_wo_data++;
-	if (loops_wo_data > loops_timeout)
+	// Same block size as one pipe read, ring holds only whole words
+	const size_t words = std::min(length, static_cast<size_t>(FEEDER_READ_SIZE)) / katherine_readout::WORD_BYTES;
+	reads++;
+
+	readout_handler handler{ *this };
+	katherine_readout::decode_words(data, words, readout, cols, handler);
+	messages += words;
+
+	pipe->ring.consume(words * katherine_readout::WORD_BYTES);
+
+	if (pix_output->blocksOut() < 2) pix_output->Flush();
+}
+
+// Update overload state from queued pixels. Returns false when the feeder should not read now (blocked reader)
+bool pixel_feeder::apply_backpressure()
+{
+	const size_t queued = pix_output->sizeOut();
+
+	if (overloaded == false && queued >= high_items) overloaded = true;
+	else if (overloaded == true && queued <= low_items) overloaded = false;
+
+	if (overloaded == false) return true;
+
+	switch (bp_policy)
+	{
+	case backpressure_policy::block_reader:
 	{
-		loops_wo_data = 0;
-		std::this_thread::sleep_for(std::chrono::milliseconds(1)); // Sleep, prevent busy waiting
-
-		// This was a snapshot of nonlinear waiting time based on frequency of incoming data
-		/*float dur_diff = (std::chrono::high_resolution_clock::now() - last_timeout).count();
-		loops_timeout = static_cast<uint16_t>(1.0f / dur_diff);
-		last_timeout = std::chrono::high_resolution_clock::now();*/
-		// Sleep because no new data are incoming - this prevents constant busy waiting
+		// Pipe fills up and board reports pixels it could not send as lost
+		const auto start = std::chrono::steady_clock::now();
+		pix_output->Wait_Space(low_items, WAIT_TIMEOUT_MS);
+		const auto waited = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+		blocked_us.store(blocked_us.load(std::memory_order_relaxed) + static_cast<size_t>(waited.count()), std::memory_order_relaxed);
+		return false;
 	}
+	case backpressure_policy::drop_oldest:
+		pix_output->Request_Trim(low_items);
+		return true;
+	default:	// Sampling is done in readout_pixels
+		return true;
+	}
+}
 
-	return;
+void pixel_feeder::reset_drop_stats()
+{
+	sampled_out = 0;
+	lost_on_board = 0;
+	blocked_us = 0;
+	trimmed_base = pix_output->trimmed();
+	dropped_base = pix_output->dropped();
+	sample_counter = 0;
+}
+
+void pixel_feeder::readout_control(uint64_t word, int type)
+{
+	// Time offset is already in readout state
+	switch (type) {
+	case katherine_readout::frame_start:
+		finished = false;
+		reset_drop_stats();
+		pix_output->ClearIn();
+		snprintf(buf_string, sizeof(buf_string), "\nFrame start: %d", type);
+		printf(buf_string);
+		fflush(stdout);
+		break;
+
+	case katherine_readout::frame_end:
+		snprintf(buf_string, sizeof(buf_string), "\nFrame END: %d", type);
+		printf(buf_string);
+		fflush(stdout);
+		pix_output->Flush();
+		pix_output->ClearIn();
+		finished = true;
+		break;
+
+	case katherine_readout::lost_pixels:
+		lost_on_board.store(lost_on_board.load(std::memory_order_relaxed) + (word & 0x0FFFFFFFFFFF), std::memory_order_relaxed);
+		break;
+
+	case katherine_readout::time_offset:
+		break;
+
+	default:
+		snprintf(buf_string, sizeof(buf_string), "\nUnknown data from pipe: %d", type);
+		printf(buf_string);
+		fflush(stdout);
+		break;
+	}
+}
+
+void pixel_feeder::readout_pixels(const katherine_readout::columns& run, size_t n)
+{
+	const bool sampling = overloaded && bp_policy == backpressure_policy::sample;
+	size_t not_kept = 0;
+
+	for (size_t k = 0; k < n; k++)
+	{
+		// Too much data - keep only every Nth pixel
+		if (sampling)
+		{
+			if (++sample_counter < sample_every)
+			{
+				not_kept++;
+				continue;
+			}
+			sample_counter = 0;
+		}
+
+		// Filtering
+		if (doFilter > 0)
+		{
+			if (run.x[k] > upFilter || run.x[k] < doFilter || run.y[k] > upFilter || run.y[k] < doFilter) continue;
+		}
+
+		pix_output->Emplace_Back(OnePixel{static_cast<uint16_t>(run.x[k]), static_cast<uint16_t>(run.y[k]), static_cast<int32_t>(run.tot[k]), run.time[k]});
+		real_pixels++;
+	}
+
+	if (not_kept > 0) sampled_out.store(sampled_out.load(std::memory_order_relaxed) + not_kept, std::memory_order_relaxed);
 }
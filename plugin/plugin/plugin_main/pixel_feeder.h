@@ -12,11 +12,17 @@
 #include "clustering_base.h"
 #include "plugin_definition.h"
 #include "networking.h"
+#include "katherine_readout.h"
 #include "utility.h"
+#include "wakeup.h"
 #include <chrono>
 #include <thread>
 #include <memory>
 #include <atomic>
+#include <vector>
+#include <cerrno>
+#include <poll.h>
+#include <algorithm>
 
 class pixel_feeder : private plugin_definition
 {
@@ -28,6 +34,7 @@ public:
 		pipe = netw;
 		pix_output = shared;
 		finished = true;
+		read_buf.resize(FEEDER_READ_SIZE);
 	}
 
 	~pixel_feeder()
@@ -62,6 +69,36 @@ public:
 		}
 	}
 
+	// What to do when queued pixels reach highBytes, until they drop to lowBytes (backpressure_policy)
+	void set_backpressure(int policy, int sampleEvery, int64_t highBytes, int64_t lowBytes)
+	{
+		bp_policy = policy;
+		sample_every = static_cast<uint32_t>(sampleEvery);
+		high_items = static_cast<size_t>(highBytes) / sizeof(OnePixel);
+		low_items = static_cast<size_t>(lowBytes) / sizeof(OnePixel);
+	}
+
+	// Pixels lost since frame start - exact counts of every place where pixels can be dropped
+	struct drop_stats
+	{
+		size_t sampled_out;		// Not kept by sampling
+		size_t dropped_oldest;	// Thrown away from the queue
+		size_t queue_full;		// Queue had no free block
+		size_t lost_on_board;	// Reported by the board (it could not send them, also when reader is blocked)
+		size_t blocked_us;		// Time the reader was blocked
+	};
+
+	drop_stats get_drop_stats()
+	{
+		drop_stats ret;
+		ret.sampled_out = sampled_out;
+		ret.dropped_oldest = pix_output->trimmed() - trimmed_base;
+		ret.queue_full = pix_output->dropped() - dropped_base;
+		ret.lost_on_board = lost_on_board;
+		ret.blocked_us = blocked_us;
+		return ret;
+	}
+
 	size_t reads = 0;
 	size_t messages = 0;
 	size_t real_pixels = 0;
@@ -72,55 +109,53 @@ private:
 
 	// Inputs sources
 	networking* pipe;
+	wakeup stop_event;	// Wakes the feeder sleeping in poll on stop() (not the ring futex, ring belongs to the feeder thread)
 
 	// Outputs
 	std::shared_ptr<MTQueueBuffered<OnePixel, FEEDER_BUFF_SIZE>> pix_output;	// Shared Queue for pixel data betweeen this and further processings
 
 	// Network related variables
-	uint32_t timeoffset_for_run = 0;
-	uint64_t no_lost_pixels = 0;
+	std::vector<char> read_buf;		// Block read from the pipe
+	size_t carry = 0;				// Bytes of incomplete word at the start of read_buf
+	katherine_readout::state readout;	// Time offset, frames and lost pixels of the stream
+	katherine_readout::columns cols;	// Decoded run of pixel words
 	//char buf_string[100];
 
+	// Backpressure variables
+	int bp_policy = backpressure_policy::block_reader;
+	uint32_t sample_every = FEEDER_SAMPLE_EVERY;
+	uint32_t sample_counter = 0;
+	size_t high_items = FEEDER_HIGH_WATERMARK / sizeof(OnePixel);
+	size_t low_items = FEEDER_LOW_WATERMARK / sizeof(OnePixel);
+	bool overloaded = false;		// Between reaching high watermark and dropping to low watermark
+
+	// Drop counters - written only by feeder, reset at frame start
+	std::atomic<size_t> sampled_out{0};
+	std::atomic<size_t> lost_on_board{0};
+	std::atomic<size_t> blocked_us{0};
+	std::atomic<size_t> trimmed_base{0};
+	std::atomic<size_t> dropped_base{0};
+
 	// Outer filter variables
 	uint16_t upFilter = 0;
 	uint16_t doFilter = 0;
 
 	// Private pix reading functions
 	inline void pix_readout();
-
-	// return whether we dont have too much data - we have to stop receiving pixels
-	bool is_stable()
+	void ring_readout();
+	bool apply_backpressure();
+	void reset_drop_stats();
+	void readout_control(uint64_t word, int type);
+	void readout_pixels(const katherine_readout::columns& run, size_t n);
+
+	// Passes decoded words from katherine_readout::decode_words back to the feeder
+	struct readout_handler
 	{
-		static bool tempWait = false;	// temp wait for half buffer to be emptied
-		static uint32_t loops = 0;
+		pixel_feeder& feeder;
 
-		loops++;
-
-		if (loops > 500000)
-		{
-			loops = 0;
-			// When > 30 MB / 16B -> not stable
-			if (tempWait == false && pix_output->sizeOut() > 1875000)
-			{
-				printf("Is not stable - more than 1.8M pix\n");
-				fflush(stdout);
-				tempWait = true;
-			}
-
-			// Return to normal mode when half of buffer was processed
-			if (tempWait == true && pix_output->sizeOut() < (1875000/2))
-			{
-				printf("Is stable again\n");
-				fflush(stdout);
-				tempWait = false;
-			}
-
-			// is_stable is negation of tempWait
-			return (!tempWait);
-		}
-
-		return true;
-	}
+		void control(uint64_t word, int type) { feeder.readout_control(word, type); };
+		void pixels(const katherine_readout::columns& run, size_t n) { feeder.readout_pixels(run, n); };
+	};
 };
 
 #endif /* PLUGIN_MAIN_PIXEL_FEEDER_H_ */
@@ -20,8 +20,28 @@ const std::string command_idle = "-IDLE";
 const std::string command_shutdown = "-SHUT";
 const std::string command_help = "-help";
 
-// Size of pixel feeder buffer
-#define FEEDER_BUFF_SIZE 10000
+// Pixels in one block of the feeder queue and number of blocks in its ring (4096 * 512 * 16 B = 32 MB at most)
+#define FEEDER_BUFF_SIZE 4096
+#define FEEDER_QUEUE_BLOCKS 512
+
+// Bytes read from the detector pipe at once, 6 B words split between reads are carried over
+#define FEEDER_READ_SIZE 65536
+
+// Bytes of pixels the feeder queue can hold and default backpressure (bytes of queued pixels, every Nth pixel kept)
+#define FEEDER_QUEUE_BYTES (FEEDER_BUFF_SIZE * FEEDER_QUEUE_BLOCKS * sizeof(OnePixel))
+#define FEEDER_HIGH_WATERMARK 30000000
+#define FEEDER_LOW_WATERMARK 15000000
+#define FEEDER_SAMPLE_EVERY 10
+
+// Longest sleep of a thread waiting for data (ms) - running state and mode are checked at least this often
+#define WAIT_TIMEOUT_MS 50
+
+// Sender thread sends queued frames when they reach BATCH bytes or the oldest waits MAX_LATENCY (ms), defaults of config.
+// Main loop takes no more output while QUEUE bytes wait to be sent, POOL payload buffers are kept for reuse
+#define SEND_BATCH_BYTES 65536
+#define SEND_MAX_LATENCY_MS 10
+#define SEND_QUEUE_BYTES (16 * 1024 * 1024)
+#define SEND_POOL_BUFFERS 8
 
 /* Used for example
  * if (state = plugin_states::ready) start_something(); */
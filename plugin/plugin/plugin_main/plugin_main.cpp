@@ -27,21 +27,27 @@ plugin_main::plugin_main(networking* net)
 	check_err_state();
 
 	// Create shared variables
-	pixel_feed = std::make_shared<MTQueueBuffered<OnePixel, FEEDER_BUFF_SIZE>>();
-	out_clusters = std::make_shared<MTVector<CompactClusterType>>();
-	out_energies = std::make_shared<MTVector<uint16_t>>();
+	pixel_feed = std::make_shared<MTQueueBuffered<OnePixel, FEEDER_BUFF_SIZE>>(FEEDER_QUEUE_BLOCKS);
+	out_clusters = std::make_shared<MTSwapBuffer<CompactClusterType>>();
+	out_energies = std::make_shared<MTSwapBuffer<uint16_t>>();
 	pixel_count_for_energy = std::make_shared<MTVariable<size_t>>();
-	out_pixels = std::make_shared<MTVector<OnePixel>>();
-	out_pixel_counts = std::make_shared<MTVector<OnePixelCount>>();
+	out_pixels = std::make_shared<MTSwapBuffer<OnePixel>>();
+	out_pixel_counts = std::make_shared<MTSwapBuffer<OnePixelCount>>();
+	out_ready = std::make_shared<wakeup>();
 	params.clusterFilterSize = 0;
 	params.filterBiggerClusters = false;
 	params.maxClusterDelay = 200000;
 	params.maxClusterSpan = 200;
 	params.outerFilterSize = 0;
+	params.backpressure = backpressure_policy::block_reader;
+	params.sampleEvery = FEEDER_SAMPLE_EVERY;
+	params.highWatermark = FEEDER_HIGH_WATERMARK;
+	params.lowWatermark = FEEDER_LOW_WATERMARK;
+	params.threads = 1;
 
 	// Create future threads objects
 	feeder = new pixel_feeder(network, pixel_feed);
-	clustering = new clustering_main(pixel_feed, out_clusters, out_energies, out_pixels, out_pixel_counts, pixel_count_for_energy);
+	clustering = new clustering_main(pixel_feed, out_clusters, out_energies, out_pixels, out_pixel_counts, pixel_count_for_energy, out_ready);
 }
 
 plugin_main::~plugin_main()
@@ -154,11 +160,16 @@ int plugin_main::plugin_start(plugins to_start)
 		// Stop the clustering
 		if (t_clustering.joinable() == true)
 		{
-			clustering->clear_and_free_memory();	// Clear the memory
-			clustering->stop();		// Stop the feeder thread
+			clustering->stop();		// Stop the clustering thread, it clears its memory when finishing
 			t_clustering.join();	// Wait for it to finish
 		}
 
+		// Drop output which was not sent
+		out_clusters->ClearOut();
+		out_energies->ClearOut();
+		out_pixels->ClearOut();
+		out_pixel_counts->ClearOut();
+
 		// INFO: Clustering Idle was already set (its sleeping)
 		break;
 	default:
@@ -31,19 +31,18 @@ public:
 	// Middle vars - feeders
 	std::shared_ptr<MTQueueBuffered<OnePixel, FEEDER_BUFF_SIZE>> pixel_feed;
 
-	// Outputs
-	std::shared_ptr<MTVector<CompactClusterType>> out_clusters;
-	std::shared_ptr<MTVector<uint16_t>> out_energies;
+	// Outputs - filled by clustering thread, batches are taken by the main loop
+	std::shared_ptr<MTSwapBuffer<CompactClusterType>> out_clusters;
+	std::shared_ptr<MTSwapBuffer<uint16_t>> out_energies;
 	std::shared_ptr<MTVariable<size_t>> pixel_count_for_energy;
-	std::shared_ptr<MTVector<OnePixel>> out_pixels;
-	std::shared_ptr<MTVector<OnePixelCount>> out_pixel_counts;
+	std::shared_ptr<MTSwapBuffer<OnePixel>> out_pixels;
+	std::shared_ptr<MTSwapBuffer<OnePixelCount>> out_pixel_counts;
+	std::shared_ptr<wakeup> out_ready;	// Clustering posts it when it produced output
 
 
 	int plugin_start(plugins plug);
 	void check_err_state();
 
-#define MIN_FRAME_BYTE_SIZE 5
-
 	// Is feeder finished - indicates whether measurement ended
 	bool is_finished()
 	{
@@ -76,89 +75,88 @@ public:
 		return feeder->reads;
 	}
 
-	bool is_done_clusters_big()
+	// Pixels dropped since frame start (sampling, queue, board)
+	pixel_feeder::drop_stats get_drop_stats()
 	{
-		// Dont emplace rest of unfinished clusters after clustering finished
+		return feeder->get_drop_stats();
+	}
 
-		if(out_clusters->Size()*sizeof(CompactClusterType) > MIN_FRAME_BYTE_SIZE) return true;
-		else
-		{
-			// If finished and is not big, delete the rest - because no more data will be gathered
-			if (feeder->finished == true && is_clustering_finished())
-			{
-				clustering->clear_and_free_memory();
-			}
+	// Batch throughput of clustering thread - blocks taken, their pixels and time spent processing them
+	size_t get_batches()
+	{
+		return clustering->batches;
+	}
 
-			return false;
-		}
+	size_t get_batch_pixels()
+	{
+		return clustering->batch_pixels;
+	}
+
+	size_t get_batch_busy_us()
+	{
+		return clustering->batch_busy_us;
+	}
+
+	// Sleep until clustering produced some output, at most timeout_ms
+	bool wait_for_output(int timeout_ms)
+	{
+		return out_ready->wait(timeout_ms);
+	}
+
+	// Output checks are only a load of an atomic pointer, batches are taken without copying
+	bool is_done_clusters_big()
+	{
+		if (out_clusters->isReady()) return true;
+
+		free_if_finished();
+		return false;
 	}
 
-	std::vector<CompactClusterType> get_done_clusters()
+	// Batch is valid until the next get_done_clusters()
+	const std::vector<CompactClusterType>& get_done_clusters()
 	{
-		return out_clusters->Get_All_And_Erase();
+		return out_clusters->Take();
 	}
 
 	bool is_done_pixels_big()
 	{
-		if(out_pixels->Size()*sizeof(OnePixel) > MIN_FRAME_BYTE_SIZE) return true;
-		else
-		{
-			// If finished and is not big, delete the rest - because no more data will be gathered
-			if (feeder->finished == true && is_clustering_finished())
-			{
-				clustering->clear_and_free_memory();
-			}
+		if (out_pixels->isReady()) return true;
 
-			return false;
-		}
+		free_if_finished();
+		return false;
 	}
 
-	std::vector<OnePixel> get_done_pixels()
+	const std::vector<OnePixel>& get_done_pixels()
 	{
-		pixels_num += out_pixels->Size();
-		return out_pixels->Get_All_And_Erase();
+		const std::vector<OnePixel>& pixels = out_pixels->Take();
+		pixels_num += pixels.size();
+		return pixels;
 	}
 
 	bool is_done_counts_big()
 	{
-		if (out_pixel_counts->Size()*sizeof(OnePixelCount) > MIN_FRAME_BYTE_SIZE) return true;
-		else
-		{
-			// If finished and is not big, delete the rest - because no more data will be gathered
-			if (feeder->finished == true && is_clustering_finished())
-			{
-				clustering->clear_and_free_memory();
-			}
+		if (out_pixel_counts->isReady()) return true;
 
-			return false;
-		}
+		free_if_finished();
+		return false;
 	}
 
-	std::vector<OnePixelCount> get_done_counts()
+	const std::vector<OnePixelCount>& get_done_counts()
 	{
-		return out_pixel_counts->Get_All_And_Erase();
+		return out_pixel_counts->Take();
 	}
 
 	bool is_done_histograms_big()
 	{
-		// Dont emplace rest of unfinished energies after clustering finished
+		if (out_energies->isReady()) return true;
 
-		if(out_energies->Size()*sizeof(uint16_t) > MIN_FRAME_BYTE_SIZE) return true;
-		else
-		{
-			// If finished and is not big, delete the rest - because no more data will be gathered
-			if (feeder->finished == true && is_clustering_finished())
-			{
-				clustering->clear_and_free_memory();
-			}
-
-			return false;
-		}
+		free_if_finished();
+		return false;
 	}
 
-	std::vector<uint16_t> get_done_histograms()
+	const std::vector<uint16_t>& get_done_histograms()
 	{
-		return out_energies->Get_All_And_Erase();
+		return out_energies->Take();
 	}
 
 	// Get pixel counts -> how many pixels were included in the energies now gathered
@@ -190,10 +188,31 @@ public:
 		{
 			clustering->set_clustering_params(params);
 			feeder->set_filtering(params.outerFilterSize);	// feeder does the outer filtering
+			feeder->set_backpressure(params.backpressure, params.sampleEvery, params.highWatermark, params.lowWatermark);
 		}
 	}
 
 private:
+	// If finished and nothing is left to send, free the memory - because no more data will be gathered
+	void free_if_finished()
+	{
+		if (feeder->finished == true && is_clustering_finished())
+		{
+			// Clusters held by clustering are sent before they are freed
+			if (clustering->is_flushed() == false)
+			{
+				clustering->request_flush();
+				return;
+			}
+
+			out_clusters->ClearOut();
+			out_energies->ClearOut();
+			out_pixels->ClearOut();
+			out_pixel_counts->ClearOut();
+			clustering->request_clear();
+		}
+	}
+
 	networking* network;
 	clustering_main* clustering;
 	pixel_feeder* feeder;
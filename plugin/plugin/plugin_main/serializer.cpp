@@ -6,117 +6,292 @@
 
 #include "serializer.h"
 
+#include <algorithm>
+#include <cstring>
+
+const uint8_t serializer::BINARY_FRAME_VERSION;
+const uint8_t serializer::FRAME_FLAG_COMPACT;
+const size_t serializer::BINARY_FRAME_HEADER;
+const size_t serializer::BINARY_PIXEL_BYTES;
+const uint8_t serializer::HEADER_MAGIC;
+const size_t serializer::BINARY_HEADER_BYTES;
+const size_t serializer::MAX_TEXT_HEADER_BYTES;
+
+namespace
+{
+	const size_t MAX_VARINT = 10;			// Bytes of 64 bit varint
+	const size_t MAX_COMPACT_PIXEL = 3 + 3 + 3 + MAX_VARINT;	// dx, dy, ToT, ToA
+
+	// Little-endian regardless of the machine, compilers turn these into plain loads/stores on little-endian
+	inline void put_le(char* p, uint64_t value, size_t bytes)
+	{
+		for (size_t i = 0; i < bytes; i++)
+		{
+			p[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+		}
+	}
+
+	inline uint64_t get_le(const char* p, size_t bytes)
+	{
+		uint64_t value = 0;
+		for (size_t i = 0; i < bytes; i++)
+		{
+			value |= static_cast<uint64_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+		}
+		return value;
+	}
+
+	// LEB128 - 7 bits per byte, lowest first, top bit set when more bytes follow
+	inline void put_varint(char*& p, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			*p++ = static_cast<char>((value & 0x7F) | 0x80);
+			value >>= 7;
+		}
+		*p++ = static_cast<char>(value);
+	}
+
+	inline bool get_varint(const char*& p, const char* end, uint64_t& value)
+	{
+		value = 0;
+		for (unsigned shift = 0; p < end && shift < 64; shift += 7)
+		{
+			const uint8_t byte = static_cast<uint8_t>(*p++);
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) return true;
+		}
+		return false;	// Frame ends inside varint or varint is too long
+	}
+
+	// Signed deltas as unsigned - small negative numbers stay small
+	inline uint64_t zigzag(int64_t value)
+	{
+		return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+	}
+
+	inline int64_t unzigzag(uint64_t value)
+	{
+		return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	}
+
+	inline uint64_t clamp_tot(int64_t ToT)
+	{
+		return static_cast<uint64_t>((ToT < 0) ? 0 : ((ToT > 0xFFFF) ? 0xFFFF : ToT));
+	}
+
+	inline void put_frame_header(char* p, bool compact, size_t count)
+	{
+		put_le(p, serializer::BINARY_FRAME_VERSION, 1);
+		put_le(p + 1, compact ? serializer::FRAME_FLAG_COMPACT : 0, 1);
+		put_le(p + 2, 0, 2);	// reserved
+		put_le(p + 4, count, 4);
+	}
+
+	inline bool get_frame_header(const char* p, size_t length, bool& compact, uint64_t& count)
+	{
+		if (length < serializer::BINARY_FRAME_HEADER) return false;
+		if (static_cast<uint8_t>(p[0]) != serializer::BINARY_FRAME_VERSION) return false;
+
+		const uint8_t flags = static_cast<uint8_t>(p[1]);
+		if ((flags & ~serializer::FRAME_FLAG_COMPACT) != 0) return false;	// Unknown encoding
+
+		compact = (flags & serializer::FRAME_FLAG_COMPACT) != 0;
+		count = get_le(p + 4, 4);
+		return true;
+	}
+
+	inline void put_packed_pixel(char* p, const OnePixel& pix)
+	{
+		put_le(p, pix.x, 1);
+		put_le(p + 1, pix.y, 1);
+		put_le(p + 2, clamp_tot(pix.ToT), 2);
+		put_le(p + 4, static_cast<uint64_t>(static_cast<int64_t>(pix.ToA)), 8);
+	}
+
+	inline OnePixel get_packed_pixel(const char* p)
+	{
+		return OnePixel(static_cast<uint16_t>(get_le(p, 1)), static_cast<uint16_t>(get_le(p + 1, 1)),
+			static_cast<int>(get_le(p + 2, 2)), static_cast<decltype(OnePixel::ToA)>(static_cast<int64_t>(get_le(p + 4, 8))));
+	}
+
+	// Letter of dataframe type in headers
+	char type_letter(dataframe_types type)
+	{
+		switch (type)
+		{
+		case dataframe_types::clusters:
+			return 'C';
+		case dataframe_types::pixels:
+			return 'P';
+		case dataframe_types::energies:
+			return 'H';
+		case dataframe_types::pixel_counts:
+			return 'N';
+		case dataframe_types::messages:
+			return 'M';
+		case dataframe_types::errors:
+			return 'E';
+		case dataframe_types::command:
+			return 'K';
+		case dataframe_types::config:
+			return 'V';
+		case dataframe_types::acknowledge:
+			return 'A';
+		case dataframe_types::clusters_binary:
+			return 'B';
+		case dataframe_types::pixels_binary:
+			return 'Q';
+		case dataframe_types::pixel_counts_binary:
+			return 'R';
+		default:
+			// Default behaviour: Send as a message
+			return 'M';
+		}
+	}
+
+	dataframe_types letter_type(char letter)
+	{
+		switch (letter)
+		{
+		case 'C':
+			return dataframe_types::clusters;
+		case 'P':
+			return dataframe_types::pixels;
+		case 'H':
+			return dataframe_types::energies;
+		case 'N':
+			return dataframe_types::pixel_counts;
+		case 'M':
+			return dataframe_types::messages;
+		case 'E':
+			return dataframe_types::errors;
+		case 'K':
+			return dataframe_types::command;
+		case 'V':
+			return dataframe_types::config;
+		case 'A':
+			return dataframe_types::acknowledge;
+		case 'B':
+			return dataframe_types::clusters_binary;
+		case 'Q':
+			return dataframe_types::pixels_binary;
+		case 'R':
+			return dataframe_types::pixel_counts_binary;
+		default:
+			return dataframe_types::messages;	// Messages are default type
+		}
+	}
+}
+
 // Attach message header
 void serializer::attach_header(std::string& input, dataframe_types type)
 {
-	std::string prepend = "";
-
-	// Prepare the string to prepend before serialized
-	switch (type)
-	{
-	case dataframe_types::clusters:
-		prepend = 'C';
-		break;
-	case dataframe_types::pixels:
-		prepend = 'P';
-		break;
-	case dataframe_types::energies:
-		prepend = 'H';
-		break;
-	case dataframe_types::pixel_counts:
-		prepend = 'N';
-		break;
-	case dataframe_types::messages:
-		prepend = 'M';
-		break;
-	case dataframe_types::errors:
-		prepend = 'E';
-		break;
-	case dataframe_types::command:
-		prepend = 'K';
-		break;
-	case dataframe_types::config:
-		prepend = 'V';
-		break;
-	case dataframe_types::acknowledge:
-		prepend = 'A';
-		break;
-	default:
-		// Default behaviour: Send as a message
-		prepend = 'M';
-		break;
-	}
-
-	// Get size of message in bytes
-	size_t bytes = input.size() + 1 + 1 + 1;	// Take into account #, ;,'type'
-	std::string sNumber = std::to_string(bytes);
-
-	// Double sample to get the true size in bytes
-	bytes = sNumber.size() + bytes;
-	sNumber = std::to_string(bytes);
-	bytes = sNumber.size() + input.size() + 1 + 1 + 1;
-	sNumber = std::to_string(bytes);
-	bytes = sNumber.size() + input.size() + 1 + 1 + 1;
-
-	// Append length after 'type'
-	prepend.append("#");
-	prepend.append(std::to_string(bytes));
-	prepend.append(";");
-
-	// Prepend to input
-	input.insert(0, prepend);
+	char header[MAX_TEXT_HEADER_BYTES];
+	input.insert(0, header, put_text_header(header, type, input.size()));
+}
+
+void serializer::attach_frame_header(std::string& input, dataframe_types type)
+{
+	char header[BINARY_HEADER_BYTES];
+	put_header(header, type, input.size());
+	input.insert(0, header, BINARY_HEADER_BYTES);
+}
+
+void serializer::put_header(char* out, dataframe_types type, size_t length)
+{
+	put_le(out, HEADER_MAGIC, 1);
+	out[1] = type_letter(type);
+	put_le(out + 2, 0, 2);		// Flags, reserved
+	put_le(out + 4, length, 4);
+}
+
+size_t serializer::put_text_header(char* out, dataframe_types type, size_t length)
+{
+	// Length of whole frame: 'type', #, ; and the number itself - it gets one digit longer at most by counting itself
+	size_t bytes = length + 1 + 1 + 1;
+	size_t digits = std::to_string(bytes).size();
+	if (std::to_string(bytes + digits).size() > digits) digits++;
+	bytes += digits;
+
+	const std::string number = std::to_string(bytes);
+	out[0] = type_letter(type);
+	out[1] = '#';
+	memcpy(out + 2, number.data(), number.size());
+	out[2 + number.size()] = ';';
+
+	return number.size() + 3;
+}
+
+int serializer::parse_header(const char* data, size_t available, frame_view& frame)
+{
+	if (available < 2) return 0;
+
+	if (static_cast<uint8_t>(data[0]) == HEADER_MAGIC)
+	{
+		if (available < BINARY_HEADER_BYTES) return 0;
+
+		frame.type = letter_type(data[1]);
+		frame.flags = static_cast<uint8_t>(data[2]);
+		frame.length = static_cast<size_t>(get_le(data + 4, 4));
+		return static_cast<int>(BINARY_HEADER_BYTES);
+	}
+
+	// Text header - digits up to ';', looked at only once the whole header is there
+	if (data[1] != '#') return -1;
+
+	const size_t end = std::min(available, MAX_TEXT_HEADER_BYTES);
+	uint64_t bytes = 0;
+	for (size_t i = 2; i < end; i++)
+	{
+		if (data[i] == ';')
+		{
+			if (i == 2 || bytes < i + 1) return -1;		// No number or shorter than its header
+
+			frame.type = letter_type(data[0]);
+			frame.flags = 0;
+			frame.length = static_cast<size_t>(bytes - (i + 1));
+			return static_cast<int>(i + 1);
+		}
+		if (data[i] < '0' || data[i] > '9') return -1;
+
+		bytes = bytes * 10 + static_cast<uint64_t>(data[i] - '0');
+	}
+
+	return (available < MAX_TEXT_HEADER_BYTES) ? 0 : -1;
 }
 
 void serializer::deattach_header(std::string& input)
 {
-	size_t offset = input.find('#');
-	if (offset == std::string::npos) return;	// We dont have header anymore
+	frame_view frame;
+	int header = parse_header(input.data(), input.size(), frame);
+	if (header <= 0) return;	// We dont have header anymore
 
-	offset = input.find(';') + 1;	// Go one after ';'
-	if (offset == std::string::npos) return;	// Unepected error
-	input.erase(0, offset);		// Erase header from input
+	input.erase(0, header);		// Erase header from input
 }
 
 dataframe_types serializer::get_type(const std::string& message)
 {
-	size_t offset = message.find('#');
-	if (offset == std::string::npos || offset <= 0) return dataframe_types::messages;	// Unexpected
-
-	char type = message[(offset - 1)];	// Type is always one place before #
-	switch (type)
-	{
-	case 'C':
-		return dataframe_types::clusters;
-	case 'P':
-		return dataframe_types::pixels;
-	case 'H':
-		return dataframe_types::energies;
-	case 'N':
-		return dataframe_types::pixel_counts;
-	case 'M':
-		return dataframe_types::messages;
-	case 'E':
-		return dataframe_types::errors;
-	case 'K':
-		return dataframe_types::command;
-	case 'V':
-		return dataframe_types::config;
-	case 'A':
-		return dataframe_types::acknowledge;
-	default:
-		return dataframe_types::messages;
-	}
-
-	return dataframe_types::messages;	// Messages are default type
+	frame_view frame;
+	if (parse_header(message.data(), message.size(), frame) <= 0) return dataframe_types::messages;	// Unexpected
+
+	return frame.type;
+}
+
+size_t serializer::header_size(const std::string& message)
+{
+	frame_view frame;
+	int header = parse_header(message.data(), message.size(), frame);
+	return (header > 0) ? static_cast<size_t>(header) : 0;
 }
 
 
  // Semicolon separated clusters
  // Comma separated pixels
  // \t separated elements of pixel
-std::string serializer::serialize_clusters(const std::vector<CompactClusterType>& clusters)
+void serializer::serialize_clusters(const std::vector<CompactClusterType>& clusters, std::string& out)
 {
-	std::string ret;
+	out.clear();
 	size_t pixNum = 0;
 
 	for (auto& cluster : clusters)
@@ -124,29 +299,27 @@ std::string serializer::serialize_clusters(const std::vector<CompactClusterType>
 		for (auto& pix : cluster.pix)
 		{
 			pixNum++;
-			ret.append(std::to_string(pix.x));
-			ret.append("\t");
-			ret.append(std::to_string(pix.y));
-			ret.append("\t");
-			ret.append(std::to_string(static_cast<uint32_t>(pix.ToT)));
-			ret.append("\t");
-			ret.append(std::to_string(static_cast<uint64_t>(pix.ToA)));
+			out.append(std::to_string(pix.x));
+			out.append("\t");
+			out.append(std::to_string(pix.y));
+			out.append("\t");
+			out.append(std::to_string(static_cast<uint32_t>(pix.ToT)));
+			out.append("\t");
+			out.append(std::to_string(static_cast<uint64_t>(pix.ToA)));
 
 			// Separate pixels with comma only inbetween the pixels
 			if (pixNum != cluster.pix.size())
 			{
-				ret.append(",");
+				out.append(",");
 			}
 		}
 
 		// Put the ; even after the last cluster
-		ret.append(";");
+		out.append(";");
 
 		// Reset variables
 		pixNum = 0;
 	}
-
-	return ret;
 }
 
 // Semicolon separated clusters
@@ -220,34 +393,345 @@ std::vector<CompactClusterType> serializer::deserialize_clusters(const std::stri
 	return clusters;
 }
 
+// Version, flags, cluster count, then packed clusters (pixel counts and 12 B pixels) or compact clusters
+void serializer::serialize_clusters_binary(const std::vector<CompactClusterType>& clusters, bool compact, std::string& out)
+{
+	size_t pixNum = 0;
+	for (const auto& cluster : clusters)
+	{
+		pixNum += cluster.pix.size();
+	}
+
+	// Worst case size, compact frame is cut to its real size at the end
+	const size_t size = compact ? (BINARY_FRAME_HEADER + (clusters.size() * (MAX_VARINT + MAX_VARINT)) + (pixNum * MAX_COMPACT_PIXEL))
+		: (BINARY_FRAME_HEADER + (clusters.size() * 4) + (pixNum * BINARY_PIXEL_BYTES));
+	out.resize(size);	// Every byte up to p is written, old content is not cleared
+	char* p = &out[0];
+
+	put_frame_header(p, compact, clusters.size());
+	p += BINARY_FRAME_HEADER;
+
+	if (compact)
+	{
+		int64_t lastToA = 0;
+
+		for (const auto& cluster : clusters)
+		{
+			put_varint(p, cluster.pix.size());
+			if (cluster.pix.empty()) continue;
+
+			// First pixel - ToA against first pixel of previous cluster (clusters are ordered in time)
+			const OnePixel& first = cluster.pix.front();
+			const int64_t firstToA = static_cast<int64_t>(first.ToA);
+			put_varint(p, zigzag(firstToA - lastToA));
+			put_le(p, first.x, 1);
+			put_le(p + 1, first.y, 1);
+			p += 2;
+			put_varint(p, clamp_tot(first.ToT));
+			lastToA = firstToA;
+
+			// Other pixels - coordinates against previous pixel, ToA against the first pixel
+			for (size_t k = 1; k < cluster.pix.size(); k++)
+			{
+				const OnePixel& pix = cluster.pix[k];
+				const OnePixel& prev = cluster.pix[k - 1];
+				put_varint(p, zigzag(static_cast<int64_t>(pix.x) - prev.x));
+				put_varint(p, zigzag(static_cast<int64_t>(pix.y) - prev.y));
+				put_varint(p, clamp_tot(pix.ToT));
+				put_varint(p, zigzag(static_cast<int64_t>(pix.ToA) - firstToA));
+			}
+		}
+
+		out.resize(static_cast<size_t>(p - out.data()));
+		return;
+	}
+
+	for (const auto& cluster : clusters)
+	{
+		put_le(p, cluster.pix.size(), 4);
+		p += 4;
+	}
+
+	for (const auto& cluster : clusters)
+	{
+		for (const auto& pix : cluster.pix)
+		{
+			put_packed_pixel(p, pix);
+			p += BINARY_PIXEL_BYTES;
+		}
+	}
+}
+
+// Reads straight from the receive buffer, sizes are checked before anything is decoded
+bool serializer::deserialize_clusters_binary(const char* data, size_t length, std::vector<CompactClusterType>& out)
+{
+	out.clear();
+
+	bool compact = false;
+	uint64_t clusterNum = 0;
+	if (get_frame_header(data, length, compact, clusterNum) == false) return false;
+
+	const char* p = data + BINARY_FRAME_HEADER;
+	const char* const end = data + length;
+
+	if (compact)
+	{
+		if (clusterNum > static_cast<uint64_t>(end - p)) return false;	// Every cluster has at least one byte
+		out.reserve(static_cast<size_t>(clusterNum));
+
+		int64_t lastToA = 0;
+		uint64_t value = 0;
+
+		for (uint64_t i = 0; i < clusterNum; i++)
+		{
+			uint64_t count = 0;
+			if (get_varint(p, end, count) == false || count > static_cast<uint64_t>(end - p)) return false;
+
+			out.emplace_back(std::vector<OnePixel>());
+			if (count == 0) continue;
+
+			std::vector<OnePixel>& pixels = out.back().pix;
+			pixels.reserve(static_cast<size_t>(count));
+
+			if (get_varint(p, end, value) == false || end - p < 2) return false;
+			const int64_t firstToA = lastToA + unzigzag(value);
+			int64_t x = static_cast<uint8_t>(p[0]);
+			int64_t y = static_cast<uint8_t>(p[1]);
+			p += 2;
+			if (get_varint(p, end, value) == false) return false;
+			pixels.emplace_back(static_cast<uint16_t>(x), static_cast<uint16_t>(y), static_cast<int>(value), static_cast<decltype(OnePixel::ToA)>(firstToA));
+			lastToA = firstToA;
+
+			for (uint64_t k = 1; k < count; k++)
+			{
+				uint64_t dx = 0, dy = 0, tot = 0, dToA = 0;
+				if (get_varint(p, end, dx) == false || get_varint(p, end, dy) == false || get_varint(p, end, tot) == false || get_varint(p, end, dToA) == false)
+					return false;
+
+				x += unzigzag(dx);
+				y += unzigzag(dy);
+				pixels.emplace_back(static_cast<uint16_t>(x), static_cast<uint16_t>(y), static_cast<int>(tot), static_cast<decltype(OnePixel::ToA)>(firstToA + unzigzag(dToA)));
+			}
+		}
+
+		return true;
+	}
+
+	if (clusterNum > static_cast<uint64_t>(end - p) / 4) return false;
+
+	const char* counts = p;
+	p += clusterNum * 4;
+
+	uint64_t pixNum = 0;
+	for (uint64_t i = 0; i < clusterNum; i++)
+	{
+		pixNum += get_le(counts + (i * 4), 4);
+	}
+	if (pixNum > static_cast<uint64_t>(end - p) / BINARY_PIXEL_BYTES) return false;
+
+	out.reserve(static_cast<size_t>(clusterNum));
+
+	for (uint64_t i = 0; i < clusterNum; i++)
+	{
+		const size_t count = static_cast<size_t>(get_le(counts + (i * 4), 4));
+		out.emplace_back(std::vector<OnePixel>());
+		std::vector<OnePixel>& pixels = out.back().pix;
+		pixels.reserve(count);
+
+		for (size_t k = 0; k < count; k++)
+		{
+			pixels.emplace_back(get_packed_pixel(p));
+			p += BINARY_PIXEL_BYTES;
+		}
+	}
+
+	return true;
+}
+
+// Version, flags, pixel count, then 12 B pixels or compact pixels
+void serializer::serialize_pixels_binary(const std::vector<OnePixel>& pixels, bool compact, std::string& out)
+{
+	const size_t size = BINARY_FRAME_HEADER + (pixels.size() * (compact ? MAX_COMPACT_PIXEL : BINARY_PIXEL_BYTES));
+	out.resize(size);
+	char* p = &out[0];
+
+	put_frame_header(p, compact, pixels.size());
+	p += BINARY_FRAME_HEADER;
+
+	if (compact)
+	{
+		// Everything against previous pixel - pixels of one cluster mostly follow each other
+		int64_t lastX = 0, lastY = 0, lastToA = 0;
+
+		for (const auto& pix : pixels)
+		{
+			put_varint(p, zigzag(static_cast<int64_t>(pix.x) - lastX));
+			put_varint(p, zigzag(static_cast<int64_t>(pix.y) - lastY));
+			put_varint(p, clamp_tot(pix.ToT));
+			put_varint(p, zigzag(static_cast<int64_t>(pix.ToA) - lastToA));
+			lastX = pix.x;
+			lastY = pix.y;
+			lastToA = static_cast<int64_t>(pix.ToA);
+		}
+
+		out.resize(static_cast<size_t>(p - out.data()));
+		return;
+	}
+
+	for (const auto& pix : pixels)
+	{
+		put_packed_pixel(p, pix);
+		p += BINARY_PIXEL_BYTES;
+	}
+}
+
+bool serializer::deserialize_pixels_binary(const char* data, size_t length, std::vector<OnePixel>& out)
+{
+	out.clear();
+
+	bool compact = false;
+	uint64_t pixNum = 0;
+	if (get_frame_header(data, length, compact, pixNum) == false) return false;
+
+	const char* p = data + BINARY_FRAME_HEADER;
+	const char* const end = data + length;
+
+	if (pixNum > static_cast<uint64_t>(end - p) / (compact ? 4 : BINARY_PIXEL_BYTES)) return false;	// Compact pixel has at least 4 B
+	out.reserve(static_cast<size_t>(pixNum));
+
+	if (compact)
+	{
+		int64_t x = 0, y = 0, ToA = 0;
+
+		for (uint64_t i = 0; i < pixNum; i++)
+		{
+			uint64_t dx = 0, dy = 0, tot = 0, dToA = 0;
+			if (get_varint(p, end, dx) == false || get_varint(p, end, dy) == false || get_varint(p, end, tot) == false || get_varint(p, end, dToA) == false)
+				return false;
+
+			x += unzigzag(dx);
+			y += unzigzag(dy);
+			ToA += unzigzag(dToA);
+			out.emplace_back(static_cast<uint16_t>(x), static_cast<uint16_t>(y), static_cast<int>(tot), static_cast<decltype(OnePixel::ToA)>(ToA));
+		}
+
+		return true;
+	}
+
+	for (uint64_t i = 0; i < pixNum; i++)
+	{
+		out.emplace_back(get_packed_pixel(p));
+		p += BINARY_PIXEL_BYTES;
+	}
+
+	return true;
+}
+
+// Version, flags, pixel count, then x and y bytes or compact sorted pixel indexes
+void serializer::serialize_pixel_counts_binary(const std::vector<OnePixelCount>& pixelCounts, bool compact, std::string& out)
+{
+	const size_t size = BINARY_FRAME_HEADER + (pixelCounts.size() * (compact ? 3 : 2));
+	out.resize(size);
+	char* p = &out[0];
+
+	put_frame_header(p, compact, pixelCounts.size());
+	p += BINARY_FRAME_HEADER;
+
+	if (compact)
+	{
+		// Only counts matter, not the order - sorted pixel indexes (x * 256 + y) give small gaps, repeated pixel is 0
+		std::vector<uint16_t> indexes;
+		indexes.reserve(pixelCounts.size());
+		for (const auto& pix : pixelCounts)
+		{
+			indexes.push_back(static_cast<uint16_t>(((pix.x & 0xFF) << 8) | (pix.y & 0xFF)));
+		}
+		std::sort(indexes.begin(), indexes.end());
+
+		uint16_t last = 0;
+		for (const uint16_t index : indexes)
+		{
+			put_varint(p, index - last);
+			last = index;
+		}
+
+		out.resize(static_cast<size_t>(p - out.data()));
+		return;
+	}
+
+	for (const auto& pix : pixelCounts)
+	{
+		put_le(p, pix.x, 1);
+		put_le(p + 1, pix.y, 1);
+		p += 2;
+	}
+}
+
+bool serializer::deserialize_pixel_counts_binary(const char* data, size_t length, std::vector<OnePixelCount>& out)
+{
+	out.clear();
+
+	bool compact = false;
+	uint64_t pixNum = 0;
+	if (get_frame_header(data, length, compact, pixNum) == false) return false;
+
+	const char* p = data + BINARY_FRAME_HEADER;
+	const char* const end = data + length;
+
+	if (pixNum > static_cast<uint64_t>(end - p) / (compact ? 1 : 2)) return false;
+	out.reserve(static_cast<size_t>(pixNum));
+
+	if (compact)
+	{
+		uint64_t index = 0;
+
+		for (uint64_t i = 0; i < pixNum; i++)
+		{
+			uint64_t gap = 0;
+			if (get_varint(p, end, gap) == false) return false;
+
+			index += gap;
+			out.emplace_back(static_cast<uint16_t>((index >> 8) & 0xFF), static_cast<uint16_t>(index & 0xFF));
+		}
+
+		return true;
+	}
+
+	for (uint64_t i = 0; i < pixNum; i++)
+	{
+		out.emplace_back(static_cast<uint16_t>(static_cast<uint8_t>(p[0])), static_cast<uint16_t>(static_cast<uint8_t>(p[1])));
+		p += 2;
+	}
+
+	return true;
+}
+
 // Comma ',' separated pixels
 // \t separated elements of pixel
 // Semicolon ';' after the last pixel - ignored, only as a size reference
 // Comma ',' even after the last pixel (before semicolon) - to tell last pixel
-std::string serializer::serialize_pixels(const std::vector<OnePixel>& pixels)
+void serializer::serialize_pixels(const std::vector<OnePixel>& pixels, std::string& out)
 {
-	std::string ret;
+	out.clear();
 	size_t pixNum = 0;
 
 	for (const auto& pix : pixels)
 	{
 		pixNum++;
-		ret.append(std::to_string(pix.x));
-		ret.append("\t");
-		ret.append(std::to_string(pix.y));
-		ret.append("\t");
-		ret.append(std::to_string(static_cast<uint32_t>(pix.ToT)));
-		ret.append("\t");
-		ret.append(std::to_string(static_cast<uint64_t>(pix.ToA)));
+		out.append(std::to_string(pix.x));
+		out.append("\t");
+		out.append(std::to_string(pix.y));
+		out.append("\t");
+		out.append(std::to_string(static_cast<uint32_t>(pix.ToT)));
+		out.append("\t");
+		out.append(std::to_string(static_cast<uint64_t>(pix.ToA)));
 
 		// Separate pixels with comma
-		ret.append(",");
+		out.append(",");
 	}
 
 	// Put the ; after last pixel
-	ret.append(";");
-
-	return ret;
+	out.append(";");
 }
 
 std::vector<OnePixel> serializer::deserialize_pixels(const std::string& input)
@@ -310,25 +794,23 @@ std::vector<OnePixel> serializer::deserialize_pixels(const std::string& input)
 	return pixels;
 }
 
-std::string serializer::serialize_pixel_counts(const std::vector<OnePixelCount>& pixelCounts)
+void serializer::serialize_pixel_counts(const std::vector<OnePixelCount>& pixelCounts, std::string& out)
 {
-	std::string ret;
+	out.clear();
 	size_t pixNum = 0;
 
 	for (const auto& pix : pixelCounts)
 	{
 		pixNum++;
-		ret.append(std::to_string(pix.x));
-		ret.append("\t");
-		ret.append(std::to_string(pix.y));
+		out.append(std::to_string(pix.x));
+		out.append("\t");
+		out.append(std::to_string(pix.y));
 		// Separate pixels with comma
-		ret.append(",");
+		out.append(",");
 	}
 
 	// Put the ; after last pixel
-	ret.append(";");
-
-	return ret;
+	out.append(";");
 }
 
 std::vector<OnePixelCount> serializer::deserialize_pixel_counts(const std::string& input)
@@ -381,24 +863,22 @@ std::vector<OnePixelCount> serializer::deserialize_pixel_counts(const std::strin
 	return pixelCounts;
 }
 
-std::string serializer::serialize_histograms(const std::vector<uint16_t>& histograms, size_t pixel_count)
+void serializer::serialize_histograms(const std::vector<uint16_t>& histograms, size_t pixel_count, std::string& out)
 {
-	std::string ret;
+	out.clear();
 
-	ret.append(std::to_string(pixel_count));
-	ret.append(",");
+	out.append(std::to_string(pixel_count));
+	out.append(",");
 
 	for (const auto& energy : histograms)
 	{
-		ret.append(std::to_string(energy));
+		out.append(std::to_string(energy));
 		// Separate pixels with comma
-		ret.append(",");
+		out.append(",");
 	}
 
 	// Put the ; after last pixel
-	ret.append(";");
-
-	return ret;
+	out.append(";");
 }
 
 std::vector<uint16_t> serializer::deserialize_histograms(const std::string& input, size_t& out_pixel_count)
@@ -465,6 +945,22 @@ std::string serializer::serialize_params(ClusteringParamsOnline params)
 	ret.append(std::to_string(params.clusterFilterSize));
 	ret.append(",");
 	ret.append(std::to_string((params.filterBiggerClusters ? 1 : 0)));
+	ret.append(",");
+	ret.append(std::to_string(params.backpressure));
+	ret.append(",");
+	ret.append(std::to_string(params.sampleEvery));
+	ret.append(",");
+	ret.append(std::to_string(params.highWatermark));
+	ret.append(",");
+	ret.append(std::to_string(params.lowWatermark));
+	ret.append(",");
+	ret.append(std::to_string(params.threads));
+	ret.append(",");
+	ret.append(std::to_string(params.wireFormat));
+	ret.append(",");
+	ret.append(std::to_string(params.sendBatchBytes));
+	ret.append(",");
+	ret.append(std::to_string(params.sendMaxLatency));
 	ret.append(",");	// column even after last parameter for robust deserialization
 
 	// Put the ; after last param
@@ -507,9 +1003,61 @@ ClusteringParamsOnline serializer::deserialize_params(std::string input)
 	ret.clusterFilterSize = std::atoi(temp.c_str());
 
 	end_par = input.find(',', offset);
-	temp = input.substr(offset, end_frame - offset);
+	temp = input.substr(offset, end_par - offset);
 	offset = end_par + 1;
 	ret.filterBiggerClusters = (std::atoi(temp.c_str()) == 1) ? true : false;
 
+	// Backpressure parameters - older versions dont send them, they stay 0 (defaults are set by the device)
+	if (offset >= end_frame) return ret;
+
+	end_par = input.find(',', offset);
+	temp = input.substr(offset, end_par - offset);
+	offset = end_par + 1;
+	ret.backpressure = std::atoi(temp.c_str());
+
+	end_par = input.find(',', offset);
+	temp = input.substr(offset, end_par - offset);
+	offset = end_par + 1;
+	ret.sampleEvery = std::atoi(temp.c_str());
+
+	end_par = input.find(',', offset);
+	temp = input.substr(offset, end_par - offset);
+	offset = end_par + 1;
+	ret.highWatermark = std::atoll(temp.c_str());
+
+	end_par = input.find(',', offset);
+	temp = input.substr(offset, end_par - offset);
+	offset = end_par + 1;
+	ret.lowWatermark = std::atoll(temp.c_str());
+
+	// Clustering threads - not sent by older versions either
+	if (offset >= end_frame) return ret;
+
+	end_par = input.find(',', offset);
+	temp = input.substr(offset, end_par - offset);
+	offset = end_par + 1;
+	ret.threads = std::atoi(temp.c_str());
+
+	// Wire format - older versions know only text
+	if (offset >= end_frame) return ret;
+
+	end_par = input.find(',', offset);
+	temp = input.substr(offset, end_par - offset);
+	offset = end_par + 1;
+	ret.wireFormat = std::atoi(temp.c_str());
+
+	// Send batching - older versions leave it to the device
+	if (offset >= end_frame) return ret;
+
+	end_par = input.find(',', offset);
+	temp = input.substr(offset, end_par - offset);
+	offset = end_par + 1;
+	ret.sendBatchBytes = std::atoll(temp.c_str());
+
+	end_par = input.find(',', offset);
+	temp = input.substr(offset, end_par - offset);
+	offset = end_par + 1;
+	ret.sendMaxLatency = std::atoi(temp.c_str());
+
 	return ret;
 }
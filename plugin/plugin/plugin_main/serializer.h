@@ -14,6 +14,8 @@
   *
   * */
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include "cluster_definition.h"
@@ -28,7 +30,19 @@ enum dataframe_types
 	errors,
 	command,
 	config,
-	acknowledge
+	acknowledge,
+	clusters_binary,
+	pixels_binary,
+	pixel_counts_binary
+};
+
+/* One frame parsed from received bytes - data points behind the header, into the receive buffer */
+struct frame_view
+{
+	dataframe_types type;
+	uint8_t flags;
+	const char* data;	// Payload
+	size_t length;		// Bytes of payload
 };
 
 
@@ -43,35 +57,98 @@ enum dataframe_types
    * 'K' - command (to client)
    * 'V' - config - should get acknowledge
    * 'A' - acknowledge (from client)
+   * 'B' - binary cluster frame		- binary frames only when client asked for them in config (wire_format)
+   * 'Q' - binary pixel frame
+   * 'R' - binary pixel_counts frame
+   */
+
+  /*
+   * Frame headers, receiver tells them by the first byte:
+   *   text:	"C#length;" - type letter, decimal length of the whole frame (header included)
+   *   binary:	BINARY_HEADER_BYTES bytes - uint8 HEADER_MAGIC (0xA5), char type letter, uint8 flags, uint8 reserved, uint32 payload length (little-endian)
+   * Plugin sends binary headers only to client which asked for binary frames in config (wire_format), before that
+   * and for older clients headers stay text. Client parses both.
+   */
+
+  /*
+   * Binary frames (payload after the frame header), all numbers little-endian:
+   *   uint8 version, uint8 flags, uint16 reserved, uint32 count (clusters/pixels)
+   * Packed (flags 0, wire_binary):
+   *   clusters:		uint32 pixel count of every cluster, then pixels of all clusters in order
+   *   pixels:			12 B each - uint8 x, uint8 y, uint16 ToT, int64 ToA (ns)
+   *   pixel_counts:	uint8 x, uint8 y
+   * Compact (FRAME_FLAG_COMPACT, wire_compact) - LEB128 varints, signed deltas zigzag coded:
+   *   clusters:		per cluster: pixel count, ToA of first pixel - ToA of first pixel of previous cluster,
+   *					x and y bytes and ToT of first pixel, then per other pixel: x and y - previous pixel, ToT, ToA - first pixel
+   *   pixels:			x - previous, y - previous, ToT, ToA - previous
+   *   pixel_counts:	pixels sorted by index (x * 256 + y), gap to previous index
+   * Decoder refuses other versions and unknown flags, so the layout can change only with a new version or flag.
    */
 
 class serializer
 {
 public:
+	static const uint8_t HEADER_MAGIC = 0xA5;	// Never a type letter of text header
+	static const size_t BINARY_HEADER_BYTES = 8;	// Bytes of binary header
+	static const size_t MAX_TEXT_HEADER_BYTES = 23;	// Type, '#', 20 digits, ';'
+
 	// Attach message header
 	static void attach_header(std::string& input, dataframe_types type);
 
+	// Attach binary header (BINARY_HEADER_BYTES bytes)
+	static void attach_frame_header(std::string& input, dataframe_types type);
+
+	// Write binary header of frame with length bytes of payload into out (BINARY_HEADER_BYTES bytes)
+	static void put_header(char* out, dataframe_types type, size_t length);
+
+	// Write text header of frame with length bytes of payload into out (at most MAX_TEXT_HEADER_BYTES), returns its size
+	static size_t put_text_header(char* out, dataframe_types type, size_t length);
+
+	// Parse header (text or binary) at start of available bytes into type, flags and length of frame (data are not set).
+	// Returns size of the header, 0 when more bytes are needed, -1 when data do not start with a header
+	static int parse_header(const char* data, size_t available, frame_view& frame);
+
 	// Deattach message header
 	static void deattach_header(std::string& input);
 
 	// Get type from message
 	static dataframe_types get_type(const std::string& message);
 
+	// Length of message header (0 if there is none) - binary payload is decoded right after it, without erasing the header
+	static size_t header_size(const std::string& message);
+
+	// Data serializers overwrite out and keep its capacity - a reused buffer does not allocate again
+
 	// Semicolon separated clusters
 	// Comma separated pixels
 	// \t separated elements of pixel
-	static std::string serialize_clusters(const std::vector<CompactClusterType>& clusters);
+	static void serialize_clusters(const std::vector<CompactClusterType>& clusters, std::string& out);
 
 	// Semicolon separated clusters
 	// Comma separated pixels
 	// \t separated elements of pixel
 	static std::vector<CompactClusterType> deserialize_clusters(const std::string& input);
 
+	static const uint8_t BINARY_FRAME_VERSION = 1;
+	static const uint8_t FRAME_FLAG_COMPACT = 0x01;	// Delta and varint coded
+	static const size_t BINARY_FRAME_HEADER = 8;	// Bytes before the data
+	static const size_t BINARY_PIXEL_BYTES = 12;	// Bytes of one packed pixel
+
+	// Binary frames, see above - compact or packed
+	static void serialize_clusters_binary(const std::vector<CompactClusterType>& clusters, bool compact, std::string& out);
+	static void serialize_pixels_binary(const std::vector<OnePixel>& pixels, bool compact, std::string& out);
+	static void serialize_pixel_counts_binary(const std::vector<OnePixelCount>& pixelCounts, bool compact, std::string& out);
+
+	// Decode binary frame of length bytes at data into out (cleared first). Returns false for other version or broken frame
+	static bool deserialize_clusters_binary(const char* data, size_t length, std::vector<CompactClusterType>& out);
+	static bool deserialize_pixels_binary(const char* data, size_t length, std::vector<OnePixel>& out);
+	static bool deserialize_pixel_counts_binary(const char* data, size_t length, std::vector<OnePixelCount>& out);
+
 	// Comma ',' separated pixels
 	// \t separated elements of pixel
 	// Semicolon ';' after the last pixel - ignored, only as a size reference
 	// Comma ',' even after the last pixel (before semicolon) - to tell last pixel
-	static std::string serialize_pixels(const std::vector<OnePixel>& pixels);
+	static void serialize_pixels(const std::vector<OnePixel>& pixels, std::string& out);
 
 	// Comma ',' separated pixels
 	// \t separated elements of pixel
@@ -82,7 +159,7 @@ public:
 	// \t separated elements of pixel
 	// Semicolon ';' after the last pixel - ignored, only as a size reference
 	// Comma ',' even after the last pixel (before semicolon) - to tell last pixel
-	static std::string serialize_pixel_counts(const std::vector<OnePixelCount>& pixelCounts);
+	static void serialize_pixel_counts(const std::vector<OnePixelCount>& pixelCounts, std::string& out);
 
 	// Comma ',' separated pixels
 	// \t separated elements of pixel
@@ -90,7 +167,7 @@ public:
 	static std::vector<OnePixelCount> deserialize_pixel_counts(const std::string& input);
 
 	// TODO: Design this function also
-	static std::string serialize_histograms(const std::vector<uint16_t>& histograms, size_t pixel_count);
+	static void serialize_histograms(const std::vector<uint16_t>& histograms, size_t pixel_count, std::string& out);
 
 	// TODO: Design this functions also
 	static std::vector<uint16_t> deserialize_histograms(const std::string& input, size_t& out_pixel_count);
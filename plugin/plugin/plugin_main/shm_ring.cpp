@@ -0,0 +1,235 @@
+/**
+ * @shm_ring.cpp
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+
+#include <shm_ring.h>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const uint32_t shm_ring::MAGIC;
+const uint32_t shm_ring::VERSION;
+const size_t shm_ring::WORD_BYTES;
+const size_t shm_ring::DATA_OFFSET;
+
+static_assert(sizeof(shm_ring::header) <= shm_ring::DATA_OFFSET, "shm_ring header does not fit before data");
+
+bool shm_ring::create(const char* name, size_t capacity)
+{
+	close();
+
+	capacity -= capacity % WORD_BYTES;
+	if (capacity == 0 || strlen(name) >= sizeof(name_)) return false;
+
+	unlink(name);	// Consumer still attached to the old ring keeps its own mapping
+	int fd = open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0666);
+	if (fd < 0) return false;
+
+	const size_t size = DATA_OFFSET + capacity;
+	if (ftruncate(fd, static_cast<off_t>(size)) < 0)
+	{
+		::close(fd);
+		unlink(name);
+		return false;
+	}
+
+	void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mem == MAP_FAILED)
+	{
+		unlink(name);
+		return false;
+	}
+
+	// New object is zero filled - counters start at 0, magic is written last
+	hdr_ = static_cast<header*>(mem);
+	data_ = static_cast<char*>(mem) + DATA_OFFSET;
+	mapped_ = size;
+	owner_ = true;
+	strncpy(name_, name, sizeof(name_) - 1);
+
+	hdr_->version = VERSION;
+	hdr_->capacity = capacity;
+	std::atomic_thread_fence(std::memory_order_release);
+	hdr_->magic = MAGIC;
+
+	return true;
+}
+
+bool shm_ring::attach(const char* name)
+{
+	int fd = open(name, O_RDWR | O_CLOEXEC);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) <= DATA_OFFSET)
+	{
+		::close(fd);
+		return false;
+	}
+
+	const size_t size = static_cast<size_t>(st.st_size);
+	void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mem == MAP_FAILED) return false;
+
+	header* hdr = static_cast<header*>(mem);
+	if (hdr->magic != MAGIC || hdr->version != VERSION || hdr->capacity == 0 || (hdr->capacity % WORD_BYTES) != 0 || DATA_OFFSET + hdr->capacity > size)
+	{
+		munmap(mem, size);
+		return false;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	close();
+	hdr_ = hdr;
+	data_ = static_cast<char*>(mem) + DATA_OFFSET;
+	mapped_ = size;
+	owner_ = false;
+	dev_ = st.st_dev;
+	ino_ = st.st_ino;
+
+	return true;
+}
+
+bool shm_ring::is_replaced(const char* name) const
+{
+	// Attached file keeps its inode while it is mapped, so a new file cannot get the same one
+	struct stat st;
+	if (stat(name, &st) < 0) return false;	// Not created again yet
+
+	return st.st_dev != dev_ || st.st_ino != ino_;
+}
+
+void shm_ring::close()
+{
+	if (hdr_ == nullptr) return;
+
+	if (owner_)
+	{
+		unlink(name_);
+		hdr_->closed.store(1, std::memory_order_release);
+		wake_consumer();
+	}
+	munmap(hdr_, mapped_);
+
+	hdr_ = nullptr;
+	data_ = nullptr;
+	mapped_ = 0;
+	owner_ = false;
+	dev_ = 0;
+	ino_ = 0;
+}
+
+size_t shm_ring::write(const char* data, size_t length, bool block)
+{
+	const uint64_t capacity = hdr_->capacity;
+	length -= length % WORD_BYTES;
+	size_t written = 0;
+
+	while (written < length)
+	{
+		const size_t space = writable();
+		if (space == 0)
+		{
+			if (block == false) break;
+
+			// Sleep until consumer frees some space, check again after announcing it
+			const uint32_t seq = hdr_->space_seq.load(std::memory_order_acquire);
+			hdr_->producer_sleeping.store(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (writable() == 0) futex_wait(hdr_->space_seq, seq, 100);
+			hdr_->producer_sleeping.store(0, std::memory_order_relaxed);
+			continue;
+		}
+
+		const uint64_t head = hdr_->head.load(std::memory_order_relaxed);
+		const size_t pos = static_cast<size_t>(head % capacity);
+		const size_t n = std::min(std::min(length - written, space), static_cast<size_t>(capacity) - pos);
+
+		memcpy(data_ + pos, data + written, n);
+		hdr_->head.store(head + n, std::memory_order_release);
+		written += n;
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (hdr_->consumer_sleeping.load(std::memory_order_relaxed)) wake_consumer();
+	}
+
+	if (written < length) hdr_->lost.fetch_add((length - written) / WORD_BYTES, std::memory_order_relaxed);
+
+	return written;
+}
+
+const char* shm_ring::peek(size_t& length) const
+{
+	const size_t avail = readable();
+	if (avail == 0)
+	{
+		length = 0;
+		return nullptr;
+	}
+
+	const size_t pos = static_cast<size_t>(hdr_->tail.load(std::memory_order_relaxed) % hdr_->capacity);
+	length = std::min(avail, static_cast<size_t>(hdr_->capacity) - pos);
+	return data_ + pos;
+}
+
+void shm_ring::consume(size_t length)
+{
+	hdr_->tail.store(hdr_->tail.load(std::memory_order_relaxed) + length, std::memory_order_release);
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (hdr_->producer_sleeping.load(std::memory_order_relaxed))
+	{
+		hdr_->space_seq.fetch_add(1, std::memory_order_release);
+		futex_wake(hdr_->space_seq);
+	}
+}
+
+void shm_ring::consume_all()
+{
+	consume(readable());
+}
+
+bool shm_ring::wait_data(int timeout_ms)
+{
+	if (readable() > 0) return true;
+
+	// Announce sleeping, then check again - producer either sees it or its data are seen here
+	const uint32_t seq = hdr_->data_seq.load(std::memory_order_acquire);
+	hdr_->consumer_sleeping.store(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (readable() == 0) futex_wait(hdr_->data_seq, seq, timeout_ms);
+	hdr_->consumer_sleeping.store(0, std::memory_order_relaxed);
+
+	return readable() > 0;
+}
+
+void shm_ring::wake_consumer()
+{
+	hdr_->data_seq.fetch_add(1, std::memory_order_release);
+	futex_wake(hdr_->data_seq);
+}
+
+// Futex is shared between processes (not FUTEX_PRIVATE), returns right away when word changed meanwhile
+void shm_ring::futex_wait(std::atomic<uint32_t>& word, uint32_t value, int timeout_ms)
+{
+	struct timespec ts;
+	ts.tv_sec = timeout_ms / 1000;
+	ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, value, &ts, nullptr, 0);
+}
+
+void shm_ring::futex_wake(std::atomic<uint32_t>& word)
+{
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
@@ -0,0 +1,141 @@
+/**
+ * @shm_ring.h
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+
+#ifndef PLUGIN_MAIN_SHM_RING_H_
+#define PLUGIN_MAIN_SHM_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#error "shm_ring needs lock-free 64 bit atomics, they are shared between processes"
+#endif
+
+/* Ring buffer of readout words in shared memory (/dev/shm), between readout process (producer) and plugin (consumer)
+ *
+ * Producer copies words right into the mapped ring and publishes them by moving head, consumer decodes them
+ * in place and frees them by moving tail - no syscall per batch and no copy through the kernel.
+ * head and tail count bytes since creation, position in data is (head % capacity). Capacity is a multiple
+ * of the word size and only whole words are written, so a word never wraps around the end of data.
+ * Side which has nothing to do sleeps on a futex in the shared header, the other side wakes it only when
+ * it announced it is sleeping - so there is no syscall while both sides are busy. */
+/* ONLY one writer PROCESS (thread) and one reader PROCESS (thread) */
+class shm_ring
+{
+public:
+	static const uint32_t MAGIC = 0x474E524B;	// "KRNG"
+	static const uint32_t VERSION = 1;
+	static const size_t WORD_BYTES = 6;
+
+	struct header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t capacity;					// Bytes of data, multiple of WORD_BYTES
+		std::atomic<uint32_t> closed;		// Producer closed the ring, consumer should look for a new one
+
+		alignas(64) std::atomic<uint64_t> head;		// Written by producer
+		std::atomic<uint64_t> lost;					// Words producer could not write (ring full)
+		std::atomic<uint32_t> data_seq;				// Futex word of sleeping consumer
+		std::atomic<uint32_t> consumer_sleeping;
+
+		alignas(64) std::atomic<uint64_t> tail;		// Written by consumer
+		std::atomic<uint32_t> space_seq;			// Futex word of sleeping producer
+		std::atomic<uint32_t> producer_sleeping;
+	};
+
+	static const size_t DATA_OFFSET = 256;	// Data start after the header
+
+	shm_ring() {};
+	~shm_ring()
+	{
+		close();
+	};
+
+	shm_ring(const shm_ring&) = delete;
+	shm_ring& operator=(const shm_ring&) = delete;
+
+	/* Producer: create (or replace) the ring file (in /dev/shm) with capacity rounded down to whole words. Returns false on error */
+	bool create(const char* name, size_t capacity);
+
+	/* Consumer: attach to ring created by producer. Returns false if there is none (or it is not valid), ring attached before is kept then */
+	bool attach(const char* name);
+
+	/* Consumer: name is now a different ring than the attached one - producer crashed (ring never closed) and a new one created it again */
+	bool is_replaced(const char* name) const;
+
+	/* Unmap, producer also marks the ring closed and removes the name */
+	void close();
+
+	bool is_open() const
+	{
+		return hdr_ != nullptr;
+	}
+
+	/* Producer: copy whole words of data into the ring, returns bytes written (less when ring is full).
+	 * With block the producer sleeps until the consumer frees space, otherwise words not written are counted as lost */
+	size_t write(const char* data, size_t length, bool block);
+
+	/* Producer: consumer has read everything written */
+	bool empty() const
+	{
+		return readable() == 0;
+	}
+
+	/* Producer: words not written since creation */
+	uint64_t lost() const
+	{
+		return hdr_->lost.load(std::memory_order_relaxed);
+	}
+
+	/* Consumer: producer closed the ring (readout process exited or restarted) */
+	bool producer_closed() const
+	{
+		return hdr_->closed.load(std::memory_order_acquire) != 0;
+	}
+
+	/* Consumer: contiguous readable bytes at tail (whole words, up to the end of data), nullptr when empty */
+	const char* peek(size_t& length) const;
+
+	/* Consumer: words of length bytes from peek() were processed, give the space back */
+	void consume(size_t length);
+
+	/* Consumer: throw away everything readable */
+	void consume_all();
+
+	/* Consumer: sleep until there are data or timeout. Returns true if there are data */
+	bool wait_data(int timeout_ms);
+
+	/* Producer: wake the sleeping consumer (close). Only the thread which attached the ring may touch it */
+	void wake_consumer();
+
+private:
+	header* hdr_ = nullptr;
+	char* data_ = nullptr;
+	size_t mapped_ = 0;
+	bool owner_ = false;
+	char name_[128] = {0};
+	dev_t dev_ = 0;		// File of the attached ring, name can be replaced by a new one
+	ino_t ino_ = 0;
+
+	size_t readable() const
+	{
+		return static_cast<size_t>(hdr_->head.load(std::memory_order_acquire) - hdr_->tail.load(std::memory_order_relaxed));
+	}
+
+	size_t writable() const
+	{
+		return static_cast<size_t>(hdr_->capacity - (hdr_->head.load(std::memory_order_relaxed) - hdr_->tail.load(std::memory_order_acquire)));
+	}
+
+	static void futex_wait(std::atomic<uint32_t>& word, uint32_t value, int timeout_ms);
+	static void futex_wake(std::atomic<uint32_t>& word);
+};
+
+#endif /* PLUGIN_MAIN_SHM_RING_H_ */
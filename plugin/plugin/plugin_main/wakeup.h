@@ -0,0 +1,134 @@
+/**
+ * @wakeup.h
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+
+#ifndef PLUGIN_MAIN_WAKEUP_H_
+#define PLUGIN_MAIN_WAKEUP_H_
+
+#include <atomic>
+#include <cstdint>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/* Wakeup of a thread waiting for data from other thread (eventfd based)
+ *
+ * Waiter first spins for a while checking its condition (spin budget adapts - grows when data came while
+ * spinning, shrinks when it did not), then it marks itself sleeping and blocks on the eventfd.
+ * notify() costs only a fence and a load while nobody sleeps, eventfd is written only for a sleeping waiter.
+ * Waiter checks its condition again after marking itself sleeping, so no notification is lost. */
+/* ONLY one waiting THREAD */
+class wakeup
+{
+public:
+	wakeup()
+	{
+		fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	};
+
+	~wakeup()
+	{
+		if (fd_ >= 0) close(fd_);
+	};
+
+	wakeup(const wakeup&) = delete;
+	wakeup& operator=(const wakeup&) = delete;
+
+	/* Producer: call after the data were published */
+	void notify()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleeping_.load(std::memory_order_relaxed)) signal();
+	}
+
+	/* Producer: post an event for wait(timeout_ms) */
+	void post()
+	{
+		posted_.store(true, std::memory_order_release);
+		notify();
+	}
+
+	/* Any thread: wake the waiter unconditionally (stop etc.) */
+	void signal()
+	{
+		const uint64_t one = 1;
+		ssize_t res = write(fd_, &one, sizeof(one));
+		(void) res;	// Counter can only overflow after 2^64 - 2 signals
+	}
+
+	/* Waiter: spin, then sleep until ready() is true, notify() or timeout. Returns whether ready() was seen true */
+	template <typename Ready>
+	bool wait(Ready ready, int timeout_ms)
+	{
+		for (uint32_t i = 0; i < spin_; i++)
+		{
+			if (ready())
+			{
+				if (spin_ < MAX_SPIN) spin_ *= 2;	// Data come quickly - spin longer next time
+				return true;
+			}
+			cpu_relax();
+		}
+		if (spin_ > MIN_SPIN) spin_ /= 2;
+
+		sleeping_.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		// Result is latched - ready() may consume the event (wait(int)), it must not be asked twice for one event
+		bool ok = ready();
+		if (ok == false)
+		{
+			pollfd pfd = {fd_, POLLIN, 0};
+			poll(&pfd, 1, timeout_ms);
+		}
+
+		sleeping_.store(false, std::memory_order_relaxed);
+		drain();
+
+		if (ok == false) ok = ready();
+		return ok;
+	}
+
+	/* Waiter: wait for post() */
+	bool wait(int timeout_ms)
+	{
+		return wait([this] { return posted_.exchange(false, std::memory_order_acquire); }, timeout_ms);
+	}
+
+	/* File descriptor readable after signal(), for poll() together with other descriptors */
+	int fd() const
+	{
+		return fd_;
+	}
+
+	/* Reset the eventfd counter after it was polled */
+	void drain()
+	{
+		uint64_t count = 0;
+		ssize_t res = read(fd_, &count, sizeof(count));
+		(void) res;	// EAGAIN when there was no signal
+	}
+
+private:
+	static const uint32_t MIN_SPIN = 16;
+	static const uint32_t MAX_SPIN = 4096;
+
+	int fd_ = -1;
+	std::atomic<bool> sleeping_{false};
+	std::atomic<bool> posted_{false};
+	uint32_t spin_ = MIN_SPIN;	// Only waiter touches it
+
+	static void cpu_relax()
+	{
+#if defined(__arm__) || defined(__aarch64__)
+		__asm__ __volatile__("yield");
+#elif defined(__i386__) || defined(__x86_64__)
+		__builtin_ia32_pause();
+#endif
+	}
+};
+
+#endif /* PLUGIN_MAIN_WAKEUP_H_ */
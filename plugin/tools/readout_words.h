@@ -0,0 +1,56 @@
+/**
+ * @readout_words.h
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+
+#ifndef PLUGIN_TOOLS_READOUT_WORDS_H_
+#define PLUGIN_TOOLS_READOUT_WORDS_H_
+
+#include <katherine_readout.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* Encoding of Katherine readout words for the test tools - inverse of katherine_readout decoding */
+namespace readout_words
+{
+	inline void put_word(std::vector<char>& out, uint64_t word)
+	{
+		char bytes[sizeof(uint64_t)];
+		memcpy(bytes, &word, sizeof(bytes));	// Little-endian, same as the board
+		out.insert(out.end(), bytes, bytes + katherine_readout::WORD_BYTES);
+	}
+
+	inline uint64_t control_word(uint64_t type, uint64_t value)
+	{
+		return (type << 44) | (value & 0x0FFFFFFFFFFF);
+	}
+
+	// Pixel at (x, y), coarse ToA in 25 ns ticks (lower 14 bits), ToT and fToA
+	inline uint64_t pixel_word(uint64_t x, uint64_t y, uint64_t toa, uint64_t tot, uint64_t ftoa)
+	{
+		return (static_cast<uint64_t>(katherine_readout::pixel_data) << 44) | ((y & 0xFF) << 36) | ((x & 0xFF) << 28)
+			| ((toa & 0x3FFF) << 14) | ((tot & 0x3FF) << 4) | (ftoa & 0xF);
+	}
+
+	// Split ToA in ns into 25 ns ticks and fToA (ToA = ticks * 25 - FTOA_NS[fToA]), exact up to 1 ns
+	inline void split_toa(int64_t toa, uint64_t& ticks, uint64_t& ftoa)
+	{
+		if (toa < 0) toa = 0;
+
+		ticks = static_cast<uint64_t>((toa + 24) / 25);
+		const int64_t rest = static_cast<int64_t>(ticks) * 25 - toa;
+
+		ftoa = 0;
+		for (uint64_t f = 1; f < 16; f++)
+		{
+			const int64_t diff = katherine_readout::FTOA_NS[f] - rest;
+			const int64_t best = katherine_readout::FTOA_NS[ftoa] - rest;
+			if ((diff < 0 ? -diff : diff) < (best < 0 ? -best : best)) ftoa = f;
+		}
+	}
+}
+
+#endif /* PLUGIN_TOOLS_READOUT_WORDS_H_ */
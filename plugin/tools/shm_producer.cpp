@@ -0,0 +1,108 @@
+/**
+ * @shm_producer.cpp
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+
+/* Local producer for testing the shared memory ring transport of the plugin (instead of the readout process)
+ *
+ * Creates the ring and writes one frame of synthetic readout words: frame start, pixels with time offset words
+ * and frame end. Start it before the plugin connects to the detector, plugin takes the ring instead of the fifo.
+ *
+ * Build (from plugin/tools):
+ *   g++ -std=gnu++14 -O2 -pthread -I../plugin/plugin_main -I../plugin/plugin_clustering shm_producer.cpp ../plugin/plugin_main/shm_ring.cpp ../plugin/plugin_clustering/katherine_readout.cpp -o shm_producer
+ *
+ * Usage: shm_producer [pixels] [-nonblock] [-keep]
+ *   pixels		pixel words to write (default 10000000)
+ *   -nonblock	do not wait for the plugin when ring is full, count words as lost instead (as the board does)
+ *   -keep		keep the ring until Enter is pressed, ring is removed when producer exits
+ */
+
+#include <shm_ring.h>
+#include <networking.h>
+#include "readout_words.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const size_t BATCH_WORDS = 4096;
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t pixels = 10000000;
+	bool block = true;
+	bool keep = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-nonblock") == 0) block = false;
+		else if (strcmp(argv[i], "-keep") == 0) keep = true;
+		else pixels = strtoull(argv[i], nullptr, 10);
+	}
+
+	using namespace readout_words;
+
+	shm_ring ring;
+	if (ring.create(SHM_RING_PATH, SHM_RING_SIZE) == false)
+	{
+		perror("Failed to create ring " SHM_RING_PATH);
+		return 1;
+	}
+
+	printf("Ring %s created, writing %llu pixels\n", SHM_RING_PATH, static_cast<unsigned long long>(pixels));
+	fflush(stdout);
+
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<char> batch;
+	batch.reserve((BATCH_WORDS + 2) * katherine_readout::WORD_BYTES);
+
+	put_word(batch, control_word(katherine_readout::frame_start, 0));
+
+	// Clusters of 4 neighbouring pixels, one tick apart, spread over the matrix
+	uint64_t offset = 0;
+	uint64_t ticks = 0;
+	for (uint64_t i = 0; i < pixels; i++)
+	{
+		const uint64_t cluster = i / 4;
+		const uint64_t x = ((cluster * 37) % 250) + (i % 2);
+		const uint64_t y = ((cluster * 91) % 250) + ((i / 2) % 2);
+
+		if ((ticks >> 14) != offset)
+		{
+			offset = ticks >> 14;
+			put_word(batch, control_word(katherine_readout::time_offset, offset));
+		}
+		put_word(batch, pixel_word(x, y, ticks, 10 + (i % 50), i % 16));
+		ticks += (i % 4 == 3) ? 40 : 1;
+
+		if (batch.size() >= BATCH_WORDS * katherine_readout::WORD_BYTES)
+		{
+			ring.write(batch.data(), batch.size(), block);
+			batch.clear();
+		}
+	}
+
+	put_word(batch, control_word(katherine_readout::frame_end, 0));
+	ring.write(batch.data(), batch.size(), block);
+
+	// Ring is removed on exit, plugin which did not attach yet would miss the data
+	while (ring.empty() == false) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("Done in %.3f s (%.2f MHit/s), lost words %llu\n", seconds, pixels / seconds / 1e6, static_cast<unsigned long long>(ring.lost()));
+
+	if (keep)
+	{
+		printf("Press Enter to remove the ring\n");
+		getchar();
+	}
+
+	return 0;
+}
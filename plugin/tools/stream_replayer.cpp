@@ -0,0 +1,367 @@
+/**
+ * @stream_replayer.cpp
+ * @author Richard Sivera (richsivera@gmail.com)
+ * @copyright Richard Sivera (c) 2024
+ */
+
+
+/* Replays recorded detector stream into the plugin (instead of the readout process), for load testing without hardware
+ *
+ * Input is loaded and encoded into readout words first, so replaying is only copying words and waiting:
+ *   -raw		file of raw 6 B readout words (as read from the pipe), its frame start/end words are dropped
+ *   -text		text acquisition, coord \t ToA \t fToA \t ToT lines (default)
+ *   -online	text of saved online pixels, x \t y \t ToT \t ToA(ns) lines, ToA is rounded to 1 ns
+ * Every replay of the input is one frame - synthetic frame start before it and frame end after it.
+ *
+ * Rate:
+ *   (default)		as fast as possible
+ *   -realtime S	ToA of pixels is followed, S times faster (1 when omitted)
+ *   -rate M		fixed M MHit/s
+ *
+ * Output:
+ *   -fifo		write to FIFO_PATH, created when it does not exist, waits for the plugin to open it (default)
+ *   -shm		create shared memory ring SHM_RING_PATH, start replayer before the plugin connects
+ *				(plugin reads the rest of the ring after the replayer exits)
+ *
+ * Other:
+ *   -frames N	replay the input N times (default 1)
+ *   -nonblock	do not wait when plugin cant keep up, words not written are dropped as on the board
+ *				and reported to the plugin as lost pixels before frame end
+ *
+ * Build (from plugin/tools):
+ *   g++ -std=gnu++14 -O2 -pthread -I../plugin/plugin_main -I../plugin/plugin_clustering stream_replayer.cpp ../plugin/plugin_main/shm_ring.cpp \
+ *     ../plugin/plugin_clustering/katherine_readout.cpp ../plugin/plugin_clustering/pixel_parser.cpp ../plugin/plugin_clustering/file_loader.cpp -o stream_replayer
+ *
+ * Usage: stream_replayer file [-raw | -text | -online] [-realtime [S] | -rate M] [-fifo | -shm] [-frames N] [-nonblock]
+ */
+
+#include <shm_ring.h>
+#include <networking.h>
+#include <file_loader.h>
+#include <pixel_parser.h>
+#include "readout_words.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <poll.h>
+
+namespace
+{
+	const size_t BATCH_WORDS = 682;				// Words written at once, 4092 B fits into PIPE_BUF (atomic pipe write)
+	const uint64_t PARSE_LINES = 1 << 20;		// Text lines parsed at once
+
+	enum input_format { input_raw, input_text, input_online };
+	enum rate_mode { rate_max, rate_realtime, rate_fixed };
+
+	// Part of the encoded stream written at once, with what is needed for pacing
+	struct batch
+	{
+		size_t end;				// Bytes of stream up to the end of the batch
+		uint64_t pixels;		// Pixel words up to the end of the batch
+		int64_t toa;			// Latest ToA (ns) up to the end of the batch
+	};
+
+	struct batch_handler
+	{
+		uint64_t count = 0;
+		int64_t toa = 0;
+		int64_t first_toa = 0;
+
+		void control(uint64_t, int) {};
+		void pixels(const katherine_readout::columns& cols, size_t n)
+		{
+			for (size_t k = 0; k < n; k++)
+			{
+				if (count + k == 0) first_toa = toa = cols.time[k];
+				if (cols.time[k] > toa) toa = cols.time[k];
+			}
+			count += n;
+		};
+	};
+
+	bool load_raw(const char* path, std::vector<char>& words)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (file.is_open() == false) return false;
+
+		std::vector<char> raw((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		const size_t count = raw.size() / katherine_readout::WORD_BYTES;
+
+		// Frames are made by the replayer
+		words.reserve(raw.size());
+		for (size_t i = 0; i < count; i++)
+		{
+			const char* word = raw.data() + (i * katherine_readout::WORD_BYTES);
+			const int type = katherine_readout::word_type(word);
+			if (type == katherine_readout::frame_start || type == katherine_readout::frame_end) continue;
+
+			words.insert(words.end(), word, word + katherine_readout::WORD_BYTES);
+		}
+
+		return true;
+	}
+
+	bool load_text(const char* path, pixel_parser::line_format format, std::vector<char>& words)
+	{
+		using namespace readout_words;
+
+		mapped_file input;
+		if (file_loader::mapPixelData(path, input) == false) return false;
+
+		std::vector<OnePixel> pixels;
+		volatile bool abort = false;
+		size_t offset = 0;
+		uint64_t time_offset = UINT64_MAX;
+
+		while (true)
+		{
+			pixels.clear();
+			const pixel_parser::result res = pixel_parser::parse(input.view(), offset, format, 0, pixels, abort, PARSE_LINES);
+
+			for (const OnePixel& pix : pixels)
+			{
+				uint64_t ticks = 0;
+				uint64_t ftoa = 0;
+				split_toa(pix.ToA, ticks, ftoa);
+
+				// Time offset word whenever the upper bits of the timestamp change, as the board does
+				if ((ticks >> 14) != time_offset)
+				{
+					time_offset = ticks >> 14;
+					put_word(words, control_word(katherine_readout::time_offset, time_offset));
+				}
+
+				const uint64_t tot = static_cast<uint64_t>(std::min(std::max(pix.ToT, 0), 1023));
+				put_word(words, pixel_word(pix.x, pix.y, ticks, tot, ftoa));
+			}
+
+			if (res.lines == 0 || res.cluster_marker || res.stop == offset) break;
+			offset = res.stop;
+		}
+
+		return true;
+	}
+
+	// Cut the stream into batches and decode them once, to know pixels and ToA for pacing
+	void make_batches(const std::vector<char>& words, std::vector<batch>& batches, int64_t& first_toa)
+	{
+		katherine_readout::state st;
+		katherine_readout::columns cols;
+		batch_handler handler;
+
+		const size_t count = words.size() / katherine_readout::WORD_BYTES;
+		for (size_t i = 0; i < count; i += BATCH_WORDS)
+		{
+			const size_t n = std::min(BATCH_WORDS, count - i);
+			katherine_readout::decode_words(words.data() + (i * katherine_readout::WORD_BYTES), n, st, cols, handler);
+			batches.push_back(batch{ (i + n) * katherine_readout::WORD_BYTES, handler.count, handler.toa });
+		}
+
+		first_toa = handler.first_toa;
+	}
+
+	/* Output into fifo or shared memory ring */
+	class output
+	{
+	public:
+		~output()
+		{
+			if (fd >= 0) ::close(fd);
+		}
+
+		bool open_fifo()
+		{
+			if (mkfifo(FIFO_PATH, 0666) < 0 && errno != EEXIST) return false;
+
+			printf("Waiting for the plugin to open %s\n", FIFO_PATH);
+			fflush(stdout);
+			fd = ::open(FIFO_PATH, O_WRONLY);	// Blocks until the plugin opens it for reading
+			if (fd < 0) return false;
+
+			return fcntl(fd, F_SETFL, O_NONBLOCK) == 0;
+		}
+
+		void wait_read()
+		{
+			while (ring.is_open() && ring.empty() == false) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		bool open_shm()
+		{
+			return ring.create(SHM_RING_PATH, SHM_RING_SIZE);
+		}
+
+		// Write whole batch, returns words not written (only when block is false)
+		uint64_t write(const char* data, size_t length, bool block)
+		{
+			if (ring.is_open()) return (length - ring.write(data, length, block)) / katherine_readout::WORD_BYTES;
+
+			size_t done = 0;
+			while (done < length)
+			{
+				// Batches fit into PIPE_BUF, so a nonblocking write is whole or nothing
+				const ssize_t len = ::write(fd, data + done, length - done);
+				if (len > 0)
+				{
+					done += static_cast<size_t>(len);
+					continue;
+				}
+
+				if (len < 0 && errno != EAGAIN) return (length - done) / katherine_readout::WORD_BYTES;	// Plugin closed the fifo
+				if (block == false) return (length - done) / katherine_readout::WORD_BYTES;
+
+				pollfd pfd = { fd, POLLOUT, 0 };
+				poll(&pfd, 1, 100);
+			}
+
+			return 0;
+		}
+
+	private:
+		int fd = -1;
+		shm_ring ring;
+	};
+}
+
+int main(int argc, char** argv)
+{
+	using namespace readout_words;
+
+	if (argc < 2)
+	{
+		printf("Usage: stream_replayer file [-raw | -text | -online] [-realtime [S] | -rate M] [-fifo | -shm] [-frames N] [-nonblock]\n");
+		return 1;
+	}
+
+	const char* path = argv[1];
+	int format = input_text;
+	int mode = rate_max;
+	double speed = 1;
+	double rate = 1;
+	bool shm = false;
+	uint64_t frames = 1;
+	bool block = true;
+
+	for (int i = 2; i < argc; i++)
+	{
+		const bool has_value = (i + 1 < argc) && argv[i + 1][0] != '-';
+
+		if (strcmp(argv[i], "-raw") == 0) format = input_raw;
+		else if (strcmp(argv[i], "-text") == 0) format = input_text;
+		else if (strcmp(argv[i], "-online") == 0) format = input_online;
+		else if (strcmp(argv[i], "-realtime") == 0)
+		{
+			mode = rate_realtime;
+			if (has_value) speed = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-rate") == 0 && has_value)
+		{
+			mode = rate_fixed;
+			rate = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-fifo") == 0) shm = false;
+		else if (strcmp(argv[i], "-shm") == 0) shm = true;
+		else if (strcmp(argv[i], "-frames") == 0 && has_value) frames = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-nonblock") == 0) block = false;
+		else
+		{
+			printf("Unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (speed <= 0 || rate <= 0)
+	{
+		printf("Speed and rate must be positive\n");
+		return 1;
+	}
+
+	/* Load and encode the input */
+	std::vector<char> words;
+	bool loaded = false;
+	if (format == input_raw) loaded = load_raw(path, words);
+	else loaded = load_text(path, (format == input_text) ? pixel_parser::katherine_raw : pixel_parser::xy_tot_toa, words);
+
+	if (loaded == false)
+	{
+		printf("Failed to load %s\n", path);
+		return 1;
+	}
+
+	std::vector<batch> batches;
+	int64_t first_toa = 0;
+	make_batches(words, batches, first_toa);
+
+	const uint64_t frame_pixels = batches.empty() ? 0 : batches.back().pixels;
+	const int64_t frame_span = batches.empty() ? 0 : batches.back().toa - first_toa;
+	printf("Loaded %llu words, %llu pixels, span %.3f s\n", static_cast<unsigned long long>(words.size() / katherine_readout::WORD_BYTES),
+		static_cast<unsigned long long>(frame_pixels), frame_span / 1e9);
+
+	signal(SIGPIPE, SIG_IGN);	// Plugin closing the fifo ends write() with error instead
+
+	output out;
+	if ((shm ? out.open_shm() : out.open_fifo()) == false)
+	{
+		perror(shm ? "Failed to create ring " SHM_RING_PATH : "Failed to open fifo " FIFO_PATH);
+		return 1;
+	}
+
+	/* Replay */
+	std::vector<char> marker;
+	uint64_t sent_pixels = 0;
+	uint64_t lost_total = 0;
+	double frames_span = 0;		// Realtime: ToA span of previous frames (s)
+	const auto start = std::chrono::steady_clock::now();
+
+	for (uint64_t frame = 0; frame < frames; frame++)
+	{
+		marker.clear();
+		put_word(marker, control_word(katherine_readout::frame_start, 0));
+		out.write(marker.data(), marker.size(), true);
+
+		uint64_t lost = 0;
+		size_t begin = 0;
+
+		for (const batch& b : batches)
+		{
+			// Wait until the batch is due
+			double due = 0;
+			if (mode == rate_realtime) due = frames_span + ((b.toa - first_toa) / 1e9) / speed;
+			else if (mode == rate_fixed) due = (sent_pixels + b.pixels) / (rate * 1e6);
+
+			if (mode != rate_max)
+			{
+				std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(due)));
+			}
+
+			lost += out.write(words.data() + begin, b.end - begin, block);
+			begin = b.end;
+		}
+
+		// Words dropped here are reported the same way as the board reports pixels it could not send
+		marker.clear();
+		if (lost > 0) put_word(marker, control_word(katherine_readout::lost_pixels, lost));
+		put_word(marker, control_word(katherine_readout::frame_end, 0));
+		out.write(marker.data(), marker.size(), true);
+
+		sent_pixels += frame_pixels;
+		lost_total += lost;
+		frames_span += (frame_span / 1e9) / speed;
+	}
+
+	// Ring is removed on exit, plugin which did not attach yet would miss the data
+	out.wait_read();
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("Replayed %llu frames in %.3f s (%.2f MHit/s), words not written %llu\n", static_cast<unsigned long long>(frames), seconds,
+		sent_pixels / seconds / 1e6, static_cast<unsigned long long>(lost_total));
+
+	return 0;
+}